@@ -1,6 +1,16 @@
 #include "swscale.h"
+#include "scalerPool.h"
+
+extern "C" {
+#include "libavutil/log.h"
+}
 
 int main() {
     nv12toRGBA("./test_pic_1280x640.rgba", "../res/test_pic_640x360.nv12");
+    // 第二次调用复用缓存中的SwsContext
+    nv12toRGBA("./test_pic_1280x640.rgba", "../res/test_pic_640x360.nv12");
+
+    ScalerPoolStats stats = defaultScalerPool().stats();
+    av_log(NULL, AV_LOG_INFO, "scaler pool : %lld hits, %lld misses\n", (long long)stats.hits, (long long)stats.misses);
     return 0;
 }
\ No newline at end of file
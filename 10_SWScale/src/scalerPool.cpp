@@ -0,0 +1,53 @@
+#include "scalerPool.h"
+
+ScalerPool::ScalerPool(int maxIdle) : maxIdle_(maxIdle) {
+}
+
+ScalerPool::~ScalerPool() {
+    for(auto &idle : idle_) {
+        sws_freeContext(idle.swsCtx);
+    }
+}
+
+SwsContext *ScalerPool::acquire(const ScalerKey &key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto it = idle_.begin(); it != idle_.end(); ++it) {
+            if(it->key == key) {
+                SwsContext *swsCtx = it->swsCtx;
+                idle_.erase(it);
+                ++stats_.hits;
+                return swsCtx;
+            }
+        }
+        ++stats_.misses;
+    }
+
+    // 初始化比较慢，不占着锁
+    return sws_getContext(key.srcWidth, key.srcHeight, key.srcFormat,
+                          key.dstWidth, key.dstHeight, key.dstFormat,
+                          key.flags, NULL, NULL, NULL);
+}
+
+void ScalerPool::release(const ScalerKey &key, SwsContext *swsCtx) {
+    if(swsCtx == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_front(Idle{key, swsCtx});
+    while((int)idle_.size() > maxIdle_) {
+        sws_freeContext(idle_.back().swsCtx);
+        idle_.pop_back();
+        ++stats_.evicted;
+    }
+}
+
+ScalerPoolStats ScalerPool::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+ScalerPool &defaultScalerPool() {
+    static ScalerPool pool;
+    return pool;
+}
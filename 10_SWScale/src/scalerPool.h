@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <tuple>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+struct ScalerKey {
+    int srcWidth = 0;
+    int srcHeight = 0;
+    AVPixelFormat srcFormat = AV_PIX_FMT_NONE;
+    int dstWidth = 0;
+    int dstHeight = 0;
+    AVPixelFormat dstFormat = AV_PIX_FMT_NONE;
+    int flags = SWS_BILINEAR;
+
+    bool operator==(const ScalerKey &other) const {
+        return std::tie(srcWidth, srcHeight, srcFormat, dstWidth, dstHeight, dstFormat, flags)
+               == std::tie(other.srcWidth, other.srcHeight, other.srcFormat, other.dstWidth, other.dstHeight, other.dstFormat, other.flags);
+    }
+};
+
+struct ScalerPoolStats {
+    int64_t hits = 0;                   // 取到了空闲的SwsContext
+    int64_t misses = 0;                 // 新建SwsContext
+    int64_t evicted = 0;
+};
+
+// SwsContext的缓存 : 按(源宽高格式, 目标宽高格式, flags)复用，只在参数变化时新建
+//   SwsContext不能被多个线程同时使用，acquire()把它交给一个线程独占，release()后才会给别的线程；
+//   空闲的超过maxIdle个时释放最久没用的
+class ScalerPool {
+public:
+    explicit ScalerPool(int maxIdle = 16);
+    ~ScalerPool();
+    ScalerPool(const ScalerPool &) = delete;
+    ScalerPool &operator=(const ScalerPool &) = delete;
+
+    // 失败返回nullptr
+    SwsContext *acquire(const ScalerKey &key);
+    void release(const ScalerKey &key, SwsContext *swsCtx);
+
+    ScalerPoolStats stats();
+
+private:
+    struct Idle {
+        ScalerKey key;
+        SwsContext *swsCtx = nullptr;
+    };
+
+    int maxIdle_;
+    std::list<Idle> idle_;              // 最近还回来的在前面
+    ScalerPoolStats stats_;
+    std::mutex mutex_;
+};
+
+// 进程内共用的缓存
+ScalerPool &defaultScalerPool();
+
+// 在作用域内独占一个SwsContext，析构时还回池中
+class ScopedScaler {
+public:
+    ScopedScaler(ScalerPool &pool, const ScalerKey &key) : pool_(pool), key_(key), swsCtx_(pool.acquire(key)) {}
+    ~ScopedScaler() { pool_.release(key_, swsCtx_); }
+    ScopedScaler(const ScopedScaler &) = delete;
+    ScopedScaler &operator=(const ScopedScaler &) = delete;
+
+    SwsContext *get() const { return swsCtx_; }
+
+private:
+    ScalerPool &pool_;
+    ScalerKey key_;
+    SwsContext *swsCtx_;
+};
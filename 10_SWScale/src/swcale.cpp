@@ -1,4 +1,7 @@
 #include "swscale.h"
+#include "frameSink.h"
+#include "rawVideoReader.h"
+#include "scalerPool.h"
 
 extern "C" {
 #include "libavutil/log.h"
@@ -9,98 +12,57 @@ extern "C" {
 const int FRAME_WIDTH = 640;
 const int FRAME_HEIGHT = 360;
 
-// nv12 可以用这条命令播放
-// ffplay -pixel_format nv12 -f rawvideo -video_size 640x360 test_pic_640x360.nv12
-void readNv12ToAVFrame(AVFrame* &frame, std::string srcNv12) {
-    // 申请Frame的存储空间
-    frame->width = FRAME_WIDTH;
-    frame->height= FRAME_HEIGHT;
-    frame->format= AV_PIX_FMT_NV12;
-
-    auto ret = av_frame_get_buffer(frame, 0);
-    if(ret < 0) {
-        av_log(NULL, AV_LOG_ERROR, "allocate frame buffer failed\n");
-        return;
-    }
-
-    ret = av_frame_make_writable(frame);
-    if(ret < 0) {
-        av_log(NULL, AV_LOG_ERROR, "av frame make writable failed\n");
-        return;
-    }
-    
-    FILE *file = fopen(srcNv12.c_str(), "rb"); // 以二进制模式打开文件
-    if (file == NULL) {
-        av_log(NULL, AV_LOG_ERROR, "Failed to open file");
-        return;
-    }
-
-    fseek(file, 0, SEEK_END);
-    int length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    size_t bytes_read = 0;
-
-    // Y分量
-    for(int i = 0; i < FRAME_HEIGHT; ++i) {
-        fread(frame->data[0] + i * frame->linesize[0], frame->width, 1, file);
-        bytes_read += frame->width;
-    }
-    // UV分量
-    for(int i = 0; i < FRAME_HEIGHT / 2; ++i) {
-        fread(frame->data[1] + i * frame->linesize[1], frame->width, 1, file);
-        bytes_read += frame->width;
-    }
-
-    if (bytes_read != length) {
-        av_log(NULL, AV_LOG_ERROR, "Failed to read file\n");
-        fclose(file);
-        return;
-    }
-
-    fclose(file);
-}
-
 // ffplay -pixel_format rgba -f rawvideo -video_size 1280x720 test_pic_1280x640.rgba
 void writeRGBAToFile(const AVFrame *frame, std::string dstRGBA) {
-    FILE *file = fopen(dstRGBA.c_str(), "wb");
-    if (file == NULL) {
+    // 行是连续的时候整帧一次写入，否则一次writev
+    FrameSink sink;
+    if(!sink.open(dstRGBA)) {
         av_log(NULL, AV_LOG_ERROR, "Failed to open rgba file\n");
         return;
     }
+    sink.write(frame);
+    sink.close();
 
-    size_t bytes_write = 0;
-    for(int i = 0; i < frame->height; ++i) {
-        fwrite(frame->data[0] + i * frame->linesize[0], frame->width * 4, 1, file);
-        bytes_write += frame->width * 4;
-    }
-
-    av_log(NULL, AV_LOG_INFO, "write data : %zu bytes\n", bytes_write);
-
-    fclose(file);
+    av_log(NULL, AV_LOG_INFO, "write data : %lld bytes\n", (long long)sink.stats().bytes);
 }
 
 // 将nv12的图片转换成rgba格式
+// nv12 可以用这条命令播放
+// ffplay -pixel_format nv12 -f rawvideo -video_size 640x360 test_pic_640x360.nv12
 void nv12toRGBA(std::string dst, std::string src) {
-    SwsContext *swsCtx = sws_getContext(FRAME_WIDTH,      // 原始图像的宽度
-                                        FRAME_HEIGHT,     // 原始图像的高度
-                                        AV_PIX_FMT_NV12,  // 原始图像的格式
-                                        FRAME_WIDTH * 2,  // 目标图像的宽度，这里放大2倍
-                                        FRAME_HEIGHT * 2, // 目标图像的高度，放大2倍
-                                        AV_PIX_FMT_RGBA,  // 目标图像格式
-                                        SWS_BILINEAR,     // 缩放时使用的算法
-                                        NULL, NULL, NULL);// 输入图像的滤波信息，输出图像的滤波信息，缩放算法调节参数
+    // 映射输入文件，源帧直接指向文件内容，不拷贝
+    RawVideoReader reader;
+    if(!reader.open(src, FRAME_WIDTH, FRAME_HEIGHT, AV_PIX_FMT_NV12)) {
+        av_log(NULL, AV_LOG_ERROR, "open raw video %s failed\n", src.c_str());
+        return;
+    }
+
+    // 从缓存中取相同参数的SwsContext，只有第一次调用时新建
+    ScalerKey key;
+    key.srcWidth = FRAME_WIDTH;          // 原始图像的宽度
+    key.srcHeight = FRAME_HEIGHT;        // 原始图像的高度
+    key.srcFormat = AV_PIX_FMT_NV12;     // 原始图像的格式
+    key.dstWidth = FRAME_WIDTH * 2;      // 目标图像的宽度，这里放大2倍
+    key.dstHeight = FRAME_HEIGHT * 2;    // 目标图像的高度，放大2倍
+    key.dstFormat = AV_PIX_FMT_RGBA;     // 目标图像格式
+    key.flags = SWS_BILINEAR;            // 缩放时使用的算法
+    ScopedScaler scaler(defaultScalerPool(), key);
+    SwsContext *swsCtx = scaler.get();
     if(swsCtx == nullptr) {
         av_log(NULL, AV_LOG_ERROR, "create sws context failed\n");
+        return;
     }
 
-    // 申请元数据NV12帧的空间，会从文件中读取数据
+    // 源NV12帧，取文件的第一帧
     AVFrame *srcFrame = av_frame_alloc();
     if(srcFrame == nullptr) {
         av_log(NULL, AV_LOG_ERROR, "allocate the src frame failed\n");
         return;
     }
-    readNv12ToAVFrame(srcFrame, src);
+    if(reader.getFrame(0, srcFrame) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "get the src frame failed\n");
+        return;
+    }
 
     // 申请待转换的RGBA帧的空间
     AVFrame *dstFrame = av_frame_alloc();
@@ -131,5 +93,4 @@ void nv12toRGBA(std::string dst, std::string src) {
 
     av_frame_free(&srcFrame);
     av_frame_free(&dstFrame);
-    sws_freeContext(swsCtx);
 }
\ No newline at end of file
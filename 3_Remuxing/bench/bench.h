@@ -0,0 +1,9 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// 不同mp4布局的写入字节数
+void runLayoutBench(const std::vector<std::string> &corpus);
+
+// 每个packet的流映射和时间戳改写的吞吐
+void runRewriteBench(const std::vector<std::string> &corpus);
@@ -0,0 +1,28 @@
+#include "bench.h"
+#include "remuxing.h"
+#include <stdio.h>
+
+// 对比不同的mp4布局写入的字节数，faststart需要把整个文件再写一遍
+void runLayoutBench(const std::vector<std::string> &corpus) {
+    const std::vector<Mp4Layout> layouts = {Mp4Layout::MoovAtEnd, Mp4Layout::Faststart, Mp4Layout::ReservedMoov, Mp4Layout::Fragmented};
+
+    printf("%-32s %-14s %-14s %12s %12s %12s %12s %12s %6s %8s\n",
+           "file", "layout", "used", "moov_rsv", "file_size", "written", "discarded", "read_back", "amp", "sec");
+    for(auto &url : corpus) {
+        for(auto layout : layouts) {
+            Mp4LayoutStats stats;
+            if(!remuxingMp4Layout(url, "./bench_layout.mp4", layout, &stats)) {
+                fprintf(stderr, "remux %s as %s failed\n", url.c_str(), mp4LayoutName(layout));
+                continue;
+            }
+
+            // 写放大 : 写入的字节数 / 最终文件大小，预留空间不够时作废的那一遍也算在内
+            double amp = stats.fileSize > 0 ? stats.bytesWritten / (double)stats.fileSize : 0;
+            printf("%-32s %-14s %-14s %12lld %12lld %12lld %12lld %12lld %6.2f %8.3f\n",
+                   url.c_str(), mp4LayoutName(layout), mp4LayoutName(stats.layout),
+                   (long long)stats.reservedMoovSize, (long long)stats.fileSize, (long long)stats.bytesWritten,
+                   (long long)stats.discardedBytes, (long long)stats.bytesRead, amp, stats.wallSec);
+        }
+    }
+    remove("./bench_layout.mp4");
+}
@@ -0,0 +1,36 @@
+#include "bench.h"
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include <libavutil/log.h>
+}
+
+// 用法 : ./3_Remuxing_bench <layout|rewrite> file1 file2 ...
+//   layout  : 对比faststart和预留moov等mp4布局写入的字节数
+//   rewrite : 对比packet改写的旧实现(std::map)和流描述表，建议使用packet密集的ts文件
+// 不传文件时使用 ../res/big_buck_bunny.mp4
+int main(int argc, char *argv[]) {
+    if(argc < 2 || (strcmp(argv[1], "layout") != 0 && strcmp(argv[1], "rewrite") != 0)) {
+        fprintf(stderr, "usage : %s <layout|rewrite> file1 file2 ...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> corpus;
+    for(int i = 2; i < argc; ++i) {
+        corpus.push_back(argv[i]);
+    }
+    if(corpus.empty()) {
+        corpus.push_back("../res/big_buck_bunny.mp4");
+    }
+
+    // 统计期间关闭FFmpeg的日志输出，只保留错误
+    av_log_set_level(AV_LOG_ERROR);
+
+    if(strcmp(argv[1], "layout") == 0) {
+        runLayoutBench(corpus);
+    } else {
+        runRewriteBench(corpus);
+    }
+    return 0;
+}
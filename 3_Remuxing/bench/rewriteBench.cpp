@@ -0,0 +1,169 @@
+#include "bench.h"
+#include "streamDescriptor.h"
+#include <chrono>
+#include <map>
+#include <stdio.h>
+
+// 读入的packet只保留改写需要的字段
+struct PacketTiming {
+    int streamIndex = 0;
+    int64_t pts = AV_NOPTS_VALUE;
+    int64_t dts = AV_NOPTS_VALUE;
+    int64_t duration = 0;
+};
+
+// 读出输入所有packet的时间戳，并按remuxing()的方式建立mp4输出，得到写完header后的时间基
+static bool loadPackets(const std::string &url, std::vector<PacketTiming> &packets,
+                        std::vector<AVRational> &srcTimeBases, std::vector<AVRational> &dstTimeBases,
+                        std::vector<int> &streamIdxMap) {
+    AVFormatContext *inFmtCtx = nullptr;
+    if(avformat_open_input(&inFmtCtx, url.c_str(), NULL, NULL) < 0) {
+        return false;
+    }
+    if(avformat_find_stream_info(inFmtCtx, NULL) < 0) {
+        avformat_close_input(&inFmtCtx);
+        return false;
+    }
+
+    AVFormatContext *outFmtCtx = nullptr;
+    if(avformat_alloc_output_context2(&outFmtCtx, NULL, "mp4", NULL) < 0 || avio_open_dyn_buf(&outFmtCtx->pb) < 0) {
+        avformat_free_context(outFmtCtx);
+        avformat_close_input(&inFmtCtx);
+        return false;
+    }
+
+    streamIdxMap.assign(inFmtCtx->nb_streams, -1);
+    for(int i = 0; i < inFmtCtx->nb_streams; ++i) {
+        if(inFmtCtx->streams[i]->codecpar->codec_id == AV_CODEC_ID_NONE) {
+            continue;
+        }
+        AVStream *strm = avformat_new_stream(outFmtCtx, NULL);
+        streamIdxMap[i] = strm->index;
+        avcodec_parameters_copy(strm->codecpar, inFmtCtx->streams[i]->codecpar);
+        strm->time_base = inFmtCtx->streams[i]->time_base;
+    }
+    bool ok = avformat_write_header(outFmtCtx, NULL) >= 0;
+
+    srcTimeBases.clear();
+    dstTimeBases.clear();
+    for(int i = 0; ok && i < inFmtCtx->nb_streams; ++i) {
+        srcTimeBases.push_back(inFmtCtx->streams[i]->time_base);
+        dstTimeBases.push_back(streamIdxMap[i] >= 0 ? outFmtCtx->streams[streamIdxMap[i]]->time_base : AVRational{1, 1});
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    while(ok && packet && av_read_frame(inFmtCtx, packet) >= 0) {
+        if(packet->stream_index < (int)srcTimeBases.size()) {
+            packets.push_back({packet->stream_index, packet->pts, packet->dts, packet->duration});
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+
+    uint8_t *buffer = nullptr;
+    avio_close_dyn_buf(outFmtCtx->pb, &buffer);
+    av_free(buffer);
+    outFmtCtx->pb = nullptr;
+    avformat_free_context(outFmtCtx);
+    avformat_close_input(&inFmtCtx);
+    return ok;
+}
+
+static void fillPacket(AVPacket *packet, const PacketTiming &timing) {
+    packet->stream_index = timing.streamIndex;
+    packet->pts = timing.pts;
+    packet->dts = timing.dts;
+    packet->duration = timing.duration;
+}
+
+// 只累计有效的时间戳，两种实现对AV_NOPTS_VALUE的处理不同
+static uint64_t checksumPacket(const AVPacket *packet) {
+    if(packet->pts == AV_NOPTS_VALUE || packet->dts == AV_NOPTS_VALUE) {
+        return 0;
+    }
+    return (uint64_t)packet->pts * 31 + (uint64_t)packet->dts * 17 + (uint64_t)packet->duration + packet->stream_index;
+}
+
+void runRewriteBench(const std::vector<std::string> &corpus) {
+    // 每种实现至少跑这么久，取平均
+    const double MIN_BENCH_SEC = 0.5;
+
+    printf("%-32s %10s %14s %14s %8s %6s\n", "file", "packets", "map pkt/s", "table pkt/s", "speedup", "match");
+    for(auto &url : corpus) {
+        std::vector<PacketTiming> packets;
+        std::vector<AVRational> srcTimeBases, dstTimeBases;
+        std::vector<int> streamIdx;
+        if(!loadPackets(url, packets, srcTimeBases, dstTimeBases, streamIdx) || packets.empty()) {
+            fprintf(stderr, "load packets of %s failed\n", url.c_str());
+            continue;
+        }
+
+        AVPacket *packet = av_packet_alloc();
+
+        // 旧实现 : 每个packet查找std::map，调用三次av_rescale_q
+        std::map<int, int> streamIdxMap;
+        for(size_t i = 0; i < streamIdx.size(); ++i) {
+            if(streamIdx[i] >= 0) {
+                streamIdxMap[i] = streamIdx[i];
+            }
+        }
+        // 每一遍的校验和相同，保留最后一遍的，用来确认两种实现的输出一致
+        uint64_t mapChecksum = 0;
+        int64_t mapPackets = 0;
+        auto begin = std::chrono::steady_clock::now();
+        double mapSec = 0;
+        while(mapSec < MIN_BENCH_SEC) {
+            uint64_t checksum = 0;
+            for(auto &timing : packets) {
+                fillPacket(packet, timing);
+                if(streamIdxMap.find(packet->stream_index) == streamIdxMap.end()) {
+                    continue;
+                }
+                AVRational srcTb = srcTimeBases[packet->stream_index];
+                AVRational dstTb = dstTimeBases[packet->stream_index];
+                packet->dts = av_rescale_q(packet->dts, srcTb, dstTb);
+                packet->pts = av_rescale_q(packet->pts, srcTb, dstTb);
+                packet->duration = av_rescale_q(packet->duration, srcTb, dstTb);
+                packet->stream_index = streamIdxMap[packet->stream_index];
+                packet->time_base = dstTb;
+                checksum += checksumPacket(packet);
+            }
+            mapChecksum = checksum;
+            mapPackets += packets.size();
+            mapSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        }
+
+        // 新实现 : 按输入流id索引的描述表，预先约分的时间基转换
+        std::vector<StreamDescriptor> table(srcTimeBases.size());
+        for(size_t i = 0; i < table.size(); ++i) {
+            if(streamIdx[i] >= 0) {
+                table[i].dstStreamId = streamIdx[i];
+                table[i].dstTimeBase = dstTimeBases[i];
+                table[i].rescale.init(srcTimeBases[i], dstTimeBases[i]);
+            }
+        }
+        uint64_t tableChecksum = 0;
+        int64_t tablePackets = 0;
+        begin = std::chrono::steady_clock::now();
+        double tableSec = 0;
+        while(tableSec < MIN_BENCH_SEC) {
+            uint64_t checksum = 0;
+            for(auto &timing : packets) {
+                fillPacket(packet, timing);
+                if(rewritePacket(table, packet)) {
+                    checksum += checksumPacket(packet);
+                }
+            }
+            tableChecksum = checksum;
+            tablePackets += packets.size();
+            tableSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        }
+
+        double mapRate = mapPackets / mapSec;
+        double tableRate = tablePackets / tableSec;
+        printf("%-32s %10zu %14.0f %14.0f %7.2fx %6s\n", url.c_str(), packets.size(), mapRate, tableRate,
+               tableRate / mapRate, mapChecksum == tableChecksum ? "yes" : "no");
+
+        av_packet_free(&packet);
+    }
+}
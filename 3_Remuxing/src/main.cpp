@@ -2,5 +2,17 @@
 
 int main() {
     remuxing("../res/big_buck_bunny.mp4", "./output.mp4");
+    remuxingConcat({"../res/big_buck_bunny.mp4", "../res/big_buck_bunny.mp4"}, "./concat.mp4");
+
+    StreamingRemuxOptions fragmented;
+    fragmented.fragmentDurationMs = 500;
+    remuxingStreaming("../res/big_buck_bunny.mp4", "./fragmented.mp4", fragmented);
+
+    StreamingRemuxOptions segmented;
+    segmented.mode = StreamingOutputMode::Segmented;
+    segmented.fragmentDurationMs = 2000;
+    remuxingStreaming("../res/big_buck_bunny.mp4", "./live.m3u8", segmented);
+
+    remuxingMp4Layout("../res/big_buck_bunny.mp4", "./reserved_moov.mp4", Mp4Layout::ReservedMoov);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "packetInterleaver.h"
+#include <algorithm>
+
+PacketInterleaver::PacketInterleaver(AVFormatContext *outFmtCtx, const InterleaverConfig &config)
+    : outFmtCtx_(outFmtCtx), config_(config),
+      queues_(outFmtCtx->nb_streams), lastDtsUs_(outFmtCtx->nb_streams, INT64_MIN) {
+}
+
+PacketInterleaver::~PacketInterleaver() {
+    for(auto &queue : queues_) {
+        for(auto &item : queue) {
+            av_packet_free(&item.packet);
+        }
+    }
+}
+
+// packet在队列中占用的内存，包括AVPacket自身
+static int64_t packetBytes(const AVPacket *packet) {
+    return packet->size + (int64_t)sizeof(AVPacket);
+}
+
+int PacketInterleaver::push(AVPacket *packet) {
+    int streamId = packet->stream_index;
+    if(streamId < 0 || streamId >= (int)queues_.size()) {
+        av_packet_unref(packet);
+        return AVERROR(EINVAL);
+    }
+
+    QueuedPacket item;
+    item.packet = av_packet_alloc();
+    if(item.packet == nullptr) {
+        av_packet_unref(packet);
+        return AVERROR(ENOMEM);
+    }
+    av_packet_move_ref(item.packet, packet);
+
+    // 没有dts的packet跟在同一路流的上一个packet后面
+    if(item.packet->dts != AV_NOPTS_VALUE) {
+        item.dtsUs = av_rescale_q(item.packet->dts, outFmtCtx_->streams[streamId]->time_base, AV_TIME_BASE_Q);
+    } else {
+        item.dtsUs = lastDtsUs_[streamId] != INT64_MIN ? lastDtsUs_[streamId] : 0;
+    }
+    lastDtsUs_[streamId] = item.dtsUs;
+    maxDtsUs_ = std::max(maxDtsUs_, item.dtsUs);
+
+    depthPackets_ += 1;
+    depthBytes_ += packetBytes(item.packet);
+    stats_.maxDepthPackets = std::max(stats_.maxDepthPackets, depthPackets_);
+    stats_.maxDepthBytes = std::max(stats_.maxDepthBytes, depthBytes_);
+    queues_[streamId].push_back(item);
+
+    return drain(false);
+}
+
+int PacketInterleaver::flush() {
+    return drain(true);
+}
+
+int PacketInterleaver::drain(bool force) {
+    int ret = 0;
+    while(depthPackets_ > 0) {
+        // 队头dts最小的流，每路流内部已经是dts顺序
+        int minStream = -1;
+        bool allQueued = true;
+        for(int i = 0; i < (int)queues_.size(); ++i) {
+            if(queues_[i].empty()) {
+                allQueued = false;
+            } else if(minStream < 0 || queues_[i].front().dtsUs < queues_[minStream].front().dtsUs) {
+                minStream = i;
+            }
+        }
+
+        // 所有流都有packet时，之后不会再有更早的packet，可以安全写出
+        if(!force && !allQueued) {
+            bool overflow = maxDtsUs_ - queues_[minStream].front().dtsUs > config_.windowUs
+                            || depthBytes_ > config_.maxBytes;
+            if(!overflow) {
+                break;
+            }
+            if(!overflowWarned_) {
+                av_log(NULL, AV_LOG_WARNING, "interleaving queue overflow (%lld packets, %lld bytes, window %.3fs), "
+                       "writing without waiting for all streams\n",
+                       (long long)depthPackets_, (long long)depthBytes_, (maxDtsUs_ - queues_[minStream].front().dtsUs) / (double)AV_TIME_BASE);
+                overflowWarned_ = true;
+            }
+            ++stats_.overflowWrites;
+        }
+
+        QueuedPacket item = queues_[minStream].front();
+        queues_[minStream].pop_front();
+        depthPackets_ -= 1;
+        depthBytes_ -= packetBytes(item.packet);
+
+        // 已经按dts排好序，直接写入，muxer内部不再缓存
+        if(av_write_frame(outFmtCtx_, item.packet) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error during write packet\n");
+            ret = -1;
+        } else {
+            ++stats_.packetsWritten;
+        }
+        av_packet_free(&item.packet);
+    }
+    return ret;
+}
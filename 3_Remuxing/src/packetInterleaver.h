@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+struct InterleaverConfig {
+    int64_t windowUs = 10 * AV_TIME_BASE;   // 队列中最早和最晚的dts最多相差多少
+    int64_t maxBytes = 64 * 1024 * 1024;    // 队列中packet最多占用的内存
+};
+
+struct InterleaverStats {
+    int64_t packetsWritten = 0;
+    int64_t maxDepthPackets = 0;
+    int64_t maxDepthBytes = 0;
+    int64_t overflowWrites = 0;     // 超出窗口或内存上限时，没等齐所有流就写出的packet数
+};
+
+// 在muxer之前按dts交叉排序packet，代替av_interleaved_write_frame()内部不受限制的缓存
+//   每路流一个队列，所有流都有packet时写出dts最小的一个；
+//   有的流长时间没有packet(交叉很差的文件)时，队列超出dts窗口或内存上限，
+//   直接写出最早的packet并给出警告，而不是一直增长
+class PacketInterleaver {
+public:
+    PacketInterleaver(AVFormatContext *outFmtCtx, const InterleaverConfig &config);
+    ~PacketInterleaver();
+
+    // 接管packet的引用，写出所有可以写出的packet
+    int push(AVPacket *packet);
+    // 写出队列中剩余的所有packet，输入结束时调用
+    int flush();
+
+    int64_t depthPackets() const { return depthPackets_; }
+    int64_t depthBytes() const { return depthBytes_; }
+    const InterleaverStats &stats() const { return stats_; }
+
+private:
+    struct QueuedPacket {
+        AVPacket *packet = nullptr;
+        int64_t dtsUs = 0;
+    };
+
+    int drain(bool force);
+
+    AVFormatContext *outFmtCtx_ = nullptr;
+    InterleaverConfig config_;
+    std::vector<std::deque<QueuedPacket>> queues_;  // 按输出流id
+    std::vector<int64_t> lastDtsUs_;
+    int64_t maxDtsUs_ = INT64_MIN;
+    int64_t depthPackets_ = 0;
+    int64_t depthBytes_ = 0;
+    bool overflowWarned_ = false;
+    InterleaverStats stats_;
+};
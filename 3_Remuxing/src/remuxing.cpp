@@ -1,5 +1,6 @@
 #include "remuxing.h"
-#include <map>
+#include "streamDescriptor.h"
+#include <vector>
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -7,7 +8,8 @@ extern "C" {
 
 // src : 输入的url
 // dst : 输出的url
-void remuxing(std::string src, std::string dst) {
+// interleaver : 交叉排序队列的配置
+void remuxing(std::string src, std::string dst, const InterleaverConfig &interleaver) {
     // 初始化解封装相关的组件
     //   创建AVFormatContext和AVInputFormat
     AVFormatContext *inFmtCtx = nullptr;
@@ -50,8 +52,8 @@ void remuxing(std::string src, std::string dst) {
     }
 
     // 从原文件的流信息，创建新的输出流
-    // 这里用一个map来记录 输入流id 和 输出流id 的对应关系
-    std::map<int, int> streamIdxMap;
+    // 这里用一个数组来记录 输入流id 和 输出流id 的对应关系，-1表示不输出
+    std::vector<int> streamIdxMap(inFmtCtx->nb_streams, -1);
     for(int i = 0; i < inFmtCtx->nb_streams; ++i) {
         if(inFmtCtx->streams[i]->codecpar->codec_id == AV_CODEC_ID_NONE) {
             continue;
@@ -80,29 +82,31 @@ void remuxing(std::string src, std::string dst) {
         av_log(NULL, AV_LOG_INFO, "new timebase : %d / %d\n", strm->time_base.num, strm->time_base.den);
     }
 
+    // 写完header后时间基已经确定，为每路输入流建立改写描述，预先算好时间基的转换
+    std::vector<StreamDescriptor> streamTable = buildStreamDescriptors(inFmtCtx, outFmtCtx, streamIdxMap);
+
+    // 自己按dts交叉排序，队列的深度和内存有上限，不使用av_interleaved_write_frame()内部的缓存
+    PacketInterleaver interleaveQueue(outFmtCtx, interleaver);
+
     // 逐帧写入
     while(av_read_frame(inFmtCtx, inPacket) >= 0) {
-        if(streamIdxMap.find(inPacket->stream_index) == streamIdxMap.end()) {
+        // 注意，这里上面提到了，在avformat_write_header()之后，流所使用的
+        // time_base可能会发生改变，所以，对于帧要写入的dts，pts，都需要进行一个转换
+        if(!rewritePacket(streamTable, inPacket)) {
             av_packet_unref(inPacket);
             continue;
         }
-        // av_log(NULL, AV_LOG_INFO, "read a packet\n");
-        auto &oldStream = inFmtCtx->streams[inPacket->stream_index];
-        auto &newStream = outFmtCtx->streams[streamIdxMap[inPacket->stream_index]];
 
-        // 注意，这里上面提到了，在avformat_write_header()之后，流所使用的
-        // time_base可能会发生改变，所以，对于帧要写入的dts，pts，都需要进行一个转换
-        inPacket->dts = av_rescale_q(inPacket->dts, oldStream->time_base, newStream->time_base);
-        inPacket->pts = av_rescale_q(inPacket->pts, oldStream->time_base, newStream->time_base);
-        inPacket->stream_index = streamIdxMap[inPacket->stream_index];
-        inPacket->time_base = newStream->time_base;
-
-        // 交叉写入音频和视频帧
-        if(av_interleaved_write_frame(outFmtCtx, inPacket) < 0) {
-            av_log(NULL, AV_LOG_ERROR, "Error during write packet\n");
-        }
-        av_packet_unref(inPacket);
+        // 交叉写入音频和视频帧，队列接管packet的引用
+        interleaveQueue.push(inPacket);
     }
+    interleaveQueue.flush();
+
+    const InterleaverStats &queueStats = interleaveQueue.stats();
+    av_log(NULL, AV_LOG_INFO, "interleaving queue : %lld packets written, max depth %lld packets / %lld bytes, "
+           "%lld written on overflow\n",
+           (long long)queueStats.packetsWritten, (long long)queueStats.maxDepthPackets,
+           (long long)queueStats.maxDepthBytes, (long long)queueStats.overflowWrites);
 
     // 写入尾部数据
     if(av_write_trailer(outFmtCtx) < 0) {
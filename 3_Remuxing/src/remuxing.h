@@ -1,4 +1,60 @@
 #pragma once
+#include "packetInterleaver.h"
+#include <cstdint>
 #include <string>
+#include <vector>
 
-void remuxing(std::string src, std::string dst);
\ No newline at end of file
+// interleaver : 写入muxer之前交叉排序的dts窗口和内存上限
+void remuxing(std::string src, std::string dst, const InterleaverConfig &interleaver = InterleaverConfig());
+
+// 将多个编码参数一致的输入，直接拷贝拼接成一个输出，时间戳连续
+// 拷贝当前输入的同时，在后台线程中打开并解析下一个输入
+// mp4/mkv中视频的avcC/hvcC参数集和第一个输入不同时跳过该输入
+void remuxingConcat(std::vector<std::string> srcs, std::string dst);
+
+enum class StreamingOutputMode {
+    FragmentedMP4,  // 单个mp4文件，空moov + 连续的moof/mdat分片
+    Segmented,      // hls播放列表 + 按关键帧切分的fmp4分段
+};
+
+struct StreamingRemuxOptions {
+    StreamingOutputMode mode = StreamingOutputMode::FragmentedMP4;
+    int fragmentDurationMs = 1000;  // 分片/分段时长
+    int playlistSize = 5;           // Segmented模式下播放列表保留的分段数，0表示全部保留
+    bool realtime = false;          // 按时间戳的节奏读取输入，模拟直播源
+};
+
+struct StreamingRemuxStats {
+    double firstByteSec = -1;           // 开始到写出第一个字节的时间
+    double firstFragmentSec = -1;       // 开始到第一个完整分片可读的时间
+    double firstFragmentMediaSec = -1;  // 第一个分片可读时，输入读到的媒体时间
+    int64_t bytesWritten = 0;
+    int fragments = 0;
+};
+
+// 流式输出，不需要等av_write_trailer，每个分片写完后消费者就可以读取
+void remuxingStreaming(std::string src, std::string dst, const StreamingRemuxOptions &options, StreamingRemuxStats *stats = nullptr);
+
+enum class Mp4Layout {
+    MoovAtEnd,      // 默认，moov写在文件尾
+    Faststart,      // movflags=faststart，写完后把整个文件后移，重写一遍
+    ReservedMoov,   // 按估计的大小在文件头预留moov空间，trailer时原地写入
+    Fragmented,     // 空moov + moof/mdat分片，预留空间不够时的后备方案
+};
+
+struct Mp4LayoutStats {
+    Mp4Layout layout = Mp4Layout::MoovAtEnd;    // 实际使用的布局
+    int64_t reservedMoovSize = 0;
+    int64_t fileSize = 0;
+    int64_t bytesWritten = 0;                   // 所有尝试写入的总字节数
+    int64_t discardedBytes = 0;                 // 其中预留空间不够、作废的那次尝试写入的字节数
+    int64_t bytesRead = 0;                      // faststart回读输出文件的字节数
+    int attempts = 1;
+    double wallSec = 0;
+};
+
+const char *mp4LayoutName(Mp4Layout layout);
+
+// 输出moov在文件头的mp4，ReservedMoov模式不需要faststart的第二遍重写
+//   预留的空间根据输入的帧数(mp4的索引)或者时长估计，不够时改为分片输出
+bool remuxingMp4Layout(std::string src, std::string dst, Mp4Layout layout, Mp4LayoutStats *stats = nullptr);
@@ -0,0 +1,231 @@
+#include "remuxing.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <map>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// 打开输入并读取流信息，会在后台线程中执行，提前准备下一个输入
+static AVFormatContext *openConcatInput(std::string url) {
+    AVFormatContext *inFmtCtx = nullptr;
+    if(avformat_open_input(&inFmtCtx, url.c_str(), NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open src file %s failed.\n", url.c_str());
+        return nullptr;
+    }
+
+    if(avformat_find_stream_info(inFmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info of %s failed\n", url.c_str());
+        avformat_close_input(&inFmtCtx);
+        return nullptr;
+    }
+    return inFmtCtx;
+}
+
+// extradata是avcC/hvcC这类长度前缀格式(mp4/mkv)，而不是Annex B的起始码开头
+static bool hasLengthPrefixedExtradata(const AVCodecParameters *par) {
+    const uint8_t *data = par->extradata;
+    int size = par->extradata_size;
+    if(size < 4) {
+        return false;
+    }
+    bool annexB = (data[0] == 0 && data[1] == 0 && data[2] == 1)
+                  || (data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1);
+    return !annexB;
+}
+
+// 判断两个流能否直接拷贝到同一个输出流
+static bool isCompatible(const AVCodecParameters *a, const AVCodecParameters *b) {
+    if(a->codec_type != b->codec_type || a->codec_id != b->codec_id) {
+        return false;
+    }
+    if(a->codec_type == AVMEDIA_TYPE_VIDEO) {
+        if(a->width != b->width || a->height != b->height || a->format != b->format) {
+            return false;
+        }
+    } else if(a->codec_type == AVMEDIA_TYPE_AUDIO) {
+        if(a->sample_rate != b->sample_rate || a->ch_layout.nb_channels != b->ch_layout.nb_channels) {
+            return false;
+        }
+    }
+    if(a->extradata_size != b->extradata_size
+       || (a->extradata_size > 0 && memcmp(a->extradata, b->extradata, a->extradata_size) != 0)) {
+        // avcC/hvcC中的SPS/PPS只存在extradata里，输出文件只有第一个输入的extradata，
+        // 后面输入的packet会按错误的参数集解码，不能直接拷贝
+        if(a->codec_type == AVMEDIA_TYPE_VIDEO && (hasLengthPrefixedExtradata(a) || hasLengthPrefixedExtradata(b))) {
+            av_log(NULL, AV_LOG_ERROR, "codec extradata differs between inputs\n");
+            return false;
+        }
+        // Annex B的码流(如ts)参数集在码流中随关键帧重复，只做提示
+        av_log(NULL, AV_LOG_WARNING, "codec extradata differs between inputs\n");
+    }
+    return true;
+}
+
+// 按流的顺序，把输入流对应到第一个输入创建的输出流上
+static bool mapConcatStreams(AVFormatContext *inFmtCtx, AVFormatContext *outFmtCtx, std::map<int, int> &streamIdxMap) {
+    streamIdxMap.clear();
+    int outIdx = 0;
+    for(int i = 0; i < inFmtCtx->nb_streams; ++i) {
+        if(inFmtCtx->streams[i]->codecpar->codec_id == AV_CODEC_ID_NONE) {
+            continue;
+        }
+        if(outIdx >= outFmtCtx->nb_streams || !isCompatible(inFmtCtx->streams[i]->codecpar, outFmtCtx->streams[outIdx]->codecpar)) {
+            return false;
+        }
+        streamIdxMap[i] = outIdx++;
+    }
+    return outIdx == outFmtCtx->nb_streams;
+}
+
+void remuxingConcat(std::vector<std::string> srcs, std::string dst) {
+    if(srcs.empty()) {
+        return;
+    }
+
+    AVFormatContext *inFmtCtx = openConcatInput(srcs[0]);
+    if(inFmtCtx == nullptr) {
+        return;
+    }
+
+    AVPacket *inPacket = av_packet_alloc();
+    if(inPacket == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate Packet failed.\n");
+        avformat_close_input(&inFmtCtx);
+        return;
+    }
+
+    AVFormatContext *outFmtCtx = nullptr;
+    if(avformat_alloc_output_context2(&outFmtCtx, NULL, NULL, dst.c_str()) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate output context failed.\n");
+        av_packet_free(&inPacket);
+        avformat_close_input(&inFmtCtx);
+        return;
+    }
+
+    if(!(outFmtCtx->oformat->flags & AVFMT_NOFILE)) {
+        if(avio_open(&outFmtCtx->pb, dst.c_str(), AVIO_FLAG_WRITE) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "IO Open failed.\n");
+        }
+    }
+
+    // 输出流按第一个输入创建，后面的输入需要和它的参数一致
+    for(int i = 0; i < inFmtCtx->nb_streams; ++i) {
+        if(inFmtCtx->streams[i]->codecpar->codec_id == AV_CODEC_ID_NONE) {
+            continue;
+        }
+        AVStream *strm = avformat_new_stream(outFmtCtx, NULL);
+        strm->id = outFmtCtx->nb_streams - 1;
+        strm->index = outFmtCtx->nb_streams - 1;
+        avcodec_parameters_copy(strm->codecpar, inFmtCtx->streams[i]->codecpar);
+        strm->time_base = inFmtCtx->streams[i]->time_base;
+    }
+
+    if(avformat_write_header(outFmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Write header failed.\n");
+        av_packet_free(&inPacket);
+        avformat_close_input(&inFmtCtx);
+        avio_closep(&outFmtCtx->pb);
+        avformat_free_context(outFmtCtx);
+        return;
+    }
+
+    // 每个输出流上一次写入的dts，保证跨文件时dts单调递增
+    std::vector<int64_t> lastDts(outFmtCtx->nb_streams, AV_NOPTS_VALUE);
+    // 已经写入的所有输入的总时长，下一个输入的时间戳从这里接着
+    int64_t offsetUs = 0;
+    double waitSec = 0;
+
+    std::future<AVFormatContext *> nextInput;
+    for(size_t idx = 0; idx < srcs.size(); ++idx) {
+        if(idx > 0) {
+            // 一般在拷贝上一个文件的过程中，下一个文件就已经打开好了
+            auto waitBegin = std::chrono::steady_clock::now();
+            inFmtCtx = nextInput.get();
+            waitSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitBegin).count();
+        }
+        // 在后台线程中打开下一个输入
+        if(idx + 1 < srcs.size()) {
+            nextInput = std::async(std::launch::async, openConcatInput, srcs[idx + 1]);
+        }
+        if(inFmtCtx == nullptr) {
+            continue;
+        }
+
+        std::map<int, int> streamIdxMap;
+        if(!mapConcatStreams(inFmtCtx, outFmtCtx, streamIdxMap)) {
+            av_log(NULL, AV_LOG_ERROR, "%s is not compatible with the first input, skip\n", srcs[idx].c_str());
+            avformat_close_input(&inFmtCtx);
+            continue;
+        }
+
+        // 输入自身的起始时间，映射到输出的offsetUs
+        int64_t inStartUs = inFmtCtx->start_time != AV_NOPTS_VALUE ? inFmtCtx->start_time : 0;
+        int64_t segmentEndUs = 0;
+
+        while(av_read_frame(inFmtCtx, inPacket) >= 0) {
+            if(streamIdxMap.find(inPacket->stream_index) == streamIdxMap.end()) {
+                av_packet_unref(inPacket);
+                continue;
+            }
+            int outStreamId = streamIdxMap[inPacket->stream_index];
+            auto &oldStream = inFmtCtx->streams[inPacket->stream_index];
+            auto &newStream = outFmtCtx->streams[outStreamId];
+
+            // 记录这个输入的结束时间
+            int64_t endTs = inPacket->pts != AV_NOPTS_VALUE ? inPacket->pts : inPacket->dts;
+            if(endTs != AV_NOPTS_VALUE) {
+                int64_t endUs = av_rescale_q(endTs + inPacket->duration, oldStream->time_base, AV_TIME_BASE_Q) - inStartUs;
+                segmentEndUs = std::max(segmentEndUs, endUs);
+            }
+
+            int64_t offset = av_rescale_q(offsetUs - inStartUs, AV_TIME_BASE_Q, newStream->time_base);
+            if(inPacket->dts != AV_NOPTS_VALUE) {
+                inPacket->dts = av_rescale_q(inPacket->dts, oldStream->time_base, newStream->time_base) + offset;
+            }
+            if(inPacket->pts != AV_NOPTS_VALUE) {
+                inPacket->pts = av_rescale_q(inPacket->pts, oldStream->time_base, newStream->time_base) + offset;
+            }
+            inPacket->duration = av_rescale_q(inPacket->duration, oldStream->time_base, newStream->time_base);
+
+            // 文件交界处时长取整可能造成dts回退，整体往后挪
+            if(inPacket->dts != AV_NOPTS_VALUE && lastDts[outStreamId] != AV_NOPTS_VALUE && inPacket->dts <= lastDts[outStreamId]) {
+                int64_t delta = lastDts[outStreamId] + 1 - inPacket->dts;
+                inPacket->dts += delta;
+                if(inPacket->pts != AV_NOPTS_VALUE) {
+                    inPacket->pts += delta;
+                }
+            }
+            if(inPacket->dts != AV_NOPTS_VALUE) {
+                lastDts[outStreamId] = inPacket->dts;
+            }
+
+            inPacket->stream_index = outStreamId;
+            inPacket->time_base = newStream->time_base;
+            inPacket->pos = -1;
+
+            if(av_interleaved_write_frame(outFmtCtx, inPacket) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Error during write packet\n");
+            }
+            av_packet_unref(inPacket);
+        }
+
+        offsetUs += segmentEndUs;
+        avformat_close_input(&inFmtCtx);
+    }
+
+    av_log(NULL, AV_LOG_INFO, "concat %zu inputs, duration %.3fs, waited %.3fs for prefetched inputs\n",
+           srcs.size(), offsetUs / (double)AV_TIME_BASE, waitSec);
+
+    if(av_write_trailer(outFmtCtx) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Write trailer failed\n");
+    }
+
+    avio_closep(&outFmtCtx->pb);
+    av_packet_free(&inPacket);
+    avformat_free_context(outFmtCtx);
+}
@@ -0,0 +1,205 @@
+#include "remuxing.h"
+#include "moovReserve.h"
+#include <chrono>
+#include <climits>
+#include <map>
+#include <vector>
+
+const char *mp4LayoutName(Mp4Layout layout) {
+    switch(layout) {
+    case Mp4Layout::MoovAtEnd:
+        return "moov_at_end";
+    case Mp4Layout::Faststart:
+        return "faststart";
+    case Mp4Layout::ReservedMoov:
+        return "reserved_moov";
+    case Mp4Layout::Fragmented:
+        return "fragmented";
+    }
+    return "unknown";
+}
+
+// 每次输出各自的opaque，多个线程同时输出时互不影响
+struct LayoutOutput {
+    Mp4LayoutStats *stats = nullptr;
+    int (*origIoClose2)(AVFormatContext *s, AVIOContext *pb) = nullptr;
+};
+
+// faststart在写完trailer后重新打开输出文件读回数据，统计这部分读取
+static int layout_io_close2(AVFormatContext *s, AVIOContext *pb) {
+    LayoutOutput *out = (LayoutOutput *)s->opaque;
+    if(pb && !pb->write_flag) {
+        out->stats->bytesRead += pb->bytes_read;
+    }
+    return out->origIoClose2(s, pb);
+}
+
+enum class LayoutResult {
+    Ok,
+    Failed,
+    MoovOverflow,   // 实际的packet数超出了预留的空间
+};
+
+static LayoutResult remuxMp4Once(const std::string &src, const std::string &dst, Mp4Layout layout,
+                                 int64_t &moovSize, Mp4LayoutStats &stats) {
+    AVFormatContext *inFmtCtx = nullptr;
+    if(avformat_open_input(&inFmtCtx, src.c_str(), NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open src file failed.\n");
+        return LayoutResult::Failed;
+    }
+
+    if(avformat_find_stream_info(inFmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info failed\n");
+        avformat_close_input(&inFmtCtx);
+        return LayoutResult::Failed;
+    }
+
+    AVPacket *inPacket = av_packet_alloc();
+    if(inPacket == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate Packet failed.\n");
+        avformat_close_input(&inFmtCtx);
+        return LayoutResult::Failed;
+    }
+
+    AVFormatContext *outFmtCtx = nullptr;
+    if(avformat_alloc_output_context2(&outFmtCtx, NULL, "mp4", dst.c_str()) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate output context failed.\n");
+        av_packet_free(&inPacket);
+        avformat_close_input(&inFmtCtx);
+        return LayoutResult::Failed;
+    }
+
+    if(avio_open(&outFmtCtx->pb, dst.c_str(), AVIO_FLAG_WRITE) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "IO Open failed.\n");
+        av_packet_free(&inPacket);
+        avformat_close_input(&inFmtCtx);
+        avformat_free_context(outFmtCtx);
+        return LayoutResult::Failed;
+    }
+    LayoutOutput layoutOut;
+    layoutOut.stats = &stats;
+    layoutOut.origIoClose2 = outFmtCtx->io_close2;
+    outFmtCtx->opaque = &layoutOut;
+    outFmtCtx->io_close2 = layout_io_close2;
+
+    std::map<int, int> streamIdxMap;
+    for(int i = 0; i < inFmtCtx->nb_streams; ++i) {
+        if(inFmtCtx->streams[i]->codecpar->codec_id == AV_CODEC_ID_NONE) {
+            continue;
+        }
+        AVStream *strm = avformat_new_stream(outFmtCtx, NULL);
+        strm->id = outFmtCtx->nb_streams - 1;
+        strm->index = outFmtCtx->nb_streams - 1;
+        streamIdxMap[i] = strm->index;
+        avcodec_parameters_copy(strm->codecpar, inFmtCtx->streams[i]->codecpar);
+        strm->time_base = inFmtCtx->streams[i]->time_base;
+    }
+
+    // 预留模式下先估计moov的大小，估计不出来时改为分片输出
+    if(layout == Mp4Layout::ReservedMoov && moovSize <= 0) {
+        moovSize = estimateMoovSize(inFmtCtx, outFmtCtx, streamIdxMap, true);
+        if(moovSize <= 0 || moovSize > INT_MAX) {
+            av_log(NULL, AV_LOG_WARNING, "Cannot estimate moov size, fall back to fragmented output\n");
+            layout = Mp4Layout::Fragmented;
+            moovSize = 0;
+        }
+    }
+    stats.layout = layout;
+    stats.reservedMoovSize = layout == Mp4Layout::ReservedMoov ? moovSize : 0;
+
+    AVDictionary *muxOpts = nullptr;
+    if(layout == Mp4Layout::Faststart) {
+        av_dict_set(&muxOpts, "movflags", "faststart", 0);
+    } else if(layout == Mp4Layout::ReservedMoov) {
+        // movenc在ftyp之后跳过moov_size字节，trailer时把moov写回这里，剩余部分填充为free box
+        av_dict_set_int(&muxOpts, "moov_size", moovSize, 0);
+    } else if(layout == Mp4Layout::Fragmented) {
+        av_dict_set(&muxOpts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    }
+
+    bool headerWritten = avformat_write_header(outFmtCtx, &muxOpts) >= 0;
+    av_dict_free(&muxOpts);
+    if(!headerWritten) {
+        av_log(NULL, AV_LOG_ERROR, "Write header failed.\n");
+    }
+
+    // 按实际写入的packet数累计moov的上限，超出预留空间时moov会覆盖mdat，必须在trailer之前放弃
+    std::vector<int> bytesPerSample(outFmtCtx->nb_streams);
+    for(int i = 0; i < outFmtCtx->nb_streams; ++i) {
+        bytesPerSample[i] = moovBytesPerSample(outFmtCtx->streams[i]->codecpar);
+    }
+    int64_t moovBound = moovFixedSize(outFmtCtx);
+
+    LayoutResult result = headerWritten ? LayoutResult::Ok : LayoutResult::Failed;
+    while(result == LayoutResult::Ok && av_read_frame(inFmtCtx, inPacket) >= 0) {
+        if(streamIdxMap.find(inPacket->stream_index) == streamIdxMap.end()) {
+            av_packet_unref(inPacket);
+            continue;
+        }
+        auto &oldStream = inFmtCtx->streams[inPacket->stream_index];
+        auto &newStream = outFmtCtx->streams[streamIdxMap[inPacket->stream_index]];
+
+        inPacket->dts = av_rescale_q(inPacket->dts, oldStream->time_base, newStream->time_base);
+        inPacket->pts = av_rescale_q(inPacket->pts, oldStream->time_base, newStream->time_base);
+        inPacket->duration = av_rescale_q(inPacket->duration, oldStream->time_base, newStream->time_base);
+        inPacket->stream_index = streamIdxMap[inPacket->stream_index];
+        inPacket->time_base = newStream->time_base;
+
+        moovBound += bytesPerSample[inPacket->stream_index];
+        if(layout == Mp4Layout::ReservedMoov && moovBound > moovSize) {
+            result = LayoutResult::MoovOverflow;
+        } else if(av_interleaved_write_frame(outFmtCtx, inPacket) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error during write packet\n");
+        }
+        av_packet_unref(inPacket);
+    }
+
+    if(result == LayoutResult::Ok && av_write_trailer(outFmtCtx) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Write trailer failed\n");
+        result = LayoutResult::Failed;
+    }
+
+    // faststart的回写也经过同一个pb，bytes_written包含了两次写入
+    if(outFmtCtx->pb) {
+        avio_flush(outFmtCtx->pb);
+        stats.bytesWritten += outFmtCtx->pb->bytes_written;
+        if(result == LayoutResult::MoovOverflow) {
+            stats.discardedBytes += outFmtCtx->pb->bytes_written;
+        }
+        stats.fileSize = result == LayoutResult::Ok ? avio_size(outFmtCtx->pb) : 0;
+    }
+
+    // 释放相关资源
+    avio_closep(&outFmtCtx->pb);
+    av_packet_free(&inPacket);
+    avformat_close_input(&inFmtCtx);
+    avformat_free_context(outFmtCtx);
+    return result;
+}
+
+bool remuxingMp4Layout(std::string src, std::string dst, Mp4Layout layout, Mp4LayoutStats *stats) {
+    auto begin = std::chrono::steady_clock::now();
+
+    Mp4LayoutStats result;
+    int64_t moovSize = 0;
+    LayoutResult ret = remuxMp4Once(src, dst, layout, moovSize, result);
+    if(ret == LayoutResult::MoovOverflow) {
+        // 估计偏小，已经写入的部分作废，改为分片输出重新拷贝一遍，作废的字节数计入统计
+        av_log(NULL, AV_LOG_WARNING, "Reserved moov size %lld is too small, %lld bytes discarded, fall back to fragmented output\n",
+               (long long)moovSize, (long long)result.discardedBytes);
+        ++result.attempts;
+        ret = remuxMp4Once(src, dst, Mp4Layout::Fragmented, moovSize, result);
+    }
+
+    result.wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    av_log(NULL, AV_LOG_INFO, "mp4 layout %s : reserved moov %lld, file %lld bytes, written %lld bytes "
+           "(%lld discarded in %d attempts), read back %lld bytes, %.3fs\n",
+           mp4LayoutName(result.layout), (long long)result.reservedMoovSize, (long long)result.fileSize,
+           (long long)result.bytesWritten, (long long)result.discardedBytes, result.attempts,
+           (long long)result.bytesRead, result.wallSec);
+
+    if(stats) {
+        *stats = result;
+    }
+    return ret == LayoutResult::Ok;
+}
@@ -0,0 +1,271 @@
+#include "remuxing.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <thread>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// 流式输出的状态，记录输出的第一个字节、第一个分片可读的时间
+struct StreamingOutput {
+    StreamingRemuxStats stats;
+    std::chrono::steady_clock::time_point begin;
+    int64_t mediaUs = 0;                // 当前读到的输入的媒体时间(相对第一个packet)
+
+    // FragmentedMP4 : 自定义IO写文件，解析写出的box，mdat写完表示一个分片完整了
+    FILE *file = nullptr;
+    int64_t written = 0;
+    int64_t nextBoxPos = 0;             // 下一个box头的位置
+    uint8_t boxHeader[8] = {0};
+    int boxHeaderLen = 0;
+    int64_t fragmentEnd = -1;           // 当前mdat的结束位置
+    bool parseBoxes = true;
+
+    // Segmented : 拦截hls muxer打开/关闭文件，分片文件关闭时就可读了
+    int (*origIoOpen)(AVFormatContext *s, AVIOContext **pb, const char *url, int flags, AVDictionary **options) = nullptr;
+    int (*origIoClose2)(AVFormatContext *s, AVIOContext *pb) = nullptr;
+    std::map<AVIOContext *, std::string> openedUrls;
+
+    double elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    void onBytes(int64_t size) {
+        if(stats.firstByteSec < 0) {
+            stats.firstByteSec = elapsed();
+        }
+        stats.bytesWritten += size;
+    }
+
+    void onFragment() {
+        if(stats.fragments == 0) {
+            stats.firstFragmentSec = elapsed();
+            stats.firstFragmentMediaSec = mediaUs / (double)AV_TIME_BASE;
+        }
+        ++stats.fragments;
+    }
+};
+
+static int streaming_write_packet(void *opaque, const uint8_t *buf, int buf_size) {
+    StreamingOutput *out = (StreamingOutput *)opaque;
+    if(fwrite(buf, 1, buf_size, out->file) != (size_t)buf_size) {
+        return AVERROR(EIO);
+    }
+    // 写出去后消费者马上就能读到
+    fflush(out->file);
+    out->onBytes(buf_size);
+
+    // 按box头解析写出的数据，数据块和box的边界不一定对齐
+    int64_t chunkBegin = out->written;
+    int64_t chunkEnd = out->written + buf_size;
+    while(out->parseBoxes && out->nextBoxPos + out->boxHeaderLen < chunkEnd) {
+        out->boxHeader[out->boxHeaderLen] = buf[out->nextBoxPos + out->boxHeaderLen - chunkBegin];
+        if(++out->boxHeaderLen < 8) {
+            continue;
+        }
+
+        uint32_t size = (out->boxHeader[0] << 24) | (out->boxHeader[1] << 16) | (out->boxHeader[2] << 8) | out->boxHeader[3];
+        if(size < 8) {
+            // 64位长度或者一直到文件尾的box，分片模式下不会出现，不再解析
+            out->parseBoxes = false;
+            break;
+        }
+        if(memcmp(out->boxHeader + 4, "mdat", 4) == 0) {
+            out->fragmentEnd = out->nextBoxPos + size;
+        }
+        out->nextBoxPos += size;
+        out->boxHeaderLen = 0;
+    }
+    out->written = chunkEnd;
+
+    if(out->fragmentEnd > 0 && out->written >= out->fragmentEnd) {
+        out->fragmentEnd = -1;
+        out->onFragment();
+    }
+    return buf_size;
+}
+
+static bool endsWith(const std::string &str, const std::string &suffix) {
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static int streaming_io_open(AVFormatContext *s, AVIOContext **pb, const char *url, int flags, AVDictionary **options) {
+    StreamingOutput *out = (StreamingOutput *)s->opaque;
+    int ret = out->origIoOpen(s, pb, url, flags, options);
+    if(ret >= 0) {
+        out->openedUrls[*pb] = url;
+    }
+    return ret;
+}
+
+static int streaming_io_close2(AVFormatContext *s, AVIOContext *pb) {
+    StreamingOutput *out = (StreamingOutput *)s->opaque;
+    auto it = out->openedUrls.find(pb);
+    if(it != out->openedUrls.end()) {
+        out->onBytes(avio_tell(pb));
+        if(endsWith(it->second, ".m4s")) {
+            out->onFragment();
+        }
+        out->openedUrls.erase(it);
+    }
+    return out->origIoClose2(s, pb);
+}
+
+void remuxingStreaming(std::string src, std::string dst, const StreamingRemuxOptions &options, StreamingRemuxStats *stats) {
+    StreamingOutput out;
+    out.begin = std::chrono::steady_clock::now();
+
+    AVFormatContext *inFmtCtx = nullptr;
+    if(avformat_open_input(&inFmtCtx, src.c_str(), NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open src file failed.\n");
+        return;
+    }
+
+    if(avformat_find_stream_info(inFmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info failed\n");
+        avformat_close_input(&inFmtCtx);
+        return;
+    }
+
+    AVPacket *inPacket = av_packet_alloc();
+    if(inPacket == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate Packet failed.\n");
+        avformat_close_input(&inFmtCtx);
+        return;
+    }
+
+    // 分片模式写mp4，分段模式由hls muxer自己创建分片文件和播放列表
+    bool segmented = options.mode == StreamingOutputMode::Segmented;
+    AVFormatContext *outFmtCtx = nullptr;
+    if(avformat_alloc_output_context2(&outFmtCtx, NULL, segmented ? "hls" : "mp4", dst.c_str()) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate output context failed.\n");
+        av_packet_free(&inPacket);
+        avformat_close_input(&inFmtCtx);
+        return;
+    }
+
+    AVDictionary *muxOpts = nullptr;
+    AVIOContext *ioCtx = nullptr;
+    if(segmented) {
+        std::string stem = dst.substr(0, dst.find_last_of('.'));
+        std::string initName = stem.substr(stem.find_last_of('/') + 1) + "_init.mp4";
+        av_dict_set(&muxOpts, "hls_time", std::to_string(options.fragmentDurationMs / 1000.0).c_str(), 0);
+        av_dict_set_int(&muxOpts, "hls_list_size", options.playlistSize, 0);
+        av_dict_set(&muxOpts, "hls_segment_type", "fmp4", 0);
+        av_dict_set(&muxOpts, "hls_fmp4_init_filename", initName.c_str(), 0);
+        av_dict_set(&muxOpts, "hls_segment_filename", (stem + "_%d.m4s").c_str(), 0);
+        // 滚动的播放列表，删除已经移出列表的分片
+        av_dict_set(&muxOpts, "hls_flags", options.playlistSize > 0 ? "independent_segments+delete_segments" : "independent_segments", 0);
+
+        outFmtCtx->opaque = &out;
+        out.origIoOpen = outFmtCtx->io_open;
+        out.origIoClose2 = outFmtCtx->io_close2;
+        outFmtCtx->io_open = streaming_io_open;
+        outFmtCtx->io_close2 = streaming_io_close2;
+    } else {
+        out.file = fopen(dst.c_str(), "wb");
+        if(out.file == nullptr) {
+            av_log(NULL, AV_LOG_ERROR, "Open output file failed.\n");
+            av_packet_free(&inPacket);
+            avformat_close_input(&inFmtCtx);
+            avformat_free_context(outFmtCtx);
+            return;
+        }
+        // 不可seek的自定义IO，写出的数据就是最终的文件内容
+        const int IO_BUFFER_SIZE = 32 * 1024;
+        unsigned char *ioBuffer = (unsigned char *)av_malloc(IO_BUFFER_SIZE);
+        ioCtx = avio_alloc_context(ioBuffer, IO_BUFFER_SIZE, 1, &out, NULL, streaming_write_packet, NULL);
+        outFmtCtx->pb = ioCtx;
+        outFmtCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+        // 空的moov放在最前面，之后每个分片是moof+mdat，每个分片写完立即flush
+        av_dict_set(&muxOpts, "movflags", "empty_moov+default_base_moof+cmaf", 0);
+        av_dict_set_int(&muxOpts, "frag_duration", (int64_t)options.fragmentDurationMs * 1000, 0);
+        av_dict_set_int(&muxOpts, "flush_packets", 1, 0);
+    }
+
+    std::map<int, int> streamIdxMap;
+    for(int i = 0; i < inFmtCtx->nb_streams; ++i) {
+        if(inFmtCtx->streams[i]->codecpar->codec_id == AV_CODEC_ID_NONE) {
+            continue;
+        }
+        AVStream *strm = avformat_new_stream(outFmtCtx, NULL);
+        strm->id = outFmtCtx->nb_streams - 1;
+        strm->index = outFmtCtx->nb_streams - 1;
+        streamIdxMap[i] = strm->index;
+        avcodec_parameters_copy(strm->codecpar, inFmtCtx->streams[i]->codecpar);
+        strm->time_base = inFmtCtx->streams[i]->time_base;
+    }
+
+    bool headerWritten = avformat_write_header(outFmtCtx, &muxOpts) >= 0;
+    av_dict_free(&muxOpts);
+    if(!headerWritten) {
+        av_log(NULL, AV_LOG_ERROR, "Write header failed.\n");
+    }
+
+    int64_t firstDtsUs = AV_NOPTS_VALUE;
+    while(headerWritten && av_read_frame(inFmtCtx, inPacket) >= 0) {
+        if(streamIdxMap.find(inPacket->stream_index) == streamIdxMap.end()) {
+            av_packet_unref(inPacket);
+            continue;
+        }
+        auto &oldStream = inFmtCtx->streams[inPacket->stream_index];
+        auto &newStream = outFmtCtx->streams[streamIdxMap[inPacket->stream_index]];
+
+        // 记录输入的媒体时间，用来衡量第一个分片可读时输入读到了哪里
+        if(inPacket->dts != AV_NOPTS_VALUE) {
+            int64_t dtsUs = av_rescale_q(inPacket->dts, oldStream->time_base, AV_TIME_BASE_Q);
+            if(firstDtsUs == AV_NOPTS_VALUE) {
+                firstDtsUs = dtsUs;
+            }
+            out.mediaUs = std::max(out.mediaUs, dtsUs - firstDtsUs);
+
+            // 模拟实时的输入，按时间戳的节奏读取
+            if(options.realtime) {
+                double ahead = out.mediaUs / (double)AV_TIME_BASE - out.elapsed();
+                if(ahead > 0) {
+                    std::this_thread::sleep_for(std::chrono::duration<double>(ahead));
+                }
+            }
+        }
+
+        inPacket->dts = av_rescale_q(inPacket->dts, oldStream->time_base, newStream->time_base);
+        inPacket->pts = av_rescale_q(inPacket->pts, oldStream->time_base, newStream->time_base);
+        inPacket->duration = av_rescale_q(inPacket->duration, oldStream->time_base, newStream->time_base);
+        inPacket->stream_index = streamIdxMap[inPacket->stream_index];
+        inPacket->time_base = newStream->time_base;
+
+        if(av_interleaved_write_frame(outFmtCtx, inPacket) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error during write packet\n");
+        }
+        av_packet_unref(inPacket);
+    }
+
+    if(headerWritten && av_write_trailer(outFmtCtx) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Write trailer failed\n");
+    }
+
+    av_log(NULL, AV_LOG_INFO, "streaming output : first byte %.3fs, first fragment %.3fs (input at %.3fs), "
+           "%d fragments, %lld bytes\n",
+           out.stats.firstByteSec, out.stats.firstFragmentSec, out.stats.firstFragmentMediaSec,
+           out.stats.fragments, (long long)out.stats.bytesWritten);
+    if(stats) {
+        *stats = out.stats;
+    }
+
+    // 释放相关资源
+    if(ioCtx) {
+        av_freep(&ioCtx->buffer);
+        avio_context_free(&ioCtx);
+        outFmtCtx->pb = nullptr;
+    }
+    if(out.file) {
+        fclose(out.file);
+    }
+    av_packet_free(&inPacket);
+    avformat_close_input(&inFmtCtx);
+    avformat_free_context(outFmtCtx);
+}
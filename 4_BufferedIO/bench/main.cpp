@@ -0,0 +1,56 @@
+#include "bufferedIO.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/log.h>
+}
+
+// 对一组文件，扫描不同的AVIO缓冲区大小和读取方式，统计吞吐和IO开销
+// 用法 : ./4_BufferedIO_bench file1.mp4 file2.ts ...
+// 不传参数时使用 ../res/big_buck_bunny.mp4
+int main(int argc, char *argv[]) {
+    std::vector<std::string> corpus;
+    for(int i = 1; i < argc; ++i) {
+        corpus.push_back(argv[i]);
+    }
+    if(corpus.empty()) {
+        corpus.push_back("../res/big_buck_bunny.mp4");
+    }
+
+    const std::vector<int> bufferSizes = {4096, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024};
+    const std::vector<IOStrategy> strategies = {IOStrategy::Memcpy, IOStrategy::Mmap, IOStrategy::Direct};
+
+    // 统计期间关闭FFmpeg的日志输出，只保留错误
+    av_log_set_level(AV_LOG_ERROR);
+
+    printf("%-32s %-8s %-9s %8s %10s %9s %9s %8s %9s %9s %8s\n",
+           "file", "strategy", "adaptive", "bufsize", "MB/s", "syscalls", "callbacks", "seeks", "minflt", "cpu(ms)", "window");
+    for(auto &url : corpus) {
+        for(auto strategy : strategies) {
+            for(int adaptive = 0; adaptive <= 1; ++adaptive) {
+                for(int bufferSize : bufferSizes) {
+                    BufferedIOConfig config;
+                    config.strategy = strategy;
+                    config.bufferSize = bufferSize;
+                    config.adaptive = adaptive;
+
+                    BufferedIOStats stats;
+                    if(!bufferedIOFile(url, config, stats)) {
+                        fprintf(stderr, "demux %s failed\n", url.c_str());
+                        continue;
+                    }
+
+                    double mbps = stats.wallSec > 0 ? stats.bytesRead / 1024.0 / 1024.0 / stats.wallSec : 0;
+                    printf("%-32s %-8s %-9s %8d %10.1f %9lld %9lld %8lld %9lld %9.2f %8d\n",
+                           url.c_str(), ioStrategyName(strategy), adaptive ? "yes" : "no", bufferSize, mbps,
+                           (long long)stats.syscalls, (long long)stats.readCalls, (long long)stats.seekCalls,
+                           (long long)stats.minorFaults, stats.cpuSec * 1000, stats.finalWindowSize);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
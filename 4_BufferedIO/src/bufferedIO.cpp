@@ -1,4 +1,12 @@
 #include "bufferedIO.h"
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -95,4 +103,299 @@ void bufferedIO(uint8_t *buffer, int size) {
     av_packet_free(&packet);
     avio_context_free(&ioCtx);
     avformat_close_input(&fmtCtx);
-}
\ No newline at end of file
+}
+
+// ---------------------------------------------------------------------------
+// 下面是以不同的读取方式从文件做自定义IO，用于对比AVIO缓冲区大小和读取方式的开销
+
+// 连续顺序读达到这个次数后，预读窗口翻倍
+const int SEQUENTIAL_READS_TO_GROW = 4;
+// Memcpy方式下把文件读入内存时，每次read的大小
+const int LOAD_CHUNK_SIZE = 1024 * 1024;
+
+struct FileIOSource {
+    IOStrategy strategy = IOStrategy::Memcpy;
+    int fd = -1;
+    uint8_t *data = nullptr;        // Memcpy: 堆内存，Mmap: 映射区
+    int64_t size = 0;
+    int64_t pos = 0;
+
+    // 自适应预读
+    bool adaptive = false;
+    int initWindowSize = 0;
+    int maxWindowSize = 0;
+    int windowSize = 0;             // 当前预读窗口的大小
+    uint8_t *window = nullptr;      // Direct方式下的预读缓存，容量为maxWindowSize
+    int64_t windowPos = 0;          // 预读缓存对应文件中的起始位置
+    int windowLen = 0;
+    int64_t advisedEnd = 0;         // Mmap方式下已经madvise过的位置
+    int64_t lastReadEnd = -1;
+    int sequentialReads = 0;
+
+    BufferedIOStats *stats = nullptr;
+};
+
+const char *ioStrategyName(IOStrategy strategy) {
+    switch(strategy) {
+    case IOStrategy::Memcpy: return "memcpy";
+    case IOStrategy::Mmap:   return "mmap";
+    case IOStrategy::Direct: return "direct";
+    }
+    return "unknown";
+}
+
+// 顺序读时增大预读窗口，发生跳转时恢复成初始大小
+static void updateWindow(FileIOSource *src) {
+    if(src->pos == src->lastReadEnd) {
+        if(++src->sequentialReads >= SEQUENTIAL_READS_TO_GROW && src->windowSize < src->maxWindowSize) {
+            src->windowSize = std::min(src->windowSize * 2, src->maxWindowSize);
+            src->sequentialReads = 0;
+        }
+    } else {
+        src->sequentialReads = 0;
+        src->windowSize = src->initWindowSize;
+    }
+}
+
+// pread直到读满len或者到文件尾
+static int preadFull(FileIOSource *src, uint8_t *buf, int len, int64_t offset) {
+    int total = 0;
+    while(total < len) {
+        ssize_t n = pread(src->fd, buf + total, len - total, offset + total);
+        ++src->stats->syscalls;
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return AVERROR(errno);
+        }
+        if(n == 0) {
+            break;
+        }
+        total += n;
+    }
+    return total;
+}
+
+int file_read_packet(void *opaque, uint8_t *buf, int buf_size) {
+    FileIOSource *src = (FileIOSource *)opaque;
+    ++src->stats->readCalls;
+    if(src->pos >= src->size) {
+        return AVERROR_EOF;
+    }
+
+    int read_len = (int)std::min<int64_t>(buf_size, src->size - src->pos);
+    if(src->adaptive) {
+        updateWindow(src);
+    }
+
+    if(src->strategy == IOStrategy::Direct) {
+        if(src->adaptive && src->windowSize > read_len) {
+            // 不在预读缓存中，一次pread整个窗口
+            if(src->pos < src->windowPos || src->pos + read_len > src->windowPos + src->windowLen) {
+                int ret = preadFull(src, src->window, src->windowSize, src->pos);
+                if(ret < 0) {
+                    return ret;
+                }
+                src->windowPos = src->pos;
+                src->windowLen = ret;
+            }
+            read_len = (int)std::min<int64_t>(read_len, src->windowPos + src->windowLen - src->pos);
+            memcpy(buf, src->window + (src->pos - src->windowPos), read_len);
+        } else {
+            int ret = preadFull(src, buf, read_len, src->pos);
+            if(ret <= 0) {
+                return ret < 0 ? ret : AVERROR_EOF;
+            }
+            read_len = ret;
+        }
+    } else {
+        // Mmap方式下，提前告诉内核接下来一个窗口会被读到，减少同步的缺页
+        if(src->strategy == IOStrategy::Mmap && src->adaptive && src->pos + read_len > src->advisedEnd) {
+            const int64_t pageSize = sysconf(_SC_PAGESIZE);
+            int64_t begin = src->pos / pageSize * pageSize;
+            int64_t end = std::min<int64_t>(src->pos + src->windowSize, src->size);
+            madvise(src->data + begin, end - begin, MADV_WILLNEED);
+            ++src->stats->syscalls;
+            src->advisedEnd = end;
+        }
+        memcpy(buf, src->data + src->pos, read_len);
+    }
+
+    src->pos += read_len;
+    src->lastReadEnd = src->pos;
+    src->stats->bytesRead += read_len;
+    return read_len;
+}
+
+int64_t file_seek(void *opaque, int64_t offset, int whence) {
+    FileIOSource *src = (FileIOSource *)opaque;
+    int64_t newPos = 0;
+    switch(whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return src->size;
+    case SEEK_SET:
+        newPos = offset;
+        break;
+    case SEEK_CUR:
+        newPos = src->pos + offset;
+        break;
+    case SEEK_END:
+        newPos = src->size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if(newPos < 0 || newPos > src->size) {
+        return AVERROR(EINVAL);
+    }
+
+    ++src->stats->seekCalls;
+    src->pos = newPos;
+    return newPos;
+}
+
+// 根据读取方式准备文件数据
+static bool openFileIOSource(FileIOSource &src, const std::string &url) {
+    src.fd = open(url.c_str(), O_RDONLY);
+    ++src.stats->syscalls;
+    if(src.fd < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open file %s failed\n", url.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(src.fd, &st) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Stat file %s failed\n", url.c_str());
+        return false;
+    }
+    src.size = st.st_size;
+    src.stats->fileSize = src.size;
+
+    if(src.strategy == IOStrategy::Memcpy) {
+        src.data = (uint8_t *)av_malloc(src.size);
+        if(src.data == nullptr) {
+            av_log(NULL, AV_LOG_ERROR, "Allocate file buffer failed\n");
+            return false;
+        }
+        int64_t loaded = 0;
+        while(loaded < src.size) {
+            ssize_t n = read(src.fd, src.data + loaded, std::min<int64_t>(LOAD_CHUNK_SIZE, src.size - loaded));
+            ++src.stats->syscalls;
+            if(n <= 0) {
+                av_log(NULL, AV_LOG_ERROR, "Read file %s failed\n", url.c_str());
+                return false;
+            }
+            loaded += n;
+        }
+    } else if(src.strategy == IOStrategy::Mmap) {
+        void *addr = mmap(nullptr, src.size, PROT_READ, MAP_SHARED, src.fd, 0);
+        ++src.stats->syscalls;
+        if(addr == MAP_FAILED) {
+            av_log(NULL, AV_LOG_ERROR, "Mmap file %s failed\n", url.c_str());
+            return false;
+        }
+        src.data = (uint8_t *)addr;
+    } else if(src.adaptive) {
+        src.window = (uint8_t *)av_malloc(src.maxWindowSize);
+        if(src.window == nullptr) {
+            av_log(NULL, AV_LOG_ERROR, "Allocate read ahead window failed\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void closeFileIOSource(FileIOSource &src) {
+    if(src.strategy == IOStrategy::Mmap && src.data) {
+        munmap(src.data, src.size);
+    } else {
+        av_freep(&src.data);
+    }
+    av_freep(&src.window);
+    if(src.fd >= 0) {
+        close(src.fd);
+        src.fd = -1;
+    }
+}
+
+static double timevalToSec(const struct timeval &tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+bool bufferedIOFile(const std::string &url, const BufferedIOConfig &config, BufferedIOStats &stats) {
+    stats = BufferedIOStats();
+
+    struct rusage usageBegin;
+    getrusage(RUSAGE_SELF, &usageBegin);
+    auto wallBegin = std::chrono::steady_clock::now();
+
+    FileIOSource src;
+    src.strategy = config.strategy;
+    src.adaptive = config.adaptive;
+    src.initWindowSize = config.bufferSize;
+    src.maxWindowSize = std::max(config.bufferSize, config.maxWindowSize);
+    src.windowSize = config.bufferSize;
+    src.stats = &stats;
+    if(!openFileIOSource(src, url)) {
+        closeFileIOSource(src);
+        return false;
+    }
+
+    AVFormatContext *fmtCtx = avformat_alloc_context();
+    if(fmtCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate avformat context failed\n");
+        closeFileIOSource(src);
+        return false;
+    }
+
+    // AVIOContext的缓冲区，这个大小就是每次read_packet回调请求的大小
+    unsigned char *avio_ctx_buffer = (unsigned char *)av_malloc(config.bufferSize);
+    AVIOContext *ioCtx = avio_alloc_context(avio_ctx_buffer, config.bufferSize, 0, &src, file_read_packet, NULL, file_seek);
+    if(ioCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate AVIOContext failed\n");
+        av_free(avio_ctx_buffer);
+        avformat_free_context(fmtCtx);
+        closeFileIOSource(src);
+        return false;
+    }
+    fmtCtx->pb = ioCtx;
+
+    bool success = false;
+    AVPacket *packet = nullptr;
+    if(avformat_open_input(&fmtCtx, NULL, NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "AVFormat open input failed\n");
+        // 失败时avformat_open_input会释放fmtCtx
+    } else if(avformat_find_stream_info(fmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info failed\n");
+    } else if((packet = av_packet_alloc()) == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate Packet failed.\n");
+    } else {
+        while(av_read_frame(fmtCtx, packet) >= 0) {
+            ++stats.packets;
+            av_packet_unref(packet);
+        }
+        success = true;
+    }
+
+    av_packet_free(&packet);
+    avformat_close_input(&fmtCtx);
+    // AVIOContext内部可能重新申请过缓冲区，需要释放的是ioCtx->buffer
+    av_freep(&ioCtx->buffer);
+    avio_context_free(&ioCtx);
+    closeFileIOSource(src);
+
+    auto wallEnd = std::chrono::steady_clock::now();
+    struct rusage usageEnd;
+    getrusage(RUSAGE_SELF, &usageEnd);
+
+    stats.finalWindowSize = src.windowSize;
+    stats.wallSec = std::chrono::duration<double>(wallEnd - wallBegin).count();
+    stats.cpuSec = timevalToSec(usageEnd.ru_utime) - timevalToSec(usageBegin.ru_utime)
+                 + timevalToSec(usageEnd.ru_stime) - timevalToSec(usageBegin.ru_stime);
+    stats.minorFaults = usageEnd.ru_minflt - usageBegin.ru_minflt;
+    stats.majorFaults = usageEnd.ru_majflt - usageBegin.ru_majflt;
+
+    return success;
+}
@@ -1,4 +1,40 @@
 #pragma once
 #include <stdint.h>
+#include <string>
 
-void bufferedIO(uint8_t *buffer, int size);
\ No newline at end of file
+void bufferedIO(uint8_t *buffer, int size);
+
+// 自定义IO的读取方式
+enum class IOStrategy {
+    Memcpy,     // 先把整个文件read到内存，read_packet回调中memcpy
+    Mmap,       // 文件mmap到内存，read_packet回调中从映射区memcpy，开销变成缺页中断
+    Direct,     // read_packet回调中直接pread到AVIOContext的缓冲区，没有中间拷贝
+};
+
+struct BufferedIOConfig {
+    IOStrategy strategy = IOStrategy::Memcpy;
+    int bufferSize = 4096;              // AVIOContext的缓冲区大小
+    bool adaptive = false;              // 检测到顺序读时，逐步增大预读窗口
+    int maxWindowSize = 4 * 1024 * 1024;// 自适应模式下预读窗口的上限
+};
+
+// 一次解封装的IO统计
+struct BufferedIOStats {
+    int64_t fileSize = 0;
+    int64_t bytesRead = 0;      // read_packet回调返回的总字节数
+    int64_t readCalls = 0;      // read_packet回调的次数
+    int64_t seekCalls = 0;      // seek回调的次数(不含AVSEEK_SIZE)
+    int64_t syscalls = 0;       // IO相关的系统调用次数 read/pread/mmap/madvise
+    int64_t minorFaults = 0;    // 缺页中断，mmap方式下主要的开销
+    int64_t majorFaults = 0;
+    int packets = 0;
+    int finalWindowSize = 0;    // 自适应模式最终的预读窗口大小
+    double wallSec = 0;
+    double cpuSec = 0;          // user + sys
+};
+
+// 以指定的IO方式打开文件，走自定义AVIOContext解封装所有的packet，并统计IO开销
+// @return 成功解封装返回true
+bool bufferedIOFile(const std::string &url, const BufferedIOConfig &config, BufferedIOStats &stats);
+
+const char *ioStrategyName(IOStrategy strategy);
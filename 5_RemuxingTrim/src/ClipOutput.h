@@ -0,0 +1,30 @@
+#pragma once
+#include "RemuxingTrim.h"
+#include "StreamMapItem.h"
+#include <map>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// 一个片段的输出
+struct ClipOutput {
+    TrimClip clip;
+    AVFormatContext *outFmtCtx = nullptr;
+    std::map<int, StreamMapItem> streamIdxMap;  // 输入流id -> 片段中的流
+    bool opened = false;
+    bool closed = false;
+    bool failed = false;    // 写入packet或者尾部数据出错
+    int packetNum = 0;
+};
+
+// 创建片段的输出文件，流信息拷贝自输入
+bool openClipOutput(AVFormatContext *inFmtCtx, ClipOutput &out);
+
+// 写入尾部数据并释放输出
+// @return 片段写入过程中出过错时返回false
+bool closeClipOutput(ClipOutput &out);
+
+// 按片段自己每一路流的首帧重新计算时间戳，写入片段
+// @return 读取位置已经超过片段的结束时间时返回false，写入出错时设置out.failed
+bool writeClipPacket(AVFormatContext *inFmtCtx, ClipOutput &out, const AVPacket *inPacket, AVPacket *outPacket);
@@ -1,24 +1,11 @@
 #include "RemuxingTrim.h"
-#include <map>
+#include "streamDescriptor.h"
+#include <vector>
 
 extern "C" {
 #include <libavformat/avformat.h>
 }
 
-// 主要用于记录每一路流的首帧时间
-struct PacketTime {
-    int64_t dts = 0;
-    int64_t pts = 0;
-};
-
-// 用于记录转封装时路的映射信息
-struct StreamMapItem {
-    int srcStreamId = -1;
-    int dstStreamId = -1;
-    PacketTime firstPacketTime;
-    bool isFirstPkt = true;
-};
-
 // src : 输入的url
 // dst : 输出的url
 // startTimeMs : 裁剪的起始时间，单位(ms), 如果<=0则从视频第一帧开始
@@ -73,8 +60,8 @@ void remuxingTrim(std::string src, std::string dst, int64_t startTimeMs, int64_t
     }
 
     // 从原文件的流信息，创建新的输出流
-    // 这里用一个map来记录 输入流id 和 输出流id 的对应关系
-    std::map<int, StreamMapItem> streamIdxMap;
+    // 这里用一个数组来记录 输入流id 和 输出流id 的对应关系，-1表示不输出
+    std::vector<int> streamIdxMap(inFmtCtx->nb_streams, -1);
     for(int i = 0; i < inFmtCtx->nb_streams; ++i) {
         if(inFmtCtx->streams[i]->codecpar->codec_id == AV_CODEC_ID_NONE) {
             continue;
@@ -82,11 +69,7 @@ void remuxingTrim(std::string src, std::string dst, int64_t startTimeMs, int64_t
         AVStream * strm = avformat_new_stream(outFmtCtx, NULL);
         strm->id = outFmtCtx->nb_streams - 1;
         strm->index = outFmtCtx->nb_streams - 1;
-
-        StreamMapItem mapItem;
-        mapItem.srcStreamId = i;
-        mapItem.dstStreamId = strm->index;
-        streamIdxMap[i] = mapItem;
+        streamIdxMap[i] = strm->index;
         avcodec_parameters_copy(strm->codecpar, inFmtCtx->streams[i]->codecpar);
         strm->time_base = inFmtCtx->streams[i]->time_base;
         av_log(NULL, AV_LOG_INFO, "src timebase : %d / %d\n", strm->time_base.num, strm->time_base.den);
@@ -107,48 +90,56 @@ void remuxingTrim(std::string src, std::string dst, int64_t startTimeMs, int64_t
         av_log(NULL, AV_LOG_INFO, "new timebase : %d / %d\n", strm->time_base.num, strm->time_base.den);
     }
 
+    // 写完header后时间基已经确定，为每路输入流建立改写描述，预先算好时间基的转换
+    std::vector<StreamDescriptor> streamTable = buildStreamDescriptors(inFmtCtx, outFmtCtx, streamIdxMap);
+    // 每路流的裁剪结束时间，输入流的时间基
+    std::vector<int64_t> endTs(inFmtCtx->nb_streams, INT64_MAX);
+    for(int i = 0; endTimeMs > 0 && i < inFmtCtx->nb_streams; ++i) {
+        endTs[i] = av_rescale_q(endTimeMs, {1, 1000}, inFmtCtx->streams[i]->time_base);
+    }
+    std::vector<bool> isFirstPkt(inFmtCtx->nb_streams, true);
+
     // 逐帧写入
     while(av_read_frame(inFmtCtx, inPacket) >= 0) {
-        if(streamIdxMap.find(inPacket->stream_index) == streamIdxMap.end()) {
+        int streamId = inPacket->stream_index;
+        if(streamId >= (int)streamTable.size() || streamTable[streamId].dstStreamId < 0) {
             av_packet_unref(inPacket);
             continue;
         }
 
         // 记录每一路流的第一帧时间，用于裁剪
-        if(streamIdxMap[inPacket->stream_index].isFirstPkt) {
-            streamIdxMap[inPacket->stream_index].firstPacketTime.dts = inPacket->dts;
-            streamIdxMap[inPacket->stream_index].firstPacketTime.pts = inPacket->pts;
-            streamIdxMap[inPacket->stream_index].isFirstPkt = false;
+        //   根据裁剪的第一帧重新计算dts和pts，转换成改写描述中的偏移
+        //   --- 注意这里，由于dts < pts，dts 要保留首帧的dts和首帧的pts的偏移量
+        //   首帧没有pts时用dts作为0点，都没有时丢弃，直到第一个带时间戳的帧
+        if(isFirstPkt[streamId]) {
+            int64_t firstPts = inPacket->pts != AV_NOPTS_VALUE ? inPacket->pts : inPacket->dts;
+            if(firstPts == AV_NOPTS_VALUE) {
+                av_packet_unref(inPacket);
+                continue;
+            }
+            int64_t firstDts = inPacket->dts != AV_NOPTS_VALUE ? inPacket->dts : firstPts;
+            streamTable[streamId].ptsOffset = -firstPts;
+            streamTable[streamId].dtsOffset = firstDts - 2 * firstPts;
+            isFirstPkt[streamId] = false;
         }
 
-        // av_log(NULL, AV_LOG_INFO, "read a packet\n");
-        auto &oldStream = inFmtCtx->streams[inPacket->stream_index];
-        auto &newStream = outFmtCtx->streams[streamIdxMap[inPacket->stream_index].dstStreamId];
-
         // 裁剪逻辑 -----------------------------------------------------
         //   裁剪结束判断，兼容B帧的处理，直接用dts判断
-        if(endTimeMs > 0 && inPacket->dts > av_rescale_q(endTimeMs, {1, 1000}, oldStream->time_base)) {
+        if(inPacket->dts != AV_NOPTS_VALUE && inPacket->dts > endTs[streamId]) {
             break;
         }
+        //   dts由pts加上首帧的偏移得到
+        inPacket->dts = inPacket->pts;
         //   兼容B帧视频，pts大于结束时间的视频，写入文件，但是pts置为AV_NOPTS_VALUE，不播放
         //   一般只有最后一个gop有一两帧，不这么处理，某些视频可能会花屏
-        if(endTimeMs > 0 && inPacket->pts > av_rescale_q(endTimeMs, {1, 1000}, oldStream->time_base)) {
+        if(inPacket->pts != AV_NOPTS_VALUE && inPacket->pts > endTs[streamId]) {
             inPacket->pts = AV_NOPTS_VALUE;
         }
-
-        // 重新修改时间戳，由于去掉了前面一段，所以需要根据裁剪的第一帧重新计算dts和pts
-        //   --- 注意这里，由于dts < pts，dts 要保留首帧的dts和首帧的pts的偏移量
-        inPacket->dts = inPacket->pts - streamIdxMap[inPacket->stream_index].firstPacketTime.pts 
-                        + streamIdxMap[inPacket->stream_index].firstPacketTime.dts - streamIdxMap[inPacket->stream_index].firstPacketTime.pts; 
-        inPacket->pts = inPacket->pts - streamIdxMap[inPacket->stream_index].firstPacketTime.pts;
         // ------------------------------------------------------------
 
         // 注意，这里上面提到了，在avformat_write_header()之后，流所使用的
         // time_base可能会发生改变，所以，对于帧要写入的dts，pts，都需要进行一个转换
-        inPacket->dts = av_rescale_q(inPacket->dts, oldStream->time_base, newStream->time_base);
-        inPacket->pts = av_rescale_q(inPacket->pts, oldStream->time_base, newStream->time_base);
-        inPacket->stream_index = streamIdxMap[inPacket->stream_index].dstStreamId;
-        inPacket->time_base = newStream->time_base;
+        rewritePacket(streamTable, inPacket);
 
         // 交叉写入音频和视频帧
         if(av_interleaved_write_frame(outFmtCtx, inPacket) < 0) {
@@ -1,4 +1,61 @@
 #pragma once
 #include <string>
+#include <vector>
 
-void remuxingTrim(std::string src, std::string dst, int64_t startTimeMs = -1, int64_t endTimeMs = -1);
\ No newline at end of file
+extern "C" {
+#include <libavutil/avutil.h>
+}
+
+void remuxingTrim(std::string src, std::string dst, int64_t startTimeMs = -1, int64_t endTimeMs = -1);
+
+// 帧精确的裁剪，参数同remuxingTrim
+// 只有起止位置所在的GOP会解码并按源视频的参数重新编码，中间完整的GOP直接拷贝
+void remuxingTrimAccurate(std::string src, std::string dst, int64_t startTimeMs = -1, int64_t endTimeMs = -1);
+
+// 一个裁剪片段，时间单位(ms)，含义同remuxingTrim
+struct TrimClip {
+    std::string dst;
+    int64_t startTimeMs = -1;
+    int64_t endTimeMs = -1;
+};
+
+// 只读取一遍输入，同时裁剪出多个片段，片段之间可以重叠
+// 读取位置经过片段的起止时间时，打开/关闭对应的输出
+void remuxingTrimMulti(std::string src, const std::vector<TrimClip> &clips);
+
+struct ParallelTrimStats {
+    int clipNum = 0;
+    int threadNum = 0;
+    int indexEntries = 0;           // 索引中关键帧的数量
+    int64_t indexBytesRead = 0;     // 建立索引读取的字节数
+    int64_t clipBytesRead = 0;      // 所有worker读取的字节数
+    double indexSec = 0;
+    double wallSec = 0;             // 包含建立索引的总耗时
+};
+
+// 视频关键帧索引中的一项
+struct KeyframeEntry {
+    int64_t timestamp = 0;  // 视频流的timebase，来自容器索引时是索引的时间(mp4中为dts)
+    int64_t pos = -1;       // 在文件中的字节偏移，未知时为-1
+};
+
+struct KeyframeIndex {
+    int videoStreamId = -1;
+    AVRational timeBase = {1, 1};
+    bool byteSeekable = false;          // 容器是否支持按字节seek
+    std::vector<KeyframeEntry> entries; // 按timestamp升序
+};
+
+// 建立视频关键帧的索引
+//   优先使用容器自带的索引(mp4/mkv打开时就有)，没有时扫描一遍packet
+//   ts等没有索引的文件扫描代价和读一遍文件相同，同一个输入多次裁剪时应保留索引复用
+// @param bytesRead 不为空时返回建立索引读取的字节数
+bool buildKeyframeIndex(const std::string &src, KeyframeIndex &index, int64_t *bytesRead = nullptr);
+
+// 并行裁剪多个片段，每个片段一个worker，各自打开输入
+// worker按视频关键帧索引直接定位到片段起点前的关键帧，不读多余的数据
+// @param threadNum 线程数，<=0时使用CPU核数
+// @param index 同一个输入预先建立的索引，为空时先调用buildKeyframeIndex()
+// @return 所有片段都成功时返回true
+bool remuxingTrimParallel(std::string src, const std::vector<TrimClip> &clips, int threadNum = 0, ParallelTrimStats *stats = nullptr,
+                          const KeyframeIndex *index = nullptr);
@@ -0,0 +1,588 @@
+#include "RemuxingTrim.h"
+#include <algorithm>
+#include <map>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+// 帧精确裁剪(smart render)
+//   完整落在裁剪区间内的GOP直接拷贝，只有起始和结束边界所在的GOP解码后重新编码，
+//   这样裁剪点可以精确到帧，速度又接近转封装。
+//   这里假设源视频是closed GOP，即GOP内的帧不会参考前一个GOP。
+
+// 一个GOP的所有packet，解码顺序，从关键帧开始
+struct GopBuffer {
+    std::vector<AVPacket *> packets;
+    int64_t minPts = INT64_MAX;
+    int64_t maxPts = INT64_MIN;
+
+    void push(AVPacket *pkt) {
+        AVPacket *clone = av_packet_clone(pkt);
+        if(clone == nullptr) {
+            return;
+        }
+        packets.push_back(clone);
+        if(pkt->pts != AV_NOPTS_VALUE) {
+            minPts = std::min(minPts, pkt->pts);
+            maxPts = std::max(maxPts, pkt->pts);
+        }
+    }
+
+    void clear() {
+        for(auto &pkt : packets) {
+            av_packet_free(&pkt);
+        }
+        packets.clear();
+        minPts = INT64_MAX;
+        maxPts = INT64_MIN;
+    }
+
+    bool empty() const {
+        return packets.empty();
+    }
+};
+
+struct AccurateTrimContext {
+    AVFormatContext *inFmtCtx = nullptr;
+    AVFormatContext *outFmtCtx = nullptr;
+    int videoStreamId = -1;             // 输入的视频流
+    int videoOutStreamId = -1;          // 输出的视频流
+    int64_t startPts = 0;               // 视频流timebase下的裁剪区间
+    int64_t endPts = INT64_MAX;
+    int64_t dtsShift = 0;               // 源视频dts相对pts的偏移，重编码的帧沿用，保证dts递增
+    bool dtsShiftKnown = false;
+
+    AVCodecContext *decCtx = nullptr;
+    AVFrame *frame = nullptr;
+    AVPacket *encPacket = nullptr;
+
+    // H.264在mp4等容器中是长度前缀的格式(avcC)，重编码出来的是Annex B，需要转换。
+    // 重编码片段会带上自己的SPS/PPS，之后拷贝的GOP要重新带上源码流的SPS/PPS
+    bool lengthPrefixed = false;
+    int nalLengthSize = 4;
+    std::vector<uint8_t> srcParamSets;
+    bool needSrcParamSets = false;
+
+    int copiedGops = 0;
+    int encodedGops = 0;
+    int encodedFrames = 0;
+};
+
+// 从avcC格式的extradata中取出SPS/PPS，转换成长度前缀的NAL
+static bool parseAvccParamSets(const uint8_t *data, int size, int &nalLengthSize, std::vector<uint8_t> &out) {
+    if(data == nullptr || size < 7 || data[0] != 1) {
+        return false;
+    }
+    nalLengthSize = (data[4] & 0x03) + 1;
+
+    int pos = 5;
+    // 先是SPS，再是PPS
+    for(int type = 0; type < 2; ++type) {
+        if(pos >= size) {
+            return false;
+        }
+        int count = type == 0 ? (data[pos] & 0x1f) : data[pos];
+        ++pos;
+        for(int i = 0; i < count; ++i) {
+            if(pos + 2 > size) {
+                return false;
+            }
+            int len = (data[pos] << 8) | data[pos + 1];
+            pos += 2;
+            if(pos + len > size) {
+                return false;
+            }
+            for(int b = nalLengthSize - 1; b >= 0; --b) {
+                out.push_back((len >> (8 * b)) & 0xff);
+            }
+            out.insert(out.end(), data + pos, data + pos + len);
+            pos += len;
+        }
+    }
+    return true;
+}
+
+// extradata不是以起始码开头，说明码流是长度前缀的格式(mp4/mkv中的avcC/hvcC)
+static bool hasLengthPrefixedExtradata(const AVCodecParameters *par) {
+    const uint8_t *data = par->extradata;
+    int size = par->extradata_size;
+    if(data == nullptr || size < 3) {
+        return false;
+    }
+    bool startCode3 = data[0] == 0 && data[1] == 0 && data[2] == 1;
+    bool startCode4 = size >= 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1;
+    return !startCode3 && !startCode4;
+}
+
+// Annex B(起始码分隔)转换成长度前缀
+static void annexbToLengthPrefixed(const uint8_t *data, int size, int nalLengthSize, std::vector<uint8_t> &out) {
+    // 从from开始找下一个起始码，返回起始码的位置，codeLen是起始码的长度
+    auto findStartCode = [&](int from, int &codeLen) -> int {
+        for(int p = from; p + 3 <= size; ++p) {
+            if(data[p] == 0 && data[p + 1] == 0) {
+                if(data[p + 2] == 1) {
+                    codeLen = 3;
+                    return p;
+                }
+                if(p + 4 <= size && data[p + 2] == 0 && data[p + 3] == 1) {
+                    codeLen = 4;
+                    return p;
+                }
+            }
+        }
+        codeLen = 0;
+        return size;
+    };
+
+    int codeLen = 0;
+    int i = findStartCode(0, codeLen);
+    while(i < size) {
+        int nalBegin = i + codeLen;
+        int nextCodeLen = 0;
+        int nalEnd = findStartCode(nalBegin, nextCodeLen);
+        int len = nalEnd - nalBegin;
+        if(len > 0) {
+            for(int b = nalLengthSize - 1; b >= 0; --b) {
+                out.push_back((len >> (8 * b)) & 0xff);
+            }
+            out.insert(out.end(), data + nalBegin, data + nalEnd);
+        }
+        i = nalEnd;
+        codeLen = nextCodeLen;
+    }
+}
+
+// 视频packet统一的时间戳处理：以裁剪起点为0，转换到输出流的timebase
+static bool writeVideoPacket(AccurateTrimContext &ctx, AVPacket *pkt) {
+    auto &oldStream = ctx.inFmtCtx->streams[ctx.videoStreamId];
+    auto &newStream = ctx.outFmtCtx->streams[ctx.videoOutStreamId];
+
+    pkt->pts = av_rescale_q(pkt->pts - ctx.startPts, oldStream->time_base, newStream->time_base);
+    pkt->dts = av_rescale_q(pkt->dts - ctx.startPts, oldStream->time_base, newStream->time_base);
+    pkt->duration = av_rescale_q(pkt->duration, oldStream->time_base, newStream->time_base);
+    pkt->stream_index = ctx.videoOutStreamId;
+    pkt->time_base = newStream->time_base;
+    pkt->pos = -1;
+
+    if(av_interleaved_write_frame(ctx.outFmtCtx, pkt) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Error during write video packet\n");
+        return false;
+    }
+    return true;
+}
+
+// 整个GOP都在裁剪区间内，直接拷贝
+static bool copyGop(AccurateTrimContext &ctx, GopBuffer &gop) {
+    for(size_t i = 0; i < gop.packets.size(); ++i) {
+        AVPacket *pkt = gop.packets[i];
+
+        // 前面是重编码的片段，关键帧前面补上源码流的SPS/PPS
+        if(i == 0 && ctx.needSrcParamSets && !ctx.srcParamSets.empty()) {
+            AVPacket *withParamSets = av_packet_alloc();
+            int psSize = (int)ctx.srcParamSets.size();
+            if(withParamSets == nullptr || av_new_packet(withParamSets, psSize + pkt->size) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Allocate packet failed\n");
+                av_packet_free(&withParamSets);
+                return false;
+            }
+            av_packet_copy_props(withParamSets, pkt);
+            memcpy(withParamSets->data, ctx.srcParamSets.data(), psSize);
+            memcpy(withParamSets->data + psSize, pkt->data, pkt->size);
+            av_packet_free(&gop.packets[i]);
+            gop.packets[i] = pkt = withParamSets;
+        }
+
+        if(!writeVideoPacket(ctx, pkt)) {
+            return false;
+        }
+    }
+
+    ctx.needSrcParamSets = false;
+    ++ctx.copiedGops;
+    return true;
+}
+
+// 按源视频的参数打开编码器，每个重编码的片段都是独立的一次编码，从IDR开始
+static AVCodecContext *openMatchingEncoder(AccurateTrimContext &ctx, const AVFrame *frame) {
+    auto &stream = ctx.inFmtCtx->streams[ctx.videoStreamId];
+    const AVCodec *codec = avcodec_find_encoder(stream->codecpar->codec_id);
+    if(codec == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find encoder for %s\n", avcodec_get_name(stream->codecpar->codec_id));
+        return nullptr;
+    }
+
+    AVCodecContext *encCtx = avcodec_alloc_context3(codec);
+    if(encCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate encoder context\n");
+        return nullptr;
+    }
+
+    encCtx->width = frame->width;
+    encCtx->height = frame->height;
+    encCtx->pix_fmt = (AVPixelFormat)frame->format;
+    encCtx->sample_aspect_ratio = ctx.decCtx->sample_aspect_ratio;
+    encCtx->color_range = ctx.decCtx->color_range;
+    encCtx->color_primaries = ctx.decCtx->color_primaries;
+    encCtx->color_trc = ctx.decCtx->color_trc;
+    encCtx->colorspace = ctx.decCtx->colorspace;
+    encCtx->time_base = stream->time_base;
+    encCtx->framerate = stream->avg_frame_rate;
+    encCtx->profile = stream->codecpar->profile;
+    encCtx->level = stream->codecpar->level;
+    // 码率跟随源视频，拿不到时给一个较高的码率，避免边界处画质突变
+    encCtx->bit_rate = stream->codecpar->bit_rate > 0 ? stream->codecpar->bit_rate : 4000000;
+    // 不使用B帧，dts直接由pts推出，和前后拷贝的GOP衔接
+    encCtx->max_b_frames = 0;
+    encCtx->gop_size = 600;
+    // 故意不设置AV_CODEC_FLAG_GLOBAL_HEADER，让SPS/PPS随关键帧输出，
+    // 输出流的extradata仍然是源视频的
+
+    if(avcodec_open2(encCtx, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open encoder failed\n");
+        avcodec_free_context(&encCtx);
+        return nullptr;
+    }
+    return encCtx;
+}
+
+// 取出编码器的输出，写入文件
+static bool drainEncoder(AccurateTrimContext &ctx, AVCodecContext *encCtx) {
+    while(true) {
+        int err = avcodec_receive_packet(encCtx, ctx.encPacket);
+        if(err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
+            return true;
+        } else if(err < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error when encode receive packet\n");
+            return false;
+        }
+
+        AVPacket *pkt = ctx.encPacket;
+        if(ctx.lengthPrefixed) {
+            std::vector<uint8_t> converted;
+            annexbToLengthPrefixed(pkt->data, pkt->size, ctx.nalLengthSize, converted);
+            AVPacket *convertedPkt = av_packet_alloc();
+            if(convertedPkt == nullptr || av_new_packet(convertedPkt, (int)converted.size()) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Allocate packet failed\n");
+                av_packet_free(&convertedPkt);
+                return false;
+            }
+            av_packet_copy_props(convertedPkt, pkt);
+            memcpy(convertedPkt->data, converted.data(), converted.size());
+            av_packet_unref(pkt);
+            av_packet_move_ref(pkt, convertedPkt);
+            av_packet_free(&convertedPkt);
+        }
+
+        pkt->dts = pkt->pts + ctx.dtsShift;
+        bool ok = writeVideoPacket(ctx, pkt);
+        av_packet_unref(pkt);
+        if(!ok) {
+            return false;
+        }
+    }
+}
+
+// 把区间内的帧送进编码器，编码器在第一帧时才打开，这样能拿到解码后的实际格式
+static bool encodeFrame(AccurateTrimContext &ctx, AVCodecContext *&encCtx, AVFrame *frame) {
+    int64_t pts = frame->pts != AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+    if(pts == AV_NOPTS_VALUE || pts < ctx.startPts || pts > ctx.endPts) {
+        return true;
+    }
+
+    if(encCtx == nullptr) {
+        encCtx = openMatchingEncoder(ctx, frame);
+        if(encCtx == nullptr) {
+            return false;
+        }
+    }
+
+    frame->pts = pts;
+    frame->pict_type = AV_PICTURE_TYPE_NONE;
+    if(avcodec_send_frame(encCtx, frame) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Error when encode send frame\n");
+        return false;
+    }
+    ++ctx.encodedFrames;
+    return drainEncoder(ctx, encCtx);
+}
+
+// 边界上的GOP，解码后只重新编码区间内的帧
+static bool encodeGop(AccurateTrimContext &ctx, GopBuffer &gop) {
+    AVCodecContext *encCtx = nullptr;
+    bool ok = true;
+
+    for(size_t i = 0; ok && i <= gop.packets.size(); ++i) {
+        // 最后送NULL，取出解码器中缓存的帧
+        int err = avcodec_send_packet(ctx.decCtx, i < gop.packets.size() ? gop.packets[i] : NULL);
+        if(err < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error when decode send packet.\n");
+            ok = false;
+            break;
+        }
+
+        while(ok) {
+            err = avcodec_receive_frame(ctx.decCtx, ctx.frame);
+            if(err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
+                break;
+            } else if(err < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Error when decode receive frame\n");
+                ok = false;
+                break;
+            }
+            ok = encodeFrame(ctx, encCtx, ctx.frame);
+            av_frame_unref(ctx.frame);
+        }
+    }
+    // 解码器送过NULL之后，需要flush才能继续使用
+    avcodec_flush_buffers(ctx.decCtx);
+
+    if(encCtx) {
+        if(ok && avcodec_send_frame(encCtx, NULL) >= 0) {
+            ok = drainEncoder(ctx, encCtx);
+        }
+        avcodec_free_context(&encCtx);
+        ctx.needSrcParamSets = ctx.lengthPrefixed;
+    }
+
+    ++ctx.encodedGops;
+    return ok;
+}
+
+// 一个GOP收集完整后，决定拷贝还是重编码
+static bool flushGop(AccurateTrimContext &ctx, GopBuffer &gop) {
+    bool ok = true;
+    if(gop.maxPts < ctx.startPts) {
+        // 整个GOP都在裁剪起点之前，丢弃
+    } else if(gop.minPts >= ctx.startPts && gop.maxPts <= ctx.endPts) {
+        ok = copyGop(ctx, gop);
+    } else {
+        ok = encodeGop(ctx, gop);
+    }
+    gop.clear();
+    return ok;
+}
+
+static AVCodecContext *openVideoDecoder(AVStream *stream) {
+    const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if(codec == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Find decoder failed\n");
+        return nullptr;
+    }
+
+    AVCodecContext *decCtx = avcodec_alloc_context3(codec);
+    if(decCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot alloc decoder context\n");
+        return nullptr;
+    }
+
+    if(avcodec_parameters_to_context(decCtx, stream->codecpar) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Fill decoder context failed\n");
+        avcodec_free_context(&decCtx);
+        return nullptr;
+    }
+    decCtx->pkt_timebase = stream->time_base;
+
+    if(avcodec_open2(decCtx, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open decoder failed\n");
+        avcodec_free_context(&decCtx);
+        return nullptr;
+    }
+    return decCtx;
+}
+
+void remuxingTrimAccurate(std::string src, std::string dst, int64_t startTimeMs, int64_t endTimeMs) {
+    AccurateTrimContext ctx;
+
+    // 初始化解封装相关的组件
+    if(avformat_open_input(&ctx.inFmtCtx, src.c_str(), NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open src file failed.\n");
+        return;
+    }
+
+    if(avformat_find_stream_info(ctx.inFmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info failed\n");
+        avformat_close_input(&ctx.inFmtCtx);
+        return;
+    }
+
+    ctx.videoStreamId = av_find_best_stream(ctx.inFmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if(ctx.videoStreamId < 0) {
+        // 没有视频流时，音频的packet本身就是帧精确的，直接用普通的裁剪
+        avformat_close_input(&ctx.inFmtCtx);
+        remuxingTrim(src, dst, startTimeMs, endTimeMs);
+        return;
+    }
+
+    // 编码器输出的是Annex B，只实现了avcC的转换；其他长度前缀的码流(如hvcC的HEVC)混进拷贝的GOP之间会损坏文件，
+    // 这时退回到从关键帧开始的普通裁剪
+    auto videoPar = ctx.inFmtCtx->streams[ctx.videoStreamId]->codecpar;
+    if(hasLengthPrefixedExtradata(videoPar)) {
+        if(videoPar->codec_id == AV_CODEC_ID_H264) {
+            ctx.lengthPrefixed = parseAvccParamSets(videoPar->extradata, videoPar->extradata_size, ctx.nalLengthSize, ctx.srcParamSets);
+        }
+        if(!ctx.lengthPrefixed) {
+            av_log(NULL, AV_LOG_WARNING, "Smart render does not support length-prefixed %s, fall back to keyframe trim\n",
+                   avcodec_get_name(videoPar->codec_id));
+            avformat_close_input(&ctx.inFmtCtx);
+            remuxingTrim(src, dst, startTimeMs, endTimeMs);
+            return;
+        }
+    }
+
+    // 裁剪区间，统一换算到微秒再转到各个流的timebase
+    int64_t startUs = startTimeMs > 0 ? av_rescale_q(startTimeMs, {1, 1000}, AV_TIME_BASE_Q) : 0;
+    int64_t endUs = endTimeMs > 0 ? av_rescale_q(endTimeMs, {1, 1000}, AV_TIME_BASE_Q) : INT64_MAX;
+    auto &videoStream = ctx.inFmtCtx->streams[ctx.videoStreamId];
+    ctx.startPts = av_rescale_q(startUs, AV_TIME_BASE_Q, videoStream->time_base);
+    ctx.endPts = endTimeMs > 0 ? av_rescale_q(endUs, AV_TIME_BASE_Q, videoStream->time_base) : INT64_MAX;
+
+    // seek到起始时间之前的关键帧，从那里开始解码
+    if(startTimeMs > 0) {
+        if(av_seek_frame(ctx.inFmtCtx, -1, startUs, AVSEEK_FLAG_BACKWARD) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Seek to startTime : %lld failed\n", (long long)startTimeMs);
+        }
+    }
+
+    ctx.decCtx = openVideoDecoder(videoStream);
+    ctx.frame = av_frame_alloc();
+    ctx.encPacket = av_packet_alloc();
+    AVPacket *inPacket = av_packet_alloc();
+    if(ctx.decCtx == nullptr || ctx.frame == nullptr || ctx.encPacket == nullptr || inPacket == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Prepare decoder failed.\n");
+        avcodec_free_context(&ctx.decCtx);
+        av_frame_free(&ctx.frame);
+        av_packet_free(&ctx.encPacket);
+        av_packet_free(&inPacket);
+        avformat_close_input(&ctx.inFmtCtx);
+        return;
+    }
+
+    if(avformat_alloc_output_context2(&ctx.outFmtCtx, NULL, NULL, dst.c_str()) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate output context failed.\n");
+        avcodec_free_context(&ctx.decCtx);
+        av_frame_free(&ctx.frame);
+        av_packet_free(&ctx.encPacket);
+        av_packet_free(&inPacket);
+        avformat_close_input(&ctx.inFmtCtx);
+        return;
+    }
+
+    if(!(ctx.outFmtCtx->oformat->flags & AVFMT_NOFILE)) {
+        if(avio_open(&ctx.outFmtCtx->pb, dst.c_str(), AVIO_FLAG_WRITE) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "IO Open failed.\n");
+        }
+    }
+
+    // 输出流的参数全部拷贝自源文件，重编码的部分按同样的参数编码
+    std::map<int, int> streamIdxMap;
+    for(int i = 0; i < ctx.inFmtCtx->nb_streams; ++i) {
+        if(ctx.inFmtCtx->streams[i]->codecpar->codec_id == AV_CODEC_ID_NONE) {
+            continue;
+        }
+        AVStream *strm = avformat_new_stream(ctx.outFmtCtx, NULL);
+        strm->id = ctx.outFmtCtx->nb_streams - 1;
+        strm->index = ctx.outFmtCtx->nb_streams - 1;
+        streamIdxMap[i] = strm->index;
+        avcodec_parameters_copy(strm->codecpar, ctx.inFmtCtx->streams[i]->codecpar);
+        strm->time_base = ctx.inFmtCtx->streams[i]->time_base;
+    }
+    ctx.videoOutStreamId = streamIdxMap[ctx.videoStreamId];
+
+    if(avformat_write_header(ctx.outFmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Write header failed.\n");
+        avcodec_free_context(&ctx.decCtx);
+        av_frame_free(&ctx.frame);
+        av_packet_free(&ctx.encPacket);
+        av_packet_free(&inPacket);
+        avformat_close_input(&ctx.inFmtCtx);
+        avio_closep(&ctx.outFmtCtx->pb);
+        avformat_free_context(ctx.outFmtCtx);
+        return;
+    }
+
+    GopBuffer gop;
+    bool ok = true;
+    std::map<int, bool> streamDone;
+    while(ok && av_read_frame(ctx.inFmtCtx, inPacket) >= 0) {
+        int inStreamId = inPacket->stream_index;
+        if(streamIdxMap.find(inStreamId) == streamIdxMap.end() || streamDone[inStreamId]) {
+            av_packet_unref(inPacket);
+            continue;
+        }
+
+        if(inStreamId == ctx.videoStreamId) {
+            bool isKey = inPacket->flags & AV_PKT_FLAG_KEY;
+            if(!ctx.dtsShiftKnown && isKey && inPacket->dts != AV_NOPTS_VALUE && inPacket->pts != AV_NOPTS_VALUE) {
+                ctx.dtsShift = inPacket->dts - inPacket->pts;
+                ctx.dtsShiftKnown = true;
+            }
+
+            // 遇到下一个关键帧，上一个GOP完整了
+            if(isKey && !gop.empty()) {
+                ok = flushGop(ctx, gop);
+                if(inPacket->pts != AV_NOPTS_VALUE && inPacket->pts > ctx.endPts) {
+                    streamDone[inStreamId] = true;
+                }
+            }
+            // seek之后第一个关键帧之前的packet无法解码，丢弃
+            if(!streamDone[inStreamId] && (isKey || !gop.empty())) {
+                gop.push(inPacket);
+            }
+        } else {
+            // 其他流的packet都可以独立解码，按pts直接过滤
+            auto &oldStream = ctx.inFmtCtx->streams[inStreamId];
+            auto &newStream = ctx.outFmtCtx->streams[streamIdxMap[inStreamId]];
+            int64_t startTs = av_rescale_q(startUs, AV_TIME_BASE_Q, oldStream->time_base);
+            int64_t endTs = endTimeMs > 0 ? av_rescale_q(endUs, AV_TIME_BASE_Q, oldStream->time_base) : INT64_MAX;
+
+            if(inPacket->pts != AV_NOPTS_VALUE && inPacket->pts > endTs) {
+                streamDone[inStreamId] = true;
+            } else if(inPacket->pts != AV_NOPTS_VALUE && inPacket->pts >= startTs) {
+                inPacket->pts = av_rescale_q(inPacket->pts - startTs, oldStream->time_base, newStream->time_base);
+                inPacket->dts = av_rescale_q(inPacket->dts - startTs, oldStream->time_base, newStream->time_base);
+                inPacket->duration = av_rescale_q(inPacket->duration, oldStream->time_base, newStream->time_base);
+                inPacket->stream_index = streamIdxMap[inStreamId];
+                inPacket->time_base = newStream->time_base;
+                inPacket->pos = -1;
+                if(av_interleaved_write_frame(ctx.outFmtCtx, inPacket) < 0) {
+                    av_log(NULL, AV_LOG_ERROR, "Error during write packet\n");
+                }
+            }
+        }
+        av_packet_unref(inPacket);
+
+        // 所有流都过了结束时间
+        int doneNum = 0;
+        for(auto &p : streamDone) {
+            doneNum += p.second ? 1 : 0;
+        }
+        if(doneNum == (int)streamIdxMap.size()) {
+            break;
+        }
+    }
+
+    // 文件读完时最后一个GOP还没处理
+    if(ok && !gop.empty()) {
+        ok = flushGop(ctx, gop);
+    }
+    gop.clear();
+
+    av_log(NULL, AV_LOG_INFO, "accurate trim : %d gops copied, %d gops re-encoded, %d frames encoded\n",
+           ctx.copiedGops, ctx.encodedGops, ctx.encodedFrames);
+
+    if(av_write_trailer(ctx.outFmtCtx) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Write trailer failed\n");
+    }
+
+    // 释放相关资源
+    avio_closep(&ctx.outFmtCtx->pb);
+    avformat_free_context(ctx.outFmtCtx);
+    avcodec_free_context(&ctx.decCtx);
+    av_frame_free(&ctx.frame);
+    av_packet_free(&ctx.encPacket);
+    av_packet_free(&inPacket);
+    avformat_close_input(&ctx.inFmtCtx);
+}
@@ -0,0 +1,246 @@
+#include "ClipOutput.h"
+#include <algorithm>
+#include <vector>
+
+bool openClipOutput(AVFormatContext *inFmtCtx, ClipOutput &out) {
+    const std::string &dst = out.clip.dst;
+    if(avformat_alloc_output_context2(&out.outFmtCtx, NULL, NULL, dst.c_str()) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate output context for %s failed.\n", dst.c_str());
+        return false;
+    }
+
+    if(!(out.outFmtCtx->oformat->flags & AVFMT_NOFILE)) {
+        if(avio_open(&out.outFmtCtx->pb, dst.c_str(), AVIO_FLAG_WRITE) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "IO Open %s failed.\n", dst.c_str());
+            avformat_free_context(out.outFmtCtx);
+            out.outFmtCtx = nullptr;
+            return false;
+        }
+    }
+
+    for(int i = 0; i < inFmtCtx->nb_streams; ++i) {
+        if(inFmtCtx->streams[i]->codecpar->codec_id == AV_CODEC_ID_NONE) {
+            continue;
+        }
+        AVStream *strm = avformat_new_stream(out.outFmtCtx, NULL);
+        strm->id = out.outFmtCtx->nb_streams - 1;
+        strm->index = out.outFmtCtx->nb_streams - 1;
+
+        StreamMapItem mapItem;
+        mapItem.srcStreamId = i;
+        mapItem.dstStreamId = strm->index;
+        out.streamIdxMap[i] = mapItem;
+        avcodec_parameters_copy(strm->codecpar, inFmtCtx->streams[i]->codecpar);
+        strm->time_base = inFmtCtx->streams[i]->time_base;
+    }
+
+    if(avformat_write_header(out.outFmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Write header for %s failed.\n", dst.c_str());
+        avio_closep(&out.outFmtCtx->pb);
+        avformat_free_context(out.outFmtCtx);
+        out.outFmtCtx = nullptr;
+        return false;
+    }
+
+    out.opened = true;
+    return true;
+}
+
+bool closeClipOutput(ClipOutput &out) {
+    if(out.outFmtCtx) {
+        if(av_write_trailer(out.outFmtCtx) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Write trailer for %s failed\n", out.clip.dst.c_str());
+            out.failed = true;
+        }
+        avio_closep(&out.outFmtCtx->pb);
+        avformat_free_context(out.outFmtCtx);
+        out.outFmtCtx = nullptr;
+    }
+    out.closed = true;
+    av_log(NULL, AV_LOG_INFO, "clip %s : %d packets\n", out.clip.dst.c_str(), out.packetNum);
+    return !out.failed;
+}
+
+bool writeClipPacket(AVFormatContext *inFmtCtx, ClipOutput &out, const AVPacket *inPacket, AVPacket *outPacket) {
+    auto it = out.streamIdxMap.find(inPacket->stream_index);
+    if(it == out.streamIdxMap.end()) {
+        return true;
+    }
+    StreamMapItem &mapItem = it->second;
+    auto &oldStream = inFmtCtx->streams[inPacket->stream_index];
+    auto &newStream = out.outFmtCtx->streams[mapItem.dstStreamId];
+
+    //   裁剪结束判断，兼容B帧的处理，直接用dts判断
+    int64_t endTs = out.clip.endTimeMs > 0 ? av_rescale_q(out.clip.endTimeMs, {1, 1000}, oldStream->time_base) : INT64_MAX;
+    if(inPacket->dts != AV_NOPTS_VALUE && inPacket->dts > endTs) {
+        return false;
+    }
+
+    // 多个片段共享同一个输入packet，这里只增加引用计数
+    if(av_packet_ref(outPacket, inPacket) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Reference packet failed\n");
+        out.failed = true;
+        return true;
+    }
+
+    // 记录每一路流的第一帧时间，用于裁剪
+    if(mapItem.isFirstPkt) {
+        mapItem.firstPacketTime.dts = inPacket->dts;
+        mapItem.firstPacketTime.pts = inPacket->pts;
+        mapItem.isFirstPkt = false;
+    }
+
+    // 以首帧的pts为0点，dts保留和pts之间的偏移
+    outPacket->dts = outPacket->dts - mapItem.firstPacketTime.pts;
+    //   兼容B帧视频，pts大于结束时间的视频，写入文件，但是pts置为AV_NOPTS_VALUE，不播放
+    if(outPacket->pts != AV_NOPTS_VALUE && outPacket->pts > endTs) {
+        outPacket->pts = AV_NOPTS_VALUE;
+    } else {
+        outPacket->pts = outPacket->pts - mapItem.firstPacketTime.pts;
+        outPacket->pts = av_rescale_q(outPacket->pts, oldStream->time_base, newStream->time_base);
+    }
+    outPacket->dts = av_rescale_q(outPacket->dts, oldStream->time_base, newStream->time_base);
+    outPacket->duration = av_rescale_q(outPacket->duration, oldStream->time_base, newStream->time_base);
+    outPacket->stream_index = mapItem.dstStreamId;
+    outPacket->time_base = newStream->time_base;
+
+    if(av_interleaved_write_frame(out.outFmtCtx, outPacket) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Error during write packet to %s\n", out.clip.dst.c_str());
+        out.failed = true;
+    }
+    av_packet_unref(outPacket);
+    ++out.packetNum;
+    return true;
+}
+
+static void clearPackets(std::vector<AVPacket *> &packets) {
+    for(auto &pkt : packets) {
+        av_packet_free(&pkt);
+    }
+    packets.clear();
+}
+
+void remuxingTrimMulti(std::string src, const std::vector<TrimClip> &clips) {
+    if(clips.empty()) {
+        return;
+    }
+
+    AVFormatContext *inFmtCtx = nullptr;
+    if(avformat_open_input(&inFmtCtx, src.c_str(), NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open src file failed.\n");
+        return;
+    }
+
+    if(avformat_find_stream_info(inFmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info failed\n");
+        avformat_close_input(&inFmtCtx);
+        return;
+    }
+
+    std::vector<ClipOutput> outputs(clips.size());
+    int64_t minStartTimeMs = INT64_MAX;
+    for(size_t i = 0; i < clips.size(); ++i) {
+        outputs[i].clip = clips[i];
+        minStartTimeMs = std::min(minStartTimeMs, clips[i].startTimeMs > 0 ? clips[i].startTimeMs : 0);
+    }
+
+    // 只seek一次，到最早的片段起点之前的关键帧
+    if(minStartTimeMs > 0) {
+        if(av_seek_frame(inFmtCtx, -1, av_rescale_q(minStartTimeMs, {1, 1000}, AV_TIME_BASE_Q), AVSEEK_FLAG_BACKWARD) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Seek to startTime : %lld failed\n", (long long)minStartTimeMs);
+        }
+    }
+
+    // 片段以视频流的时间判断起点，没有视频流时用任意流
+    int videoStreamId = av_find_best_stream(inFmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+
+    AVPacket *inPacket = av_packet_alloc();
+    AVPacket *outPacket = av_packet_alloc();
+    if(inPacket == nullptr || outPacket == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Allocate Packet failed.\n");
+        av_packet_free(&inPacket);
+        av_packet_free(&outPacket);
+        avformat_close_input(&inFmtCtx);
+        return;
+    }
+
+    // 缓存最近一个视频关键帧以来所有流的packet，片段打开时从关键帧开始补写，
+    // 和remuxingTrim()从起点前的关键帧开始的行为保持一致
+    std::vector<AVPacket *> gopPackets;
+    size_t closedNum = 0;
+    while(closedNum < outputs.size() && av_read_frame(inFmtCtx, inPacket) >= 0) {
+        int inStreamId = inPacket->stream_index;
+        auto &inStream = inFmtCtx->streams[inStreamId];
+        bool isStartStream = videoStreamId < 0 || inStreamId == videoStreamId;
+
+        bool hasPending = false;
+        for(auto &out : outputs) {
+            hasPending = hasPending || !out.opened;
+        }
+        if(hasPending) {
+            if(videoStreamId < 0 || (inStreamId == videoStreamId && (inPacket->flags & AV_PKT_FLAG_KEY))) {
+                clearPackets(gopPackets);
+            }
+            AVPacket *clone = av_packet_clone(inPacket);
+            if(clone) {
+                gopPackets.push_back(clone);
+            }
+        } else if(!gopPackets.empty()) {
+            clearPackets(gopPackets);
+        }
+
+        for(auto &out : outputs) {
+            if(out.closed) {
+                continue;
+            }
+
+            if(!out.opened) {
+                // 读取位置到达片段的起点，打开输出，补写缓存中的packet
+                int64_t startTs = out.clip.startTimeMs > 0 ? av_rescale_q(out.clip.startTimeMs, {1, 1000}, inStream->time_base) : INT64_MIN;
+                if(!isStartStream || inPacket->pts == AV_NOPTS_VALUE || inPacket->pts < startTs) {
+                    continue;
+                }
+                if(!openClipOutput(inFmtCtx, out)) {
+                    out.opened = true;
+                    out.closed = true;
+                    ++closedNum;
+                    continue;
+                }
+                bool ended = false;
+                for(auto &pkt : gopPackets) {
+                    if(!writeClipPacket(inFmtCtx, out, pkt, outPacket) || out.failed) {
+                        ended = true;
+                        break;
+                    }
+                }
+                if(ended) {
+                    closeClipOutput(out);
+                    ++closedNum;
+                }
+                continue;
+            }
+
+            // 其他已经打开的片段，写入当前的packet，写入出错的片段不再继续
+            if(!writeClipPacket(inFmtCtx, out, inPacket, outPacket) || out.failed) {
+                closeClipOutput(out);
+                ++closedNum;
+            }
+        }
+
+        av_packet_unref(inPacket);
+    }
+
+    // 文件结束，关闭还没结束的片段
+    for(auto &out : outputs) {
+        if(!out.opened) {
+            av_log(NULL, AV_LOG_ERROR, "clip %s starts after the end of input\n", out.clip.dst.c_str());
+        } else if(!out.closed) {
+            closeClipOutput(out);
+        }
+    }
+
+    clearPackets(gopPackets);
+    av_packet_free(&inPacket);
+    av_packet_free(&outPacket);
+    avformat_close_input(&inFmtCtx);
+}
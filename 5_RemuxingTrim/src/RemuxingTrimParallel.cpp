@@ -0,0 +1,208 @@
+#include "ClipOutput.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+bool buildKeyframeIndex(const std::string &src, KeyframeIndex &index, int64_t *bytesRead) {
+    AVFormatContext *inFmtCtx = nullptr;
+    if(avformat_open_input(&inFmtCtx, src.c_str(), NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open src file failed.\n");
+        return false;
+    }
+
+    if(avformat_find_stream_info(inFmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info failed\n");
+        avformat_close_input(&inFmtCtx);
+        return false;
+    }
+
+    index.videoStreamId = av_find_best_stream(inFmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    index.byteSeekable = !(inFmtCtx->iformat->flags & AVFMT_NO_BYTE_SEEK);
+    if(index.videoStreamId < 0) {
+        // 没有视频流，每个packet都可以作为起点，直接按时间seek
+        if(bytesRead) {
+            *bytesRead = inFmtCtx->pb ? inFmtCtx->pb->bytes_read : 0;
+        }
+        avformat_close_input(&inFmtCtx);
+        return true;
+    }
+
+    AVStream *videoStream = inFmtCtx->streams[index.videoStreamId];
+    index.timeBase = videoStream->time_base;
+
+    int entryNum = avformat_index_get_entries_count(videoStream);
+    for(int i = 0; i < entryNum; ++i) {
+        const AVIndexEntry *entry = avformat_index_get_entry(videoStream, i);
+        if(entry && (entry->flags & AVINDEX_KEYFRAME)) {
+            index.entries.push_back({entry->timestamp, entry->pos});
+        }
+    }
+
+    if(index.entries.empty()) {
+        // 容器没有索引，扫描一遍，其他流的packet丢弃
+        for(int i = 0; i < inFmtCtx->nb_streams; ++i) {
+            if(i != index.videoStreamId) {
+                inFmtCtx->streams[i]->discard = AVDISCARD_ALL;
+            }
+        }
+        AVPacket *packet = av_packet_alloc();
+        while(packet && av_read_frame(inFmtCtx, packet) >= 0) {
+            if(packet->stream_index == index.videoStreamId && (packet->flags & AV_PKT_FLAG_KEY) && packet->pts != AV_NOPTS_VALUE) {
+                index.entries.push_back({packet->pts, packet->pos});
+            }
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+    }
+
+    std::sort(index.entries.begin(), index.entries.end(), [](const KeyframeEntry &a, const KeyframeEntry &b) {
+        return a.timestamp < b.timestamp;
+    });
+
+    if(bytesRead) {
+        *bytesRead = inFmtCtx->pb ? inFmtCtx->pb->bytes_read : 0;
+    }
+    avformat_close_input(&inFmtCtx);
+    return true;
+}
+
+// 定位到片段起点之前最近的关键帧
+static void seekToClipStart(AVFormatContext *inFmtCtx, const KeyframeIndex &index, int64_t startTimeMs) {
+    if(startTimeMs <= 0) {
+        return;
+    }
+
+    int64_t startUs = av_rescale_q(startTimeMs, {1, 1000}, AV_TIME_BASE_Q);
+    if(index.videoStreamId < 0 || index.entries.empty()) {
+        if(av_seek_frame(inFmtCtx, -1, startUs, AVSEEK_FLAG_BACKWARD) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Seek to startTime : %lld failed\n", (long long)startTimeMs);
+        }
+        return;
+    }
+
+    // 最后一个时间 <= 起点的关键帧
+    int64_t startTs = av_rescale_q(startUs, AV_TIME_BASE_Q, index.timeBase);
+    auto it = std::upper_bound(index.entries.begin(), index.entries.end(), startTs, [](int64_t ts, const KeyframeEntry &entry) {
+        return ts < entry.timestamp;
+    });
+    const KeyframeEntry &entry = it == index.entries.begin() ? *it : *(it - 1);
+
+    // 支持按字节seek的容器(如ts)直接跳到关键帧的偏移，不需要再二分查找
+    if(index.byteSeekable && entry.pos >= 0) {
+        if(av_seek_frame(inFmtCtx, -1, entry.pos, AVSEEK_FLAG_BYTE) >= 0) {
+            return;
+        }
+    }
+    // mp4等容器不支持按字节seek，用关键帧准确的时间戳seek，demuxer内部同样是查索引
+    if(av_seek_frame(inFmtCtx, index.videoStreamId, entry.timestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Seek to keyframe : %lld failed\n", (long long)entry.timestamp);
+    }
+}
+
+// 一个worker处理一个片段，使用自己的AVFormatContext
+static bool trimClipWorker(const std::string &src, const KeyframeIndex &index, const TrimClip &clip, int64_t &bytesRead) {
+    bytesRead = 0;
+    AVFormatContext *inFmtCtx = nullptr;
+    if(avformat_open_input(&inFmtCtx, src.c_str(), NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open src file failed.\n");
+        return false;
+    }
+
+    if(avformat_find_stream_info(inFmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info failed\n");
+        avformat_close_input(&inFmtCtx);
+        return false;
+    }
+
+    seekToClipStart(inFmtCtx, index, clip.startTimeMs);
+
+    ClipOutput out;
+    out.clip = clip;
+    AVPacket *inPacket = av_packet_alloc();
+    AVPacket *outPacket = av_packet_alloc();
+    if(inPacket == nullptr || outPacket == nullptr || !openClipOutput(inFmtCtx, out)) {
+        av_log(NULL, AV_LOG_ERROR, "Prepare clip %s failed.\n", clip.dst.c_str());
+        av_packet_free(&inPacket);
+        av_packet_free(&outPacket);
+        avformat_close_input(&inFmtCtx);
+        return false;
+    }
+
+    while(av_read_frame(inFmtCtx, inPacket) >= 0) {
+        bool inClip = writeClipPacket(inFmtCtx, out, inPacket, outPacket);
+        av_packet_unref(inPacket);
+        if(!inClip || out.failed) {
+            break;
+        }
+    }
+    bool succeeded = closeClipOutput(out);
+
+    bytesRead = inFmtCtx->pb ? inFmtCtx->pb->bytes_read : 0;
+    av_packet_free(&inPacket);
+    av_packet_free(&outPacket);
+    avformat_close_input(&inFmtCtx);
+    return succeeded;
+}
+
+bool remuxingTrimParallel(std::string src, const std::vector<TrimClip> &clips, int threadNum, ParallelTrimStats *stats,
+                          const KeyframeIndex *prebuilt) {
+    auto wallBegin = std::chrono::steady_clock::now();
+
+    // 调用方传入了索引时不再打开/扫描输入
+    KeyframeIndex built;
+    int64_t indexBytes = 0;
+    if(prebuilt == nullptr && !buildKeyframeIndex(src, built, &indexBytes)) {
+        return false;
+    }
+    const KeyframeIndex &index = prebuilt ? *prebuilt : built;
+    auto indexEnd = std::chrono::steady_clock::now();
+
+    if(threadNum <= 0) {
+        threadNum = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadNum = std::min<int>(threadNum, clips.size());
+
+    // 每个线程从队列中取下一个片段
+    std::atomic<size_t> nextClip(0);
+    std::atomic<int> failedNum(0);
+    std::vector<int64_t> clipBytes(clips.size(), 0);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threadNum; ++t) {
+        workers.emplace_back([&]() {
+            size_t i = 0;
+            while((i = nextClip++) < clips.size()) {
+                if(!trimClipWorker(src, index, clips[i], clipBytes[i])) {
+                    ++failedNum;
+                }
+            }
+        });
+    }
+    for(auto &worker : workers) {
+        worker.join();
+    }
+
+    auto wallEnd = std::chrono::steady_clock::now();
+
+    ParallelTrimStats result;
+    result.clipNum = clips.size();
+    result.threadNum = threadNum;
+    result.indexBytesRead = indexBytes;
+    result.indexEntries = index.entries.size();
+    for(auto bytes : clipBytes) {
+        result.clipBytesRead += bytes;
+    }
+    result.indexSec = std::chrono::duration<double>(indexEnd - wallBegin).count();
+    result.wallSec = std::chrono::duration<double>(wallEnd - wallBegin).count();
+
+    av_log(NULL, AV_LOG_INFO, "parallel trim : %d clips, %d threads, %d keyframes indexed, "
+           "index %lld bytes %.3fs, clips %lld bytes, total %.3fs\n",
+           result.clipNum, result.threadNum, result.indexEntries,
+           (long long)result.indexBytesRead, result.indexSec, (long long)result.clipBytesRead, result.wallSec);
+
+    if(stats) {
+        *stats = result;
+    }
+    return failedNum == 0;
+}
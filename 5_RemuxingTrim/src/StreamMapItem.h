@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+
+// 主要用于记录每一路流的首帧时间
+struct PacketTime {
+    int64_t dts = 0;
+    int64_t pts = 0;
+};
+
+// 用于记录转封装时路的映射信息
+struct StreamMapItem {
+    int srcStreamId = -1;
+    int dstStreamId = -1;
+    PacketTime firstPacketTime;
+    bool isFirstPkt = true;
+};
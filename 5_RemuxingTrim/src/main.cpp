@@ -2,5 +2,23 @@
 
 int main() {
     remuxingTrim("../res/big_buck_bunny.mp4", "./TrimOut.mp4", 10000, 20000);
+    remuxingTrimAccurate("../res/big_buck_bunny.mp4", "./TrimOutAccurate.mp4", 10000, 20000);
+    remuxingTrimMulti("../res/big_buck_bunny.mp4", {
+        {"./TrimClip1.mp4", 5000, 15000},
+        {"./TrimClip2.mp4", 10000, 20000},
+        {"./TrimClip3.mp4", 30000, 35000},
+    });
+    // 同一个输入的多批片段共用一份关键帧索引
+    KeyframeIndex index;
+    if(buildKeyframeIndex("../res/big_buck_bunny.mp4", index)) {
+        remuxingTrimParallel("../res/big_buck_bunny.mp4", {
+            {"./TrimParallel1.mp4", 5000, 15000},
+            {"./TrimParallel2.mp4", 30000, 35000},
+            {"./TrimParallel3.mp4", 50000, 60000},
+        }, 0, nullptr, &index);
+        remuxingTrimParallel("../res/big_buck_bunny.mp4", {
+            {"./TrimParallel4.mp4", 70000, 80000},
+        }, 0, nullptr, &index);
+    }
     return 0;
 }
\ No newline at end of file
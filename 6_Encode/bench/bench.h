@@ -0,0 +1,6 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// 测试图案生成器在各个指令集下的速度，sizes为 "宽x高"
+void runPatternBench(const std::vector<std::string> &sizes);
@@ -0,0 +1,174 @@
+#include "bench.h"
+#include "encodeProfile.h"
+#include "frameSource.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/log.h>
+}
+
+// 编码参数的组合测试，结果以JSON输出到stdout，进度输出到stderr
+// 用法 : ./6_Encode_bench [选项]
+//   --inputs synthetic,../res/big_buck_bunny.mp4   synthetic表示合成的测试图案
+//   --codecs libx264,libx265
+//   --presets ultrafast,veryfast,medium,slow       none表示不设置
+//   --tunes none,zerolatency
+//   --threads 1,4,0                                0表示由编码器决定
+//   --thread-types frame,slice
+//   --sizes 640x360,1280x720,1920x1080
+//   --frames 150
+//   --bitrate 2000000                              不设置时使用编码器默认的码率控制
+//   --no-quality                                   不计算PSNR/SSIM
+//   --generator                                    只测试测试图案生成器在各个指令集下的速度
+
+static std::vector<std::string> splitList(const char *arg) {
+    std::vector<std::string> items;
+    std::string str(arg);
+    size_t begin = 0;
+    while(begin <= str.size()) {
+        size_t end = str.find(',', begin);
+        if(end == std::string::npos) {
+            end = str.size();
+        }
+        if(end > begin) {
+            items.push_back(str.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+    return items;
+}
+
+static int parseThreadType(const std::string &name) {
+    if(name == "frame") {
+        return FF_THREAD_FRAME;
+    } else if(name == "slice") {
+        return FF_THREAD_SLICE;
+    }
+    return FF_THREAD_FRAME | FF_THREAD_SLICE;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> inputs = {"synthetic", "../res/big_buck_bunny.mp4"};
+    std::vector<std::string> codecs = {"libx264"};
+    std::vector<std::string> presets = {"ultrafast", "veryfast", "medium", "slow"};
+    std::vector<std::string> tunes = {"none", "zerolatency"};
+    std::vector<std::string> threads = {"1", "0"};
+    std::vector<std::string> threadTypes = {"frame", "slice"};
+    std::vector<std::string> sizes = {"640x360", "1280x720", "1920x1080"};
+    int frameNum = 150;
+    int64_t bitRate = 0;
+    bool measureQuality = true;
+    bool generatorOnly = false;
+
+    for(int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--inputs") == 0 && hasValue) {
+            inputs = splitList(argv[++i]);
+        } else if(strcmp(argv[i], "--codecs") == 0 && hasValue) {
+            codecs = splitList(argv[++i]);
+        } else if(strcmp(argv[i], "--presets") == 0 && hasValue) {
+            presets = splitList(argv[++i]);
+        } else if(strcmp(argv[i], "--tunes") == 0 && hasValue) {
+            tunes = splitList(argv[++i]);
+        } else if(strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threads = splitList(argv[++i]);
+        } else if(strcmp(argv[i], "--thread-types") == 0 && hasValue) {
+            threadTypes = splitList(argv[++i]);
+        } else if(strcmp(argv[i], "--sizes") == 0 && hasValue) {
+            sizes = splitList(argv[++i]);
+        } else if(strcmp(argv[i], "--frames") == 0 && hasValue) {
+            frameNum = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--bitrate") == 0 && hasValue) {
+            bitRate = atoll(argv[++i]);
+        } else if(strcmp(argv[i], "--no-quality") == 0) {
+            measureQuality = false;
+        } else if(strcmp(argv[i], "--generator") == 0) {
+            generatorOnly = true;
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // 统计期间关闭FFmpeg的日志输出，只保留错误
+    av_log_set_level(AV_LOG_ERROR);
+
+    if(generatorOnly) {
+        runPatternBench(sizes);
+        return 0;
+    }
+
+    // 源帧最多缓存这么多，更多的帧循环使用
+    const int MAX_SOURCE_FRAMES = 60;
+
+    printf("[\n");
+    bool first = true;
+    for(auto &size : sizes) {
+        int width = 0, height = 0;
+        if(sscanf(size.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+            fprintf(stderr, "invalid size %s\n", size.c_str());
+            continue;
+        }
+
+        for(auto &input : inputs) {
+            int sourceNum = std::min(frameNum, MAX_SOURCE_FRAMES);
+            std::vector<AVFrame *> frames = input == "synthetic" ? loadSyntheticFrames(width, height, sourceNum)
+                                                                 : loadFileFrames(input, width, height, sourceNum);
+            if(frames.empty()) {
+                fprintf(stderr, "load frames from %s failed\n", input.c_str());
+                continue;
+            }
+
+            for(auto &codec : codecs) {
+                for(auto &preset : presets) {
+                    for(auto &tune : tunes) {
+                        for(auto &thread : threads) {
+                            for(auto &threadType : threadTypes) {
+                                EncodeSettings settings;
+                                settings.codec = codec;
+                                settings.preset = preset == "none" ? "" : preset;
+                                settings.tune = tune == "none" ? "" : tune;
+                                settings.threadCount = atoi(thread.c_str());
+                                settings.threadType = parseThreadType(threadType);
+                                settings.width = width;
+                                settings.height = height;
+                                settings.frameNum = frameNum;
+                                settings.bitRate = bitRate;
+                                settings.measureQuality = measureQuality;
+
+                                fprintf(stderr, "%s %s %s preset=%s tune=%s threads=%s/%s\n", size.c_str(), input.c_str(),
+                                        codec.c_str(), preset.c_str(), tune.c_str(), thread.c_str(), threadType.c_str());
+                                EncodeMetrics metrics;
+                                if(!encodeProfile(settings, frames, metrics)) {
+                                    continue;
+                                }
+
+                                printf("%s  {\"input\": \"%s\", \"codec\": \"%s\", \"preset\": \"%s\", \"tune\": \"%s\", "
+                                       "\"threads\": %d, \"thread_type\": \"%s\", \"width\": %d, \"height\": %d, "
+                                       "\"frames\": %d, \"fps\": %.2f, "
+                                       "\"latency_ms\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}, "
+                                       "\"bitrate_kbps\": %.1f, \"psnr\": %.3f, \"ssim\": %.5f}",
+                                       first ? "" : ",\n", input.c_str(), codec.c_str(), preset.c_str(), tune.c_str(),
+                                       settings.threadCount, threadType.c_str(), width, height,
+                                       metrics.frames, metrics.fps,
+                                       metrics.latencyP50Ms, metrics.latencyP90Ms, metrics.latencyP99Ms, metrics.latencyMaxMs,
+                                       metrics.bitrateKbps, metrics.psnr, metrics.ssim);
+                                fflush(stdout);
+                                first = false;
+                            }
+                        }
+                    }
+                }
+            }
+            freeFrames(frames);
+        }
+    }
+    printf("\n]\n");
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "bench.h"
+#include "testPattern.h"
+#include <chrono>
+#include <stdio.h>
+
+// 整帧的校验和，用于确认各个指令集的结果一致
+static uint64_t frameChecksum(const AVFrame *frame) {
+    uint64_t sum = 0;
+    for(int plane = 0; plane < 3; ++plane) {
+        int width = plane == 0 ? frame->width : (frame->width + 1) / 2;
+        int height = plane == 0 ? frame->height : (frame->height + 1) / 2;
+        for(int y = 0; y < height; ++y) {
+            const uint8_t *row = frame->data[plane] + y * frame->linesize[plane];
+            for(int x = 0; x < width; ++x) {
+                sum = sum * 131 + row[x];
+            }
+        }
+    }
+    return sum;
+}
+
+void runPatternBench(const std::vector<std::string> &sizes) {
+    // 每个级别至少跑这么久
+    const double MIN_BENCH_SEC = 1.0;
+    const int CHECK_FRAMES = 4;
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2};
+    SimdLevel bestLevel = testPatternSimdLevel();
+
+    printf("[\n");
+    bool first = true;
+    for(auto &size : sizes) {
+        int width = 0, height = 0;
+        if(sscanf(size.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+            fprintf(stderr, "invalid size %s\n", size.c_str());
+            continue;
+        }
+
+        AVFrame *frame = av_frame_alloc();
+        frame->width = width;
+        frame->height = height;
+        frame->format = AV_PIX_FMT_YUV420P;
+        if(av_frame_get_buffer(frame, 0) < 0) {
+            fprintf(stderr, "allocate frame buffer failed\n");
+            av_frame_free(&frame);
+            continue;
+        }
+
+        uint64_t scalarChecksum = 0;
+        for(auto level : levels) {
+            if(level > bestLevel) {
+                continue;
+            }
+            setTestPatternSimdLevel(level);
+
+            uint64_t checksum = 0;
+            for(int i = 0; i < CHECK_FRAMES; ++i) {
+                fillTestPattern(frame, i);
+                checksum = checksum * 31 + frameChecksum(frame);
+            }
+            if(level == SimdLevel::Scalar) {
+                scalarChecksum = checksum;
+            }
+
+            int64_t frames = 0;
+            double sec = 0;
+            auto begin = std::chrono::steady_clock::now();
+            while(sec < MIN_BENCH_SEC) {
+                fillTestPattern(frame, frames++);
+                sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            }
+
+            double fps = frames / sec;
+            double mbps = fps * width * height * 3 / 2 / 1024 / 1024;
+            printf("%s  {\"generator\": \"%s\", \"width\": %d, \"height\": %d, \"fps\": %.1f, \"mb_per_sec\": %.1f, "
+                   "\"matches_scalar\": %s}",
+                   first ? "" : ",\n", simdLevelName(level), width, height, fps, mbps,
+                   checksum == scalarChecksum ? "true" : "false");
+            fflush(stdout);
+            first = false;
+        }
+        av_frame_free(&frame);
+    }
+    printf("\n]\n");
+    setTestPatternSimdLevel(bestLevel);
+}
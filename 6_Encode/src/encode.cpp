@@ -1,4 +1,6 @@
 #include "encode.h"
+#include "framePool.h"
+#include "testPattern.h"
 extern "C" {
     #include <libavformat/avformat.h>
     #include <libavcodec/avcodec.h>
@@ -10,23 +12,6 @@ const int FRAME_HEIGHT = 320;
 
 const int TEST_FRAME_SIZE = 30 * 10;
 
-void setDefaultColor(AVFrame *frame) {
-    // Y
-    for(int y = 0; y < frame->height; ++y) {
-        for(int x = 0; x < frame->width; ++x) {
-            frame->data[0][y * frame->linesize[0] + x] = 0;
-        }
-    }
-
-    // U & V
-    for(int y = 0; y < frame->height/2; ++y) {
-        for(int x = 0; x < frame->width/2; ++x) {
-            frame->data[1][y * frame->linesize[1] + x] = 0;
-            frame->data[2][y * frame->linesize[2] + x] = 0;
-        }
-    }
-}
-
 void encode(std::string dst) {
     AVFormatContext* fmtCtx = nullptr;
     int ret = avformat_alloc_output_context2(&fmtCtx, NULL, NULL, dst.c_str());
@@ -91,29 +76,23 @@ void encode(std::string dst) {
         return;
     }
 
+    // AVFrame只分配一次，每一帧的缓冲从池中取，编码器用完后自动回到池中
+    FramePool framePool(FRAME_WIDTH, FRAME_HEIGHT, AV_PIX_FMT_YUV420P);
     AVFrame *frame = av_frame_alloc();
-    frame->width = FRAME_WIDTH;
-    frame->height= FRAME_HEIGHT;
-    frame->format= AV_PIX_FMT_YUV420P;
 
     AVPacket *packet = av_packet_alloc();
 
-    ret = av_frame_get_buffer(frame, 0);
-    if(ret < 0) {
-        av_log(NULL, AV_LOG_ERROR, "allocate frame buffer failed\n");
-        return;
-    }
-
-    ret = av_frame_make_writable(frame);
-    if(ret < 0) {
-        av_log(NULL, AV_LOG_ERROR, "av frame make writable failed\n");
-        return;
-    }
-
-    // 绿色
-    setDefaultColor(frame);
-
     for(int i = 0;i < TEST_FRAME_SIZE; ++i) {
+        // 放掉上一帧的引用，编码器还在用的话缓冲由编码器释放时回收
+        av_frame_unref(frame);
+        ret = framePool.getBuffer(frame);
+        if(ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "get frame buffer from pool failed\n");
+            return;
+        }
+
+        // 每一帧都在变化的测试图案
+        fillTestPattern(frame, i);
         frame->pts = i;
         int ret = avcodec_send_frame(codecCtx, frame);
         if(ret < 0) {
@@ -178,6 +157,9 @@ void encode(std::string dst) {
         return;
     }
 
+    av_log(NULL, AV_LOG_INFO, "frame pool : %lld requests, %lld allocations\n",
+           (long long)framePool.stats().requests, (long long)framePool.stats().allocations);
+
     avcodec_close(codecCtx);
     avio_closep(&fmtCtx->pb);
     av_frame_free(&frame);
@@ -1,4 +1,66 @@
 #pragma once
+#include "latencyStats.h"
+#include <cstdint>
 #include <string>
 
-void encode(std::string dst);
\ No newline at end of file
+void encode(std::string dst);
+
+// 低延迟编码的参数，面向交互式的实时流
+struct LowLatencyOptions {
+    std::string codec = "libx264";
+    std::string preset = "veryfast";
+    int width = 640;
+    int height = 320;
+    int frameNum = 300;
+    int frameRate = 30;
+    int64_t bitRate = 1000000;
+    int gopSize = 60;                   // 关键帧间隔，开启intraRefresh时是刷新一遍整帧的周期
+    int threadCount = 0;                // 切片线程数，0表示由编码器决定
+    bool intraRefresh = false;          // 用逐列刷新的帧内宏块代替周期性的IDR帧，码率更平稳
+    bool realtime = true;               // 按帧率送帧，模拟采集设备
+};
+
+struct LowLatencyStats {
+    int frames = 0;
+    int64_t bytes = 0;
+    double fps = 0;
+    int maxFramesInFlight = 0;          // 送进编码器还没有拿到packet的帧数的最大值
+    LatencySummary encodeLatency;       // 单帧从送入编码器到拿到packet
+    LatencySummary outputLatency;       // 单帧从送入编码器到数据写到输出IO
+};
+
+// 低延迟编码，不使用B帧和lookahead，使用切片线程，输出通过自定义的不可seek的IO写出
+//   dst : .ts输出mpegts，.mp4输出每帧一个分片的fmp4
+void encodeLowLatency(std::string dst, const LowLatencyOptions &options = LowLatencyOptions(), LowLatencyStats *stats = nullptr);
+
+// 实时编码时编码跟不上采集的处理方式
+enum class OverloadPolicy {
+    Drop,                               // 丢掉过时的帧，只编码最新采集的帧，输出是变帧率的
+    Duplicate,                          // 用上一帧填满错过的时间点，保持恒定帧率；重复帧几乎全是skip宏块，编码很快
+};
+
+struct PacedEncodeOptions {
+    std::string codec = "libx264";
+    std::string preset = "veryfast";
+    std::string tune;                   // 空表示不设置
+    int width = 1280;
+    int height = 720;
+    int frameRate = 30;
+    int frameNum = 300;                 // 采集的帧数，即运行frameNum / frameRate秒
+    int64_t bitRate = 2000000;
+    double latencyBudgetMs = 0;         // 帧采集后超过这么久还没开始编码就算过载，0表示一帧的间隔
+    OverloadPolicy policy = OverloadPolicy::Drop;
+};
+
+struct PacedEncodeStats {
+    int captured = 0;                   // 按时钟采集到的帧
+    int encoded = 0;                    // 送进编码器的帧，包括重复帧
+    int dropped = 0;
+    int duplicated = 0;
+    LatencySummary encodeTime;          // 单帧送入编码器到取完packet的耗时
+    double encodeJitterMs = 0;          // 单帧编码耗时的标准差
+    LatencySummary lag;                 // 端到端延迟 : 帧的采集时间到它的packet写出
+};
+
+// 模拟实时采集 : 按帧率的时钟产生帧，编码跟不上时按policy丢帧或者重复帧
+void encodePaced(std::string dst, const PacedEncodeOptions &options = PacedEncodeOptions(), PacedEncodeStats *stats = nullptr);
@@ -0,0 +1,236 @@
+#include "encode.h"
+#include "framePool.h"
+#include "testPattern.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+}
+
+using Clock = std::chrono::steady_clock;
+
+// 输出IO的状态，数据写出后立即flush，下游马上就能读到
+struct LowLatencyOutput {
+    FILE *file = nullptr;
+    int64_t bytes = 0;
+};
+
+static int lowlatency_write_packet(void *opaque, const uint8_t *buf, int buf_size) {
+    LowLatencyOutput *out = (LowLatencyOutput *)opaque;
+    if(fwrite(buf, 1, buf_size, out->file) != (size_t)buf_size) {
+        return AVERROR(EIO);
+    }
+    fflush(out->file);
+    out->bytes += buf_size;
+    return buf_size;
+}
+
+// 编码器私有的参数，不同编码器支持的不一样，设置失败只做提示
+static void setEncoderOption(AVCodecContext *codecCtx, const char *name, const char *value) {
+    if(av_opt_set(codecCtx->priv_data, name, value, 0) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "%s does not support option %s=%s\n", codecCtx->codec->name, name, value);
+    }
+}
+
+static double elapsedMs(Clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+static void logLatency(const char *name, const LatencySummary &latency) {
+    av_log(NULL, AV_LOG_INFO, "%s latency(ms) : mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+           name, latency.meanMs, latency.p50Ms, latency.p90Ms, latency.p99Ms, latency.maxMs);
+}
+
+void encodeLowLatency(std::string dst, const LowLatencyOptions &options, LowLatencyStats *stats) {
+    AVFormatContext *fmtCtx = nullptr;
+    if(avformat_alloc_output_context2(&fmtCtx, NULL, NULL, dst.c_str()) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "allocate output format context failed\n");
+        return;
+    }
+
+    LowLatencyOutput out;
+    out.file = fopen(dst.c_str(), "wb");
+    if(out.file == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "open output file failed\n");
+        avformat_free_context(fmtCtx);
+        return;
+    }
+
+    // 不可seek的自定义IO，muxer只能顺序写，不会回头改写文件头
+    const int IO_BUFFER_SIZE = 32 * 1024;
+    unsigned char *ioBuffer = (unsigned char *)av_malloc(IO_BUFFER_SIZE);
+    AVIOContext *ioCtx = avio_alloc_context(ioBuffer, IO_BUFFER_SIZE, 1, &out, NULL, lowlatency_write_packet, NULL);
+    fmtCtx->pb = ioCtx;
+    fmtCtx->flags |= AVFMT_FLAG_CUSTOM_IO | AVFMT_FLAG_FLUSH_PACKETS;
+    fmtCtx->max_delay = 0;
+
+    AVStream *strm = avformat_new_stream(fmtCtx, nullptr);
+    const AVCodec *codec = avcodec_find_encoder_by_name(options.codec.c_str());
+    AVCodecContext *codecCtx = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if(strm == nullptr || codecCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot create encoder %s\n", options.codec.c_str());
+        av_freep(&ioCtx->buffer);
+        avio_context_free(&ioCtx);
+        fclose(out.file);
+        avformat_free_context(fmtCtx);
+        return;
+    }
+
+    AVRational timeBase = {1, options.frameRate};
+    codecCtx->width = options.width;
+    codecCtx->height = options.height;
+    codecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+    codecCtx->time_base = timeBase;
+    codecCtx->framerate = AVRational{options.frameRate, 1};
+    codecCtx->gop_size = options.gopSize;
+    // 没有B帧，每一帧送进去就能按顺序输出
+    codecCtx->max_b_frames = 0;
+    // 切片线程并行编码同一帧，帧线程会让每个线程积压一帧
+    codecCtx->thread_type = FF_THREAD_SLICE;
+    codecCtx->thread_count = options.threadCount;
+    // VBV只有一帧大小，限制单帧的码率尖峰，接收端不需要大的缓冲
+    codecCtx->bit_rate = options.bitRate;
+    codecCtx->rc_max_rate = options.bitRate;
+    codecCtx->rc_buffer_size = (int)(options.bitRate / options.frameRate);
+    if(fmtCtx->oformat->flags & AVFMT_GLOBALHEADER) {
+        codecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    setEncoderOption(codecCtx, "preset", options.preset.c_str());
+    setEncoderOption(codecCtx, "tune", "zerolatency");
+    setEncoderOption(codecCtx, "rc-lookahead", "0");
+    if(options.intraRefresh) {
+        setEncoderOption(codecCtx, "intra-refresh", "1");
+    }
+
+    if(avcodec_open2(codecCtx, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "codec open failed\n");
+        avcodec_free_context(&codecCtx);
+        av_freep(&ioCtx->buffer);
+        avio_context_free(&ioCtx);
+        fclose(out.file);
+        avformat_free_context(fmtCtx);
+        return;
+    }
+
+    avcodec_parameters_from_context(strm->codecpar, codecCtx);
+    strm->time_base = timeBase;
+
+    // fmp4每一帧一个分片，intra refresh时没有后续的关键帧，不能按关键帧分片
+    AVDictionary *muxOpts = nullptr;
+    if(strcmp(fmtCtx->oformat->name, "mp4") == 0 || strcmp(fmtCtx->oformat->name, "mov") == 0) {
+        av_dict_set(&muxOpts, "movflags", "empty_moov+default_base_moof+frag_every_frame", 0);
+    }
+    int ret = avformat_write_header(fmtCtx, &muxOpts);
+    av_dict_free(&muxOpts);
+
+    FramePool framePool(options.width, options.height, AV_PIX_FMT_YUV420P);
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    if(ret < 0 || frame == nullptr || packet == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "write header failed\n");
+        ret = -1;
+    }
+
+    std::map<int64_t, Clock::time_point> sendTimes;    // pts -> 送入编码器的时间
+    std::vector<double> encodeLatencies, outputLatencies;
+    LowLatencyStats result;
+
+    auto receivePackets = [&]() {
+        int err = 0;
+        while(err >= 0) {
+            err = avcodec_receive_packet(codecCtx, packet);
+            if(err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
+                break;
+            } else if(err < 0) {
+                av_log(NULL, AV_LOG_ERROR, "receive packet failed\n");
+                return false;
+            }
+
+            auto it = sendTimes.find(packet->pts);
+            Clock::time_point sendTime = it != sendTimes.end() ? it->second : Clock::now();
+            if(it != sendTimes.end()) {
+                encodeLatencies.push_back(elapsedMs(sendTime));
+                sendTimes.erase(it);
+            }
+
+            packet->stream_index = strm->index;
+            av_packet_rescale_ts(packet, timeBase, strm->time_base);
+            // 没有B帧，dts单调递增，直接写不经过交织队列
+            if(av_write_frame(fmtCtx, packet) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "write frame failed\n");
+                av_packet_unref(packet);
+                return false;
+            }
+            outputLatencies.push_back(elapsedMs(sendTime));
+            av_packet_unref(packet);
+        }
+        return true;
+    };
+
+    auto begin = Clock::now();
+    for(int i = 0; ret >= 0 && i < options.frameNum; ++i) {
+        av_frame_unref(frame);
+        if(framePool.getBuffer(frame) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "get frame buffer from pool failed\n");
+            break;
+        }
+        fillTestPattern(frame, i);
+        frame->pts = i;
+
+        // 采集设备按帧率产生帧，编码跟不上时不再等待
+        if(options.realtime) {
+            std::this_thread::sleep_until(begin + std::chrono::microseconds((int64_t)i * 1000000 / options.frameRate));
+        }
+
+        sendTimes[i] = Clock::now();
+        if(avcodec_send_frame(codecCtx, frame) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "send frame failed\n");
+            break;
+        }
+        if(!receivePackets()) {
+            break;
+        }
+        result.maxFramesInFlight = std::max(result.maxFramesInFlight, (int)sendTimes.size());
+        ++result.frames;
+    }
+
+    if(ret >= 0 && avcodec_send_frame(codecCtx, NULL) >= 0) {
+        receivePackets();
+    }
+    double wallSec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    if(ret >= 0 && av_write_trailer(fmtCtx) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "write trailer failed\n");
+    }
+
+    result.bytes = out.bytes;
+    result.fps = wallSec > 0 ? result.frames / wallSec : 0;
+    result.encodeLatency = summarizeLatency(encodeLatencies);
+    result.outputLatency = summarizeLatency(outputLatencies);
+    av_log(NULL, AV_LOG_INFO, "low latency encode : %d frames, %.1f fps, %lld bytes, max %d frames in flight\n",
+           result.frames, result.fps, (long long)result.bytes, result.maxFramesInFlight);
+    logLatency("encode", result.encodeLatency);
+    logLatency("output", result.outputLatency);
+    av_log(NULL, AV_LOG_INFO, "frame pool : %lld requests, %lld allocations\n",
+           (long long)framePool.stats().requests, (long long)framePool.stats().allocations);
+    if(stats) {
+        *stats = result;
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&codecCtx);
+    av_freep(&ioCtx->buffer);
+    avio_context_free(&ioCtx);
+    fmtCtx->pb = nullptr;
+    fclose(out.file);
+    avformat_free_context(fmtCtx);
+}
@@ -0,0 +1,204 @@
+#include "encode.h"
+#include "framePool.h"
+#include "testPattern.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double standardDeviation(const std::vector<double> &samples) {
+    if(samples.size() < 2) {
+        return 0;
+    }
+    double sum = 0, sumSquare = 0;
+    for(double value : samples) {
+        sum += value;
+        sumSquare += value * value;
+    }
+    double mean = sum / samples.size();
+    return std::sqrt(std::max(0.0, sumSquare / samples.size() - mean * mean));
+}
+
+void encodePaced(std::string dst, const PacedEncodeOptions &options, PacedEncodeStats *stats) {
+    AVFormatContext *fmtCtx = nullptr;
+    if(avformat_alloc_output_context2(&fmtCtx, NULL, NULL, dst.c_str()) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "allocate output format context failed\n");
+        return;
+    }
+    if(avio_open(&fmtCtx->pb, dst.c_str(), AVIO_FLAG_WRITE) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "avio open failed\n");
+        avformat_free_context(fmtCtx);
+        return;
+    }
+
+    AVStream *strm = avformat_new_stream(fmtCtx, nullptr);
+    const AVCodec *codec = avcodec_find_encoder_by_name(options.codec.c_str());
+    AVCodecContext *codecCtx = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if(strm == nullptr || codecCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot create encoder %s\n", options.codec.c_str());
+        avio_closep(&fmtCtx->pb);
+        avformat_free_context(fmtCtx);
+        return;
+    }
+
+    // pts就是采集的时间点，丢帧时pts不连续
+    AVRational timeBase = {1, options.frameRate};
+    codecCtx->width = options.width;
+    codecCtx->height = options.height;
+    codecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+    codecCtx->time_base = timeBase;
+    codecCtx->framerate = AVRational{options.frameRate, 1};
+    codecCtx->bit_rate = options.bitRate;
+    if(fmtCtx->oformat->flags & AVFMT_GLOBALHEADER) {
+        codecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    if(!options.preset.empty()) {
+        av_opt_set(codecCtx->priv_data, "preset", options.preset.c_str(), 0);
+    }
+    if(!options.tune.empty()) {
+        av_opt_set(codecCtx->priv_data, "tune", options.tune.c_str(), 0);
+    }
+
+    int ret = avcodec_open2(codecCtx, codec, NULL);
+    if(ret >= 0) {
+        avcodec_parameters_from_context(strm->codecpar, codecCtx);
+        strm->time_base = timeBase;
+        ret = avformat_write_header(fmtCtx, NULL);
+    }
+    if(ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "open encoder or write header failed\n");
+        avcodec_free_context(&codecCtx);
+        avio_closep(&fmtCtx->pb);
+        avformat_free_context(fmtCtx);
+        return;
+    }
+
+    FramePool framePool(options.width, options.height, AV_PIX_FMT_YUV420P);
+    AVFrame *frame = av_frame_alloc();
+    AVFrame *lastFrame = av_frame_alloc();     // 上一个采集的帧，重复帧时引用它
+    AVPacket *packet = av_packet_alloc();
+
+    const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.frameRate));
+    const double budgetMs = options.latencyBudgetMs > 0 ? options.latencyBudgetMs : 1000.0 / options.frameRate;
+    PacedEncodeStats result;
+    std::vector<double> encodeTimes, lags;
+    auto begin = Clock::now();
+    auto captureTime = [&](int64_t index) { return begin + interval * index; };
+
+    bool ok = true;
+    auto receivePackets = [&]() {
+        int err = 0;
+        while(err >= 0) {
+            err = avcodec_receive_packet(codecCtx, packet);
+            if(err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
+                break;
+            } else if(err < 0) {
+                av_log(NULL, AV_LOG_ERROR, "receive packet failed\n");
+                ok = false;
+                break;
+            }
+
+            // pts对应的采集时间到现在，包括编码器内部的缓冲
+            lags.push_back(std::chrono::duration<double, std::milli>(Clock::now() - captureTime(packet->pts)).count());
+            packet->stream_index = strm->index;
+            av_packet_rescale_ts(packet, timeBase, strm->time_base);
+            if(av_interleaved_write_frame(fmtCtx, packet) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "write frame failed\n");
+                ok = false;
+                break;
+            }
+        }
+    };
+
+    auto encodeFrame = [&](AVFrame *input) {
+        auto sendBegin = Clock::now();
+        if(avcodec_send_frame(codecCtx, input) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "send frame failed\n");
+            ok = false;
+            return;
+        }
+        receivePackets();
+        encodeTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - sendBegin).count());
+        ++result.encoded;
+    };
+
+    int index = 0;
+    while(ok && index < options.frameNum) {
+        // 还没到采集时间就等待，模拟采集设备
+        std::this_thread::sleep_until(captureTime(index));
+        auto now = Clock::now();
+
+        // 当前帧已经等了太久，说明编码跟不上，已经采集到了更新的帧
+        double waitedMs = std::chrono::duration<double, std::milli>(now - captureTime(index)).count();
+        int newest = std::min<int64_t>(options.frameNum - 1, (now - begin) / interval);
+        if(waitedMs > budgetMs && newest > index) {
+            if(options.policy == OverloadPolicy::Duplicate && lastFrame->buf[0] != nullptr) {
+                for(; index < newest && ok; ++index) {
+                    AVFrame *duplicate = av_frame_clone(lastFrame);
+                    if(duplicate == nullptr) {
+                        av_log(NULL, AV_LOG_ERROR, "clone frame for duplicate failed\n");
+                        ok = false;
+                        break;
+                    }
+                    duplicate->pts = index;
+                    encodeFrame(duplicate);
+                    av_frame_free(&duplicate);
+                    ++result.duplicated;
+                }
+            } else {
+                result.dropped += newest - index;
+                index = newest;
+            }
+        }
+
+        av_frame_unref(frame);
+        if(framePool.getBuffer(frame) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "get frame buffer from pool failed\n");
+            break;
+        }
+        fillTestPattern(frame, index);
+        frame->pts = index;
+        encodeFrame(frame);
+
+        av_frame_unref(lastFrame);
+        av_frame_ref(lastFrame, frame);
+        ++index;
+    }
+    result.captured = index;
+
+    if(ok && avcodec_send_frame(codecCtx, NULL) >= 0) {
+        receivePackets();
+    }
+    if(av_write_trailer(fmtCtx) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "write trailer failed\n");
+    }
+
+    result.encodeTime = summarizeLatency(encodeTimes);
+    result.encodeJitterMs = standardDeviation(encodeTimes);
+    result.lag = summarizeLatency(lags);
+    av_log(NULL, AV_LOG_INFO, "paced encode : %d captured, %d encoded, %d dropped, %d duplicated\n",
+           result.captured, result.encoded, result.dropped, result.duplicated);
+    av_log(NULL, AV_LOG_INFO, "encode time(ms) : mean %.3f, p99 %.3f, max %.3f, jitter %.3f\n",
+           result.encodeTime.meanMs, result.encodeTime.p99Ms, result.encodeTime.maxMs, result.encodeJitterMs);
+    av_log(NULL, AV_LOG_INFO, "end-to-end lag(ms) : p50 %.3f, p99 %.3f, max %.3f\n",
+           result.lag.p50Ms, result.lag.p99Ms, result.lag.maxMs);
+    if(stats) {
+        *stats = result;
+    }
+
+    av_frame_free(&frame);
+    av_frame_free(&lastFrame);
+    av_packet_free(&packet);
+    avcodec_free_context(&codecCtx);
+    avio_closep(&fmtCtx->pb);
+    avformat_free_context(fmtCtx);
+}
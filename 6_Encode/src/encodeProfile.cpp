@@ -0,0 +1,184 @@
+#include "encodeProfile.h"
+#include "frameQuality.h"
+#include "latencyStats.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+extern "C" {
+#include <libavutil/opt.h>
+}
+
+using Clock = std::chrono::steady_clock;
+
+// 解码编码的输出，和源帧对比，得到平均的PSNR/SSIM
+static void measureQuality(const AVCodecContext *encCtx, const std::vector<AVPacket *> &packets,
+                           const std::vector<AVFrame *> &frames, EncodeMetrics &metrics) {
+    const AVCodec *codec = avcodec_find_decoder(encCtx->codec_id);
+    AVCodecContext *decCtx = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if(decCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find decoder for quality measurement\n");
+        return;
+    }
+    AVCodecParameters *par = avcodec_parameters_alloc();
+    avcodec_parameters_from_context(par, encCtx);
+    avcodec_parameters_to_context(decCtx, par);
+    avcodec_parameters_free(&par);
+    if(avcodec_open2(decCtx, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open decoder failed\n");
+        avcodec_free_context(&decCtx);
+        return;
+    }
+
+    AVFrame *decoded = av_frame_alloc();
+    double psnrSum = 0;
+    double ssimSum = 0;
+    int compared = 0;
+    auto receiveFrames = [&]() {
+        while(avcodec_receive_frame(decCtx, decoded) >= 0) {
+            // pts就是源帧的序号
+            if(decoded->format == AV_PIX_FMT_YUV420P && decoded->pts != AV_NOPTS_VALUE) {
+                const AVFrame *ref = frames[decoded->pts % frames.size()];
+                FrameQuality quality = compareFrames(ref, decoded);
+                psnrSum += quality.psnr;
+                ssimSum += quality.ssim;
+                ++compared;
+            }
+            av_frame_unref(decoded);
+        }
+    };
+    for(auto &packet : packets) {
+        if(avcodec_send_packet(decCtx, packet) >= 0) {
+            receiveFrames();
+        }
+    }
+    avcodec_send_packet(decCtx, NULL);
+    receiveFrames();
+
+    if(compared > 0) {
+        metrics.psnr = psnrSum / compared;
+        metrics.ssim = ssimSum / compared;
+    }
+    av_frame_free(&decoded);
+    avcodec_free_context(&decCtx);
+}
+
+bool encodeProfile(const EncodeSettings &settings, const std::vector<AVFrame *> &frames, EncodeMetrics &metrics) {
+    if(frames.empty()) {
+        return false;
+    }
+
+    const AVCodec *codec = avcodec_find_encoder_by_name(settings.codec.c_str());
+    if(codec == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find encoder %s\n", settings.codec.c_str());
+        return false;
+    }
+
+    AVCodecContext *codecCtx = avcodec_alloc_context3(codec);
+    if(codecCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot allocate context\n");
+        return false;
+    }
+
+    codecCtx->width = settings.width;
+    codecCtx->height = settings.height;
+    codecCtx->time_base = av_inv_q(settings.frameRate);
+    codecCtx->framerate = settings.frameRate;
+    codecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+    codecCtx->thread_count = settings.threadCount;
+    codecCtx->thread_type = settings.threadType;
+    if(settings.bitRate > 0) {
+        codecCtx->bit_rate = settings.bitRate;
+    }
+    if(settings.gopSize > 0) {
+        codecCtx->gop_size = settings.gopSize;
+    }
+
+    // 编码器不支持的preset/tune直接跳过这组参数
+    if(!settings.preset.empty() && av_opt_set(codecCtx->priv_data, "preset", settings.preset.c_str(), 0) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "%s does not support preset %s\n", settings.codec.c_str(), settings.preset.c_str());
+        avcodec_free_context(&codecCtx);
+        return false;
+    }
+    if(!settings.tune.empty() && av_opt_set(codecCtx->priv_data, "tune", settings.tune.c_str(), 0) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "%s does not support tune %s\n", settings.codec.c_str(), settings.tune.c_str());
+        avcodec_free_context(&codecCtx);
+        return false;
+    }
+
+    if(avcodec_open2(codecCtx, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "codec open failed\n");
+        avcodec_free_context(&codecCtx);
+        return false;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    std::vector<AVPacket *> outPackets;
+    std::map<int64_t, Clock::time_point> sendTimes;    // pts -> 送入编码器的时间
+    std::vector<double> latencies;
+    metrics = EncodeMetrics();
+
+    bool ok = true;
+    auto receivePackets = [&]() {
+        int ret = 0;
+        while(ret >= 0) {
+            ret = avcodec_receive_packet(codecCtx, packet);
+            if(ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                break;
+            } else if(ret < 0) {
+                av_log(NULL, AV_LOG_ERROR, "receive packet failed\n");
+                ok = false;
+                break;
+            }
+
+            auto it = sendTimes.find(packet->pts);
+            if(it != sendTimes.end()) {
+                latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - it->second).count());
+                sendTimes.erase(it);
+            }
+            metrics.bytes += packet->size;
+            if(settings.measureQuality) {
+                outPackets.push_back(av_packet_clone(packet));
+            }
+            av_packet_unref(packet);
+        }
+    };
+
+    auto begin = Clock::now();
+    for(int i = 0; i < settings.frameNum && ok; ++i) {
+        AVFrame *frame = frames[i % frames.size()];
+        frame->pts = i;
+        sendTimes[i] = Clock::now();
+        if(avcodec_send_frame(codecCtx, frame) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "send frame failed\n");
+            ok = false;
+            break;
+        }
+        receivePackets();
+    }
+    if(ok && avcodec_send_frame(codecCtx, NULL) >= 0) {
+        receivePackets();
+    }
+    metrics.wallSec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    metrics.frames = settings.frameNum;
+    metrics.fps = metrics.wallSec > 0 ? metrics.frames / metrics.wallSec : 0;
+    LatencySummary latency = summarizeLatency(latencies);
+    metrics.latencyP50Ms = latency.p50Ms;
+    metrics.latencyP90Ms = latency.p90Ms;
+    metrics.latencyP99Ms = latency.p99Ms;
+    metrics.latencyMaxMs = latency.maxMs;
+    double durationSec = metrics.frames / av_q2d(settings.frameRate);
+    metrics.bitrateKbps = durationSec > 0 ? metrics.bytes * 8 / durationSec / 1000 : 0;
+
+    if(ok && settings.measureQuality) {
+        measureQuality(codecCtx, outPackets, frames, metrics);
+    }
+
+    for(auto &pkt : outPackets) {
+        av_packet_free(&pkt);
+    }
+    av_packet_free(&packet);
+    avcodec_free_context(&codecCtx);
+    return ok;
+}
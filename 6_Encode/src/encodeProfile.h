@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+struct EncodeSettings {
+    std::string codec = "libx264";      // 编码器的名字
+    std::string preset = "medium";      // 空表示不设置
+    std::string tune;                   // 空表示不设置
+    int threadCount = 0;                // 0表示由编码器决定
+    int threadType = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    int width = 640;
+    int height = 320;
+    int frameNum = 300;
+    AVRational frameRate = {30, 1};
+    int64_t bitRate = 0;                // 0表示使用编码器默认的码率控制(如x264的crf 23)
+    int gopSize = 0;                    // 0表示编码器默认
+    bool measureQuality = true;         // 解码输出计算PSNR/SSIM，不计入编码耗时
+};
+
+struct EncodeMetrics {
+    int frames = 0;
+    int64_t bytes = 0;
+    double wallSec = 0;
+    double fps = 0;
+    double latencyP50Ms = 0;            // 单帧从送入编码器到拿到packet的延迟
+    double latencyP90Ms = 0;
+    double latencyP99Ms = 0;
+    double latencyMaxMs = 0;
+    double bitrateKbps = 0;
+    double psnr = 0;
+    double ssim = 0;
+};
+
+// 用给定的参数编码frames(循环使用)，统计速度、延迟、码率和质量
+//   frames : YUV420P，分辨率和settings一致
+bool encodeProfile(const EncodeSettings &settings, const std::vector<AVFrame *> &frames, EncodeMetrics &metrics);
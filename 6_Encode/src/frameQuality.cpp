@@ -0,0 +1,71 @@
+#include "frameQuality.h"
+#include <algorithm>
+#include <cmath>
+
+// 一个平面的误差平方和
+static double planeSquaredError(const uint8_t *a, int strideA, const uint8_t *b, int strideB, int width, int height) {
+    uint64_t sum = 0;
+    for(int y = 0; y < height; ++y) {
+        const uint8_t *rowA = a + y * strideA;
+        const uint8_t *rowB = b + y * strideB;
+        for(int x = 0; x < width; ++x) {
+            int diff = rowA[x] - rowB[x];
+            sum += diff * diff;
+        }
+    }
+    return (double)sum;
+}
+
+// 8x8的窗口，步长4，和x264的SSIM计算方式一致
+static double planeSSIM(const uint8_t *a, int strideA, const uint8_t *b, int strideB, int width, int height) {
+    const double C1 = (0.01 * 255) * (0.01 * 255);
+    const double C2 = (0.03 * 255) * (0.03 * 255);
+    const int WINDOW = 8;
+    const int STEP = 4;
+
+    double total = 0;
+    int count = 0;
+    for(int y = 0; y + WINDOW <= height; y += STEP) {
+        for(int x = 0; x + WINDOW <= width; x += STEP) {
+            int64_t sumA = 0, sumB = 0, sumAA = 0, sumBB = 0, sumAB = 0;
+            for(int wy = 0; wy < WINDOW; ++wy) {
+                const uint8_t *rowA = a + (y + wy) * strideA + x;
+                const uint8_t *rowB = b + (y + wy) * strideB + x;
+                for(int wx = 0; wx < WINDOW; ++wx) {
+                    sumA += rowA[wx];
+                    sumB += rowB[wx];
+                    sumAA += rowA[wx] * rowA[wx];
+                    sumBB += rowB[wx] * rowB[wx];
+                    sumAB += rowA[wx] * rowB[wx];
+                }
+            }
+            const double n = WINDOW * WINDOW;
+            double meanA = sumA / n;
+            double meanB = sumB / n;
+            double varA = sumAA / n - meanA * meanA;
+            double varB = sumBB / n - meanB * meanB;
+            double covar = sumAB / n - meanA * meanB;
+            total += ((2 * meanA * meanB + C1) * (2 * covar + C2))
+                     / ((meanA * meanA + meanB * meanB + C1) * (varA + varB + C2));
+            ++count;
+        }
+    }
+    return count > 0 ? total / count : 1.0;
+}
+
+FrameQuality compareFrames(const AVFrame *ref, const AVFrame *dist) {
+    FrameQuality quality;
+    double error = 0;
+    double pixels = 0;
+    for(int plane = 0; plane < 3; ++plane) {
+        int width = plane == 0 ? ref->width : (ref->width + 1) / 2;
+        int height = plane == 0 ? ref->height : (ref->height + 1) / 2;
+        error += planeSquaredError(ref->data[plane], ref->linesize[plane], dist->data[plane], dist->linesize[plane], width, height);
+        pixels += (double)width * height;
+    }
+
+    double mse = error / pixels;
+    quality.psnr = mse > 0 ? std::min(100.0, 10 * std::log10(255.0 * 255.0 / mse)) : 100.0;
+    quality.ssim = planeSSIM(ref->data[0], ref->linesize[0], dist->data[0], dist->linesize[0], ref->width, ref->height);
+    return quality;
+}
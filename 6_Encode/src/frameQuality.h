@@ -0,0 +1,13 @@
+#pragma once
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+struct FrameQuality {
+    double psnr = 0;    // Y/U/V按像素数加权的PSNR，完全一致时为100
+    double ssim = 0;    // 亮度的SSIM
+};
+
+// 对比两帧相同分辨率的YUV420P图像
+FrameQuality compareFrames(const AVFrame *ref, const AVFrame *dist);
@@ -0,0 +1,119 @@
+#include "frameSource.h"
+#include "testPattern.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+static AVFrame *allocYUV420PFrame(int width, int height) {
+    AVFrame *frame = av_frame_alloc();
+    if(frame == nullptr) {
+        return nullptr;
+    }
+    frame->width = width;
+    frame->height = height;
+    frame->format = AV_PIX_FMT_YUV420P;
+    if(av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+    return frame;
+}
+
+std::vector<AVFrame *> loadSyntheticFrames(int width, int height, int frameNum) {
+    std::vector<AVFrame *> frames;
+    for(int i = 0; i < frameNum; ++i) {
+        AVFrame *frame = allocYUV420PFrame(width, height);
+        if(frame == nullptr) {
+            av_log(NULL, AV_LOG_ERROR, "allocate frame buffer failed\n");
+            break;
+        }
+
+        fillTestPattern(frame, i);
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+std::vector<AVFrame *> loadFileFrames(const std::string &url, int width, int height, int frameNum) {
+    std::vector<AVFrame *> frames;
+
+    AVFormatContext *fmtCtx = nullptr;
+    if(avformat_open_input(&fmtCtx, url.c_str(), NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open src file failed.\n");
+        return frames;
+    }
+    if(avformat_find_stream_info(fmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info failed\n");
+        avformat_close_input(&fmtCtx);
+        return frames;
+    }
+
+    const AVCodec *codec = nullptr;
+    int streamId = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if(streamId < 0 || codec == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find video stream\n");
+        avformat_close_input(&fmtCtx);
+        return frames;
+    }
+
+    AVCodecContext *codecCtx = avcodec_alloc_context3(codec);
+    if(codecCtx == nullptr || avcodec_parameters_to_context(codecCtx, fmtCtx->streams[streamId]->codecpar) < 0
+       || avcodec_open2(codecCtx, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open decoder failed\n");
+        avcodec_free_context(&codecCtx);
+        avformat_close_input(&fmtCtx);
+        return frames;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *decoded = av_frame_alloc();
+    SwsContext *swsCtx = nullptr;
+
+    // 解码出的帧缩放到目标分辨率
+    auto convertFrame = [&]() {
+        swsCtx = sws_getCachedContext(swsCtx, decoded->width, decoded->height, (AVPixelFormat)decoded->format,
+                                      width, height, AV_PIX_FMT_YUV420P, SWS_BICUBIC, NULL, NULL, NULL);
+        AVFrame *frame = swsCtx ? allocYUV420PFrame(width, height) : nullptr;
+        if(frame) {
+            sws_scale(swsCtx, decoded->data, decoded->linesize, 0, decoded->height, frame->data, frame->linesize);
+            frames.push_back(frame);
+        }
+        av_frame_unref(decoded);
+    };
+
+    bool inputEnd = false;
+    while((int)frames.size() < frameNum && !inputEnd) {
+        int ret = av_read_frame(fmtCtx, packet);
+        if(ret < 0) {
+            inputEnd = true;
+            avcodec_send_packet(codecCtx, NULL);
+        } else if(packet->stream_index != streamId) {
+            av_packet_unref(packet);
+            continue;
+        } else {
+            avcodec_send_packet(codecCtx, packet);
+            av_packet_unref(packet);
+        }
+
+        while((int)frames.size() < frameNum && avcodec_receive_frame(codecCtx, decoded) >= 0) {
+            convertFrame();
+        }
+    }
+
+    sws_freeContext(swsCtx);
+    av_frame_free(&decoded);
+    av_packet_free(&packet);
+    avcodec_free_context(&codecCtx);
+    avformat_close_input(&fmtCtx);
+    return frames;
+}
+
+void freeFrames(std::vector<AVFrame *> &frames) {
+    for(auto &frame : frames) {
+        av_frame_free(&frame);
+    }
+    frames.clear();
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// 编码测试用的源帧，都是YUV420P，预先放在内存里，编码时循环使用，不计入编码的耗时
+
+// 合成的测试图案，每一帧内容都在移动，见testPattern.h
+std::vector<AVFrame *> loadSyntheticFrames(int width, int height, int frameNum);
+
+// 解码文件的前frameNum帧，缩放到指定的分辨率
+std::vector<AVFrame *> loadFileFrames(const std::string &url, int width, int height, int frameNum);
+
+void freeFrames(std::vector<AVFrame *> &frames);
@@ -0,0 +1,40 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+// 一组延迟样本的分布，单位ms
+struct LatencySummary {
+    int count = 0;
+    double meanMs = 0;
+    double p50Ms = 0;
+    double p90Ms = 0;
+    double p99Ms = 0;
+    double maxMs = 0;
+};
+
+inline double percentile(const std::vector<double> &sorted, double p) {
+    if(sorted.empty()) {
+        return 0;
+    }
+    size_t idx = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+    return sorted[idx];
+}
+
+inline LatencySummary summarizeLatency(std::vector<double> samplesMs) {
+    LatencySummary summary;
+    if(samplesMs.empty()) {
+        return summary;
+    }
+    std::sort(samplesMs.begin(), samplesMs.end());
+    double sum = 0;
+    for(double ms : samplesMs) {
+        sum += ms;
+    }
+    summary.count = (int)samplesMs.size();
+    summary.meanMs = sum / samplesMs.size();
+    summary.p50Ms = percentile(samplesMs, 0.50);
+    summary.p90Ms = percentile(samplesMs, 0.90);
+    summary.p99Ms = percentile(samplesMs, 0.99);
+    summary.maxMs = samplesMs.back();
+    return summary;
+}
@@ -1,6 +1,26 @@
 #include "encode.h"
+#include "renditionEncoder.h"
 
 int main() {
     encode("./test.mp4");
+
+    // 低延迟编码，输出可以直接推给下游的mpegts
+    LowLatencyOptions options;
+    options.intraRefresh = true;
+    encodeLowLatency("./test_lowlatency.ts", options);
+
+    // 同一个源同时编码三路ABR输出，关键帧对齐
+    RenditionOptions renditions;
+    renditions.renditions = {
+        {"./test_1080p.mp4", 1920, 1080, 5000000},
+        {"./test_720p.mp4", 1280, 720, 2500000},
+        {"./test_360p.mp4", 640, 360, 800000},
+    };
+    encodeRenditions(renditions);
+
+    // 模拟实时采集，编码跟不上时丢帧
+    PacedEncodeOptions paced;
+    paced.policy = OverloadPolicy::Drop;
+    encodePaced("./test_paced.mp4", paced);
     return 0;
-}
\ No newline at end of file
+}
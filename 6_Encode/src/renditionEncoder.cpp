@@ -0,0 +1,417 @@
+#include "renditionEncoder.h"
+#include "framePool.h"
+#include "testPattern.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+using Clock = std::chrono::steady_clock;
+
+// 源线程和一个编码线程之间有界的帧队列
+class FrameQueue {
+public:
+    explicit FrameQueue(int capacity) : capacity_(std::max(1, capacity)) {}
+    ~FrameQueue() {
+        for(auto &frame : frames_) {
+            av_frame_free(&frame);
+        }
+    }
+
+    // 接管frame，队列满时等待编码线程取走
+    void push(AVFrame *frame) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [&]() { return (int)frames_.size() < capacity_; });
+        frames_.push_back(frame);
+        notEmpty_.notify_one();
+    }
+
+    // 源结束，编码线程取完剩下的帧后退出
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+    }
+
+    // 返回nullptr表示队列已经关闭并且取空了
+    AVFrame *pop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [&]() { return !frames_.empty() || closed_; });
+        if(frames_.empty()) {
+            return nullptr;
+        }
+        AVFrame *frame = frames_.front();
+        frames_.pop_front();
+        notFull_.notify_one();
+        return frame;
+    }
+
+private:
+    int capacity_ = 1;
+    bool closed_ = false;
+    std::deque<AVFrame *> frames_;
+    std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+};
+
+// 缩放金字塔的一级，从上一级(更大的分辨率)缩放得到
+struct PyramidLevel {
+    int width = 0;
+    int height = 0;
+    int parent = -1;                    // -1表示直接从源缩放
+    SwsContext *swsCtx = nullptr;
+    std::unique_ptr<FramePool> pool;    // 和parent分辨率相同时为空，直接引用parent的帧
+    AVFrame *frame = nullptr;
+};
+
+struct RenditionWorker {
+    Rendition rendition;
+    int level = 0;
+    std::unique_ptr<FrameQueue> queue;
+    AVFormatContext *fmtCtx = nullptr;
+    AVCodecContext *codecCtx = nullptr;
+    AVStream *strm = nullptr;
+    bool ok = true;
+    RenditionStats stats;
+    std::thread thread;
+};
+
+static void setEncoderOption(AVCodecContext *codecCtx, const char *name, const char *value) {
+    if(av_opt_set(codecCtx->priv_data, name, value, 0) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "%s does not support option %s=%s\n", codecCtx->codec->name, name, value);
+    }
+}
+
+static bool openRenditionOutput(RenditionWorker &worker, const RenditionOptions &options, int threadCount) {
+    const Rendition &rendition = worker.rendition;
+    if(avformat_alloc_output_context2(&worker.fmtCtx, NULL, NULL, rendition.dst.c_str()) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "allocate output format context for %s failed\n", rendition.dst.c_str());
+        return false;
+    }
+    if(avio_open(&worker.fmtCtx->pb, rendition.dst.c_str(), AVIO_FLAG_WRITE) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "avio open %s failed\n", rendition.dst.c_str());
+        return false;
+    }
+    worker.strm = avformat_new_stream(worker.fmtCtx, nullptr);
+
+    const AVCodec *codec = avcodec_find_encoder_by_name(options.codec.c_str());
+    worker.codecCtx = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if(worker.strm == nullptr || worker.codecCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot create encoder %s\n", options.codec.c_str());
+        return false;
+    }
+
+    AVCodecContext *codecCtx = worker.codecCtx;
+    codecCtx->width = rendition.width;
+    codecCtx->height = rendition.height;
+    codecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+    codecCtx->bit_rate = rendition.bitRate;
+    codecCtx->time_base = AVRational{1, options.frameRate};
+    codecCtx->framerate = AVRational{options.frameRate, 1};
+    // 关键帧只出现在强制的位置上，固定的GOP
+    codecCtx->gop_size = options.keyframeInterval;
+    codecCtx->keyint_min = options.keyframeInterval;
+    // 多路编码器同时运行，平分CPU，避免每个编码器都按核数开线程
+    codecCtx->thread_count = threadCount;
+    if(worker.fmtCtx->oformat->flags & AVFMT_GLOBALHEADER) {
+        codecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    setEncoderOption(codecCtx, "preset", options.preset.c_str());
+    // 强制的I帧编码成IDR，关闭场景切换检测，不产生额外的、各路不一致的关键帧
+    setEncoderOption(codecCtx, "forced-idr", "1");
+    setEncoderOption(codecCtx, "x264-params", "scenecut=0");
+
+    if(avcodec_open2(codecCtx, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "codec open for %s failed\n", rendition.dst.c_str());
+        return false;
+    }
+    if(avcodec_parameters_from_context(worker.strm->codecpar, codecCtx) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Copy parameters from context failed\n");
+        return false;
+    }
+    worker.strm->time_base = codecCtx->time_base;
+
+    if(avformat_write_header(worker.fmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "write header of %s failed\n", rendition.dst.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void closeRenditionOutput(RenditionWorker &worker) {
+    avcodec_free_context(&worker.codecCtx);
+    if(worker.fmtCtx) {
+        avio_closep(&worker.fmtCtx->pb);
+        avformat_free_context(worker.fmtCtx);
+        worker.fmtCtx = nullptr;
+    }
+}
+
+static bool receiveRenditionPackets(RenditionWorker &worker, AVPacket *packet, int keyframeInterval) {
+    int ret = 0;
+    while(ret >= 0) {
+        ret = avcodec_receive_packet(worker.codecCtx, packet);
+        if(ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            break;
+        } else if(ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "receive packet of %s failed\n", worker.rendition.dst.c_str());
+            return false;
+        }
+
+        if(packet->flags & AV_PKT_FLAG_KEY) {
+            ++worker.stats.keyframes;
+            if(packet->pts % keyframeInterval != 0) {
+                worker.stats.keyframesAligned = false;
+            }
+        }
+        worker.stats.bytes += packet->size;
+
+        packet->stream_index = worker.strm->index;
+        av_packet_rescale_ts(packet, worker.codecCtx->time_base, worker.strm->time_base);
+        if(av_interleaved_write_frame(worker.fmtCtx, packet) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "write frame of %s failed\n", worker.rendition.dst.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// 编码线程 : 从队列取帧编码，出错后仍然把队列取空，不让源线程阻塞
+static void runRenditionWorker(RenditionWorker *worker, int keyframeInterval) {
+    AVPacket *packet = av_packet_alloc();
+    worker->ok = worker->ok && packet != nullptr;
+    auto begin = Clock::now();
+
+    AVFrame *frame = nullptr;
+    while((frame = worker->queue->pop()) != nullptr) {
+        if(worker->ok) {
+            // 所有输出在同样的pts上强制IDR
+            frame->pict_type = frame->pts % keyframeInterval == 0 ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+            if(avcodec_send_frame(worker->codecCtx, frame) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "send frame to %s failed\n", worker->rendition.dst.c_str());
+                worker->ok = false;
+            } else {
+                ++worker->stats.frames;
+                worker->ok = receiveRenditionPackets(*worker, packet, keyframeInterval);
+            }
+        }
+        av_frame_free(&frame);
+    }
+
+    if(worker->ok && avcodec_send_frame(worker->codecCtx, NULL) >= 0) {
+        worker->ok = receiveRenditionPackets(*worker, packet, keyframeInterval);
+    }
+    if(worker->ok && av_write_trailer(worker->fmtCtx) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "write trailer of %s failed\n", worker->rendition.dst.c_str());
+        worker->ok = false;
+    }
+
+    double wallSec = std::chrono::duration<double>(Clock::now() - begin).count();
+    worker->stats.fps = wallSec > 0 ? worker->stats.frames / wallSec : 0;
+    int expectedKeyframes = (worker->stats.frames + keyframeInterval - 1) / keyframeInterval;
+    if(worker->stats.keyframes != expectedKeyframes) {
+        worker->stats.keyframesAligned = false;
+    }
+    av_packet_free(&packet);
+}
+
+// 读一帧YUV420P的原始数据，读到结尾时从头循环
+static bool readRawFrame(FILE *file, AVFrame *frame) {
+    for(int loop = 0; loop < 2; ++loop) {
+        bool ok = true;
+        for(int plane = 0; plane < 3 && ok; ++plane) {
+            int width = plane == 0 ? frame->width : (frame->width + 1) / 2;
+            int height = plane == 0 ? frame->height : (frame->height + 1) / 2;
+            for(int y = 0; y < height && ok; ++y) {
+                ok = fread(frame->data[plane] + y * frame->linesize[plane], 1, width, file) == (size_t)width;
+            }
+        }
+        if(ok) {
+            return true;
+        }
+        fseek(file, 0, SEEK_SET);
+    }
+    return false;
+}
+
+// 按分辨率从大到小建立金字塔，每一级从能覆盖它的最小的上一级缩放
+static std::vector<PyramidLevel> buildPyramid(const RenditionOptions &options, std::vector<RenditionWorker> &workers) {
+    std::vector<PyramidLevel> levels;
+    std::vector<int> order(workers.size());
+    for(size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return workers[a].rendition.width * workers[a].rendition.height > workers[b].rendition.width * workers[b].rendition.height;
+    });
+
+    for(int idx : order) {
+        const Rendition &rendition = workers[idx].rendition;
+        auto found = std::find_if(levels.begin(), levels.end(), [&](const PyramidLevel &level) {
+            return level.width == rendition.width && level.height == rendition.height;
+        });
+        if(found != levels.end()) {
+            workers[idx].level = found - levels.begin();
+            continue;
+        }
+
+        PyramidLevel level;
+        level.width = rendition.width;
+        level.height = rendition.height;
+        int parentWidth = options.width, parentHeight = options.height;
+        for(int i = (int)levels.size() - 1; i >= 0; --i) {
+            if(levels[i].width >= level.width && levels[i].height >= level.height) {
+                level.parent = i;
+                parentWidth = levels[i].width;
+                parentHeight = levels[i].height;
+                break;
+            }
+        }
+        if(parentWidth != level.width || parentHeight != level.height) {
+            // 每一级只缩小一点，双线性就足够，比从源一次缩到最小的质量更好、也更快
+            level.swsCtx = sws_getContext(parentWidth, parentHeight, AV_PIX_FMT_YUV420P, level.width, level.height,
+                                          AV_PIX_FMT_YUV420P, SWS_BILINEAR, NULL, NULL, NULL);
+            level.pool = std::make_unique<FramePool>(level.width, level.height, AV_PIX_FMT_YUV420P);
+        }
+        level.frame = av_frame_alloc();
+        workers[idx].level = levels.size();
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
+
+bool encodeRenditions(const RenditionOptions &options, std::vector<RenditionStats> *stats) {
+    if(options.renditions.empty() || options.keyframeInterval <= 0) {
+        return false;
+    }
+
+    FILE *rawFile = nullptr;
+    if(!options.src.empty()) {
+        rawFile = fopen(options.src.c_str(), "rb");
+        if(rawFile == nullptr) {
+            av_log(NULL, AV_LOG_ERROR, "open raw source %s failed\n", options.src.c_str());
+            return false;
+        }
+    }
+
+    int cpuCount = std::max(1u, std::thread::hardware_concurrency());
+    int threadCount = std::max(1, cpuCount / (int)options.renditions.size());
+
+    std::vector<RenditionWorker> workers(options.renditions.size());
+    bool ok = true;
+    for(size_t i = 0; i < workers.size(); ++i) {
+        workers[i].rendition = options.renditions[i];
+        workers[i].stats.dst = options.renditions[i].dst;
+        workers[i].queue = std::make_unique<FrameQueue>(options.queueSize);
+        ok = ok && openRenditionOutput(workers[i], options, threadCount);
+    }
+
+    std::vector<PyramidLevel> levels = buildPyramid(options, workers);
+    FramePool sourcePool(options.width, options.height, AV_PIX_FMT_YUV420P);
+    AVFrame *source = av_frame_alloc();
+
+    if(ok) {
+        for(auto &worker : workers) {
+            worker.thread = std::thread(runRenditionWorker, &worker, options.keyframeInterval);
+        }
+    }
+
+    auto begin = Clock::now();
+    for(int i = 0; ok && i < options.frameNum; ++i) {
+        av_frame_unref(source);
+        if(sourcePool.getBuffer(source) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "get source frame failed\n");
+            ok = false;
+            break;
+        }
+        if(rawFile) {
+            if(!readRawFrame(rawFile, source)) {
+                av_log(NULL, AV_LOG_ERROR, "read raw frame failed\n");
+                ok = false;
+                break;
+            }
+        } else {
+            fillTestPattern(source, i);
+        }
+        source->pts = i;
+
+        // 从大到小逐级缩放，每一级的缓冲在所有引用它的编码器用完后回到池中
+        for(auto &level : levels) {
+            const AVFrame *parent = level.parent < 0 ? source : levels[level.parent].frame;
+            av_frame_unref(level.frame);
+            if(level.pool == nullptr) {
+                av_frame_ref(level.frame, parent);
+                continue;
+            }
+            if(level.swsCtx == nullptr || level.pool->getBuffer(level.frame) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "scale to %dx%d failed\n", level.width, level.height);
+                ok = false;
+                break;
+            }
+            sws_scale(level.swsCtx, parent->data, parent->linesize, 0, parent->height, level.frame->data, level.frame->linesize);
+            level.frame->pts = i;
+        }
+
+        for(auto &worker : workers) {
+            if(!ok) {
+                break;
+            }
+            AVFrame *frame = av_frame_clone(levels[worker.level].frame);
+            if(frame == nullptr) {
+                ok = false;
+                break;
+            }
+            worker.queue->push(frame);
+        }
+    }
+
+    for(auto &worker : workers) {
+        worker.queue->close();
+    }
+    for(auto &worker : workers) {
+        if(worker.thread.joinable()) {
+            worker.thread.join();
+        }
+        ok = ok && worker.ok;
+    }
+    double wallSec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    av_log(NULL, AV_LOG_INFO, "%zu renditions, %d frames in %.3fs\n", workers.size(), options.frameNum, wallSec);
+    for(auto &worker : workers) {
+        av_log(NULL, AV_LOG_INFO, "  %s %dx%d : %d frames, %.1f fps, %lld bytes, %d keyframes%s\n",
+               worker.rendition.dst.c_str(), worker.rendition.width, worker.rendition.height, worker.stats.frames,
+               worker.stats.fps, (long long)worker.stats.bytes, worker.stats.keyframes,
+               worker.stats.keyframesAligned ? "" : " (NOT aligned)");
+    }
+    if(stats) {
+        stats->clear();
+        for(auto &worker : workers) {
+            stats->push_back(worker.stats);
+        }
+    }
+
+    for(auto &level : levels) {
+        av_frame_free(&level.frame);
+        sws_freeContext(level.swsCtx);
+    }
+    for(auto &worker : workers) {
+        closeRenditionOutput(worker);
+    }
+    av_frame_free(&source);
+    if(rawFile) {
+        fclose(rawFile);
+    }
+    return ok;
+}
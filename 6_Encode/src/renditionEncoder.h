@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 一路输出的分辨率和码率
+struct Rendition {
+    std::string dst;
+    int width = 0;
+    int height = 0;
+    int64_t bitRate = 0;
+};
+
+struct RenditionOptions {
+    std::string src;                    // YUV420P的原始视频文件，读到结尾从头循环；空表示使用合成的测试图案
+    int width = 1920;                   // 源的分辨率
+    int height = 1080;
+    int frameRate = 30;
+    int frameNum = 300;
+    std::string codec = "libx264";
+    std::string preset = "veryfast";
+    int keyframeInterval = 60;          // 所有输出在同样的帧上强制IDR，可以在任意两路之间切换
+    int queueSize = 8;                  // 每个编码线程最多积压的帧数，超过时源等待最慢的编码器
+    std::vector<Rendition> renditions;
+};
+
+struct RenditionStats {
+    std::string dst;
+    int frames = 0;
+    int64_t bytes = 0;
+    double fps = 0;
+    int keyframes = 0;
+    bool keyframesAligned = true;       // 关键帧都落在keyframeInterval的整数倍上，且没有多出来的
+};
+
+// 一个源同时编码多路不同分辨率、码率的输出(ABR)
+//   源帧按分辨率从大到小逐级缩放(缩放金字塔)，同样分辨率的输出共享一份缩放结果；
+//   每路编码器在自己的线程上运行
+bool encodeRenditions(const RenditionOptions &options, std::vector<RenditionStats> *stats = nullptr);
@@ -0,0 +1,294 @@
+#include "testPattern.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEST_PATTERN_X86 1
+#include <immintrin.h>
+#endif
+
+// 一行像素的填充 : dst[x] = start + x * slope + (noise[x] & noiseMask)
+//   噪声是8路xorshift32，每次生成32字节，第i路生成 [4i, 4i+4) 的字节(小端)
+//   标量和SIMD的实现按同样的排列生成，结果完全一致
+typedef void (*FillRowFn)(uint8_t *dst, int width, uint8_t start, int slope, uint32_t seed, uint8_t noiseMask);
+
+static const int NOISE_LANES = 8;
+static const int BLOCK_BYTES = 32;
+
+static inline uint32_t xorshift32(uint32_t x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static inline void seedLanes(uint32_t seed, uint32_t lanes[NOISE_LANES]) {
+    for(int i = 0; i < NOISE_LANES; ++i) {
+        // xorshift的状态不能为0
+        lanes[i] = ((seed + i) * 0x9E3779B9u) | 1;
+    }
+}
+
+static inline uint32_t hashU32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static void fillRowScalar(uint8_t *dst, int width, uint8_t start, int slope, uint32_t seed, uint8_t noiseMask) {
+    uint32_t lanes[NOISE_LANES];
+    seedLanes(seed, lanes);
+    for(int x = 0; x < width; x += BLOCK_BYTES) {
+        for(int i = 0; i < NOISE_LANES; ++i) {
+            lanes[i] = xorshift32(lanes[i]);
+        }
+        int n = std::min(BLOCK_BYTES, width - x);
+        for(int k = 0; k < n; ++k) {
+            uint8_t noise = (lanes[k / 4] >> ((k % 4) * 8)) & 0xff;
+            dst[x + k] = (uint8_t)(start + (x + k) * slope + (noise & noiseMask));
+        }
+    }
+}
+
+#ifdef TEST_PATTERN_X86
+__attribute__((target("sse2")))
+static inline __m128i xorshift32x4(__m128i x) {
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    return x;
+}
+
+__attribute__((target("sse2")))
+static void fillRowSSE2(uint8_t *dst, int width, uint8_t start, int slope, uint32_t seed, uint8_t noiseMask) {
+    uint32_t lanes[NOISE_LANES];
+    seedLanes(seed, lanes);
+    __m128i state0 = _mm_loadu_si128((const __m128i *)lanes);
+    __m128i state1 = _mm_loadu_si128((const __m128i *)(lanes + 4));
+
+    __m128i ramp = slope ? _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15) : _mm_setzero_si128();
+    __m128i grad0 = _mm_add_epi8(ramp, _mm_set1_epi8((char)start));
+    __m128i grad1 = _mm_add_epi8(grad0, _mm_set1_epi8((char)(16 * slope)));
+    __m128i step = _mm_set1_epi8((char)(BLOCK_BYTES * slope));
+    __m128i mask = _mm_set1_epi8((char)noiseMask);
+
+    int x = 0;
+    for(; x < width; x += BLOCK_BYTES) {
+        state0 = xorshift32x4(state0);
+        state1 = xorshift32x4(state1);
+        __m128i v0 = _mm_add_epi8(grad0, _mm_and_si128(state0, mask));
+        __m128i v1 = _mm_add_epi8(grad1, _mm_and_si128(state1, mask));
+        grad0 = _mm_add_epi8(grad0, step);
+        grad1 = _mm_add_epi8(grad1, step);
+        if(x + BLOCK_BYTES <= width) {
+            _mm_storeu_si128((__m128i *)(dst + x), v0);
+            _mm_storeu_si128((__m128i *)(dst + x + 16), v1);
+        } else {
+            // 行尾不足32字节
+            alignas(16) uint8_t tail[BLOCK_BYTES];
+            _mm_store_si128((__m128i *)tail, v0);
+            _mm_store_si128((__m128i *)(tail + 16), v1);
+            memcpy(dst + x, tail, width - x);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void fillRowAVX2(uint8_t *dst, int width, uint8_t start, int slope, uint32_t seed, uint8_t noiseMask) {
+    uint32_t lanes[NOISE_LANES];
+    seedLanes(seed, lanes);
+    __m256i state = _mm256_loadu_si256((const __m256i *)lanes);
+
+    __m256i ramp = slope ? _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                            16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31)
+                         : _mm256_setzero_si256();
+    __m256i grad = _mm256_add_epi8(ramp, _mm256_set1_epi8((char)start));
+    __m256i step = _mm256_set1_epi8((char)(BLOCK_BYTES * slope));
+    __m256i mask = _mm256_set1_epi8((char)noiseMask);
+
+    int x = 0;
+    for(; x < width; x += BLOCK_BYTES) {
+        state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+        state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+        state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+        __m256i v = _mm256_add_epi8(grad, _mm256_and_si256(state, mask));
+        grad = _mm256_add_epi8(grad, step);
+        if(x + BLOCK_BYTES <= width) {
+            _mm256_storeu_si256((__m256i *)(dst + x), v);
+        } else {
+            alignas(32) uint8_t tail[BLOCK_BYTES];
+            _mm256_store_si256((__m256i *)tail, v);
+            memcpy(dst + x, tail, width - x);
+        }
+    }
+}
+#endif
+
+static SimdLevel detectSimdLevel() {
+#ifdef TEST_PATTERN_X86
+    if(__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    if(__builtin_cpu_supports("sse2")) {
+        return SimdLevel::SSE2;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+static FillRowFn fillRowFor(SimdLevel level) {
+#ifdef TEST_PATTERN_X86
+    if(level == SimdLevel::AVX2) {
+        return fillRowAVX2;
+    }
+    if(level == SimdLevel::SSE2) {
+        return fillRowSSE2;
+    }
+#endif
+    return fillRowScalar;
+}
+
+static SimdLevel currentLevel = detectSimdLevel();
+static FillRowFn fillRow = fillRowFor(currentLevel);
+
+SimdLevel testPatternSimdLevel() {
+    return currentLevel;
+}
+
+SimdLevel setTestPatternSimdLevel(SimdLevel level) {
+    currentLevel = std::min(level, detectSimdLevel());
+    fillRow = fillRowFor(currentLevel);
+    return currentLevel;
+}
+
+const char *simdLevelName(SimdLevel level) {
+    switch(level) {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::SSE2:
+        return "sse2";
+    case SimdLevel::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+// 8个bit展开成8个像素，文字和帧号都按整格拷贝，不逐像素判断
+static const uint8_t TEXT_ON = 235;
+static const uint8_t TEXT_OFF = 16;
+
+struct BitExpandTable {
+    uint8_t pixels[256][8];
+    BitExpandTable() {
+        for(int bits = 0; bits < 256; ++bits) {
+            for(int i = 0; i < 8; ++i) {
+                pixels[bits][i] = (bits & (0x80 >> i)) ? TEXT_ON : TEXT_OFF;
+            }
+        }
+    }
+};
+static const BitExpandTable bitExpand;
+
+// 水平滚动的文字块 : 8x12的格子，每个格子是由哈希生成的伪字符
+static void drawScrollingText(AVFrame *frame, int64_t frameIndex) {
+    const int CELL_W = 8;
+    const int CELL_H = 12;
+    const int BANDS = 3;
+    for(int band = 0; band < BANDS; ++band) {
+        int top = frame->height * (2 * band + 1) / (2 * BANDS) - CELL_H;
+        if(top < 0 || top + CELL_H * 2 > frame->height) {
+            continue;
+        }
+        // 每条文字的速度和方向不同
+        int64_t scroll = frameIndex * (band + 1) * 3 * (band % 2 ? -1 : 1);
+        int64_t firstCell = scroll >= 0 ? scroll / CELL_W : -((-scroll + CELL_W - 1) / CELL_W);
+        int shift = (int)(scroll - firstCell * CELL_W);
+
+        for(int y = 0; y < CELL_H * 2; ++y) {
+            uint8_t *row = frame->data[0] + (top + y) * frame->linesize[0];
+            int glyphRow = y / 2;
+            for(int x = -shift, cell = 0; x < frame->width; x += CELL_W, ++cell) {
+                uint32_t code = hashU32((uint32_t)(firstCell + cell) * 31 + band);
+                // 字符之间留出空白，第一行和最后一行为空
+                uint8_t bits = (glyphRow == 0 || glyphRow == CELL_H - 1 || code % 7 == 0)
+                               ? 0 : (hashU32(code + glyphRow) & 0x7E);
+                int begin = std::max(x, 0);
+                int end = std::min(x + CELL_W, frame->width);
+                if(end > begin) {
+                    memcpy(row + begin, bitExpand.pixels[bits] + (begin - x), end - begin);
+                }
+            }
+        }
+    }
+}
+
+// 3x5的数字字形，每行3个bit
+static const uint8_t DIGIT_FONT[10][5] = {
+    {7, 5, 5, 5, 7}, {2, 6, 2, 2, 7}, {7, 1, 7, 4, 7}, {7, 1, 7, 1, 7}, {5, 5, 7, 1, 1},
+    {7, 4, 7, 1, 7}, {7, 4, 7, 5, 7}, {7, 1, 1, 1, 1}, {7, 5, 7, 5, 7}, {7, 5, 7, 1, 7},
+};
+
+// 左上角烧入帧号，每个字形的点放大为8x8
+static void drawFrameCounter(AVFrame *frame, int64_t frameIndex) {
+    const int SCALE = 8;
+    const int DIGITS = 8;
+    const int MARGIN = 8;
+    char text[32];
+    snprintf(text, sizeof(text), "%0*lld", DIGITS, (long long)(frameIndex % 100000000));
+
+    int boxWidth = DIGITS * 4 * SCALE + SCALE;
+    int boxHeight = 7 * SCALE;
+    if(MARGIN + boxWidth > frame->width || MARGIN + boxHeight > frame->height) {
+        return;
+    }
+    for(int y = 0; y < boxHeight; ++y) {
+        uint8_t *row = frame->data[0] + (MARGIN + y) * frame->linesize[0] + MARGIN;
+        memset(row, TEXT_OFF, boxWidth);
+        int fontRow = y / SCALE - 1;
+        if(fontRow < 0 || fontRow >= 5) {
+            continue;
+        }
+        for(int d = 0; d < DIGITS; ++d) {
+            uint8_t bits = DIGIT_FONT[text[d] - '0'][fontRow];
+            for(int col = 0; col < 3; ++col) {
+                if(bits & (4 >> col)) {
+                    memset(row + SCALE + (d * 4 + col) * SCALE, TEXT_ON, SCALE);
+                }
+            }
+        }
+    }
+}
+
+void fillTestPattern(AVFrame *frame, int64_t frameIndex, const TestPatternOptions &options) {
+    int slope = options.gradient ? 1 : 0;
+    uint32_t frameSeed = hashU32((uint32_t)frameIndex);
+
+    // Y : 斜向移动的渐变，噪声的幅度为0~15
+    uint8_t lumaMask = options.noise ? 0x0F : 0;
+    for(int y = 0; y < frame->height; ++y) {
+        uint8_t start = options.gradient ? (uint8_t)(y + frameIndex * 2) : 128;
+        fillRow(frame->data[0] + y * frame->linesize[0], frame->width, start, slope, frameSeed ^ hashU32(y), lumaMask);
+    }
+
+    // U & V : 色度渐变，噪声幅度小一些
+    uint8_t chromaMask = options.noise ? 0x03 : 0;
+    int chromaWidth = (frame->width + 1) / 2;
+    int chromaHeight = (frame->height + 1) / 2;
+    for(int y = 0; y < chromaHeight; ++y) {
+        uint8_t startU = options.gradient ? (uint8_t)(64 + y - frameIndex) : 128;
+        uint8_t startV = options.gradient ? (uint8_t)(192 - y + frameIndex) : 128;
+        fillRow(frame->data[1] + y * frame->linesize[1], chromaWidth, startU, slope, frameSeed ^ hashU32(y + 0x10000), chromaMask);
+        fillRow(frame->data[2] + y * frame->linesize[2], chromaWidth, startV, slope, frameSeed ^ hashU32(y + 0x20000), chromaMask);
+    }
+
+    if(options.scrollingText) {
+        drawScrollingText(frame, frameIndex);
+    }
+    if(options.frameCounter) {
+        drawFrameCounter(frame, frameIndex);
+    }
+}
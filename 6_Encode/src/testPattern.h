@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// 合成的测试图案，用于编码的压力测试，每一帧都在变化，避免静止画面让编码器过于轻松
+struct TestPatternOptions {
+    bool gradient = true;       // 斜向移动的渐变，关闭时为平坦的灰色
+    bool noise = true;          // 叠加的随机噪声
+    bool scrollingText = true;  // 水平滚动的文字块
+    bool frameCounter = true;   // 左上角的帧号
+};
+
+// 填充像素使用的指令集，默认使用CPU支持的最高级别
+enum class SimdLevel {
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+SimdLevel testPatternSimdLevel();
+// 强制使用某个级别，用于对比测试，CPU不支持时降级，返回实际使用的级别
+SimdLevel setTestPatternSimdLevel(SimdLevel level);
+const char *simdLevelName(SimdLevel level);
+
+// 生成第frameIndex帧，frame为已经分配好、可写的YUV420P帧
+//   不同指令集生成的结果完全一致
+void fillTestPattern(AVFrame *frame, int64_t frameIndex, const TestPatternOptions &options = TestPatternOptions());
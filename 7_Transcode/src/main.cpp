@@ -2,5 +2,6 @@
 
 int main() {
     transcode("../res/big_buck_bunny.mp4", "./transcode.mp4");
+    transcode("../res/big_buck_bunny.mp4", "./transcode_faststart.mp4", true);
     return 0;
 }
\ No newline at end of file
@@ -1,5 +1,13 @@
 #include "transcode.h"
 #include "formatItem.h"
+#include "moovReserve.h"
+#include <climits>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+    #include "libavutil/opt.h"
+}
 
 // 输入是原始文件待解码的流
 FormatItem::CodecSetting getDecodeSetting(AVStream *stream) {
@@ -70,7 +78,27 @@ void handleVideoFrame(AVFrame* inFrame, AVFrame *outFrame) {
 
 }
 
-void transcode(std::string src, std::string dst) {
+// 预留的moov空间不够时，moov改写到文件尾，预留的空洞标记为free box，保证文件仍然可以解析
+//   movenc的预留空间紧跟在ftyp之后
+static bool markReservedMoovFree(const std::string &dst, int64_t reservedSize) {
+    FILE *file = fopen(dst.c_str(), "r+b");
+    if(file == nullptr) {
+        return false;
+    }
+    uint8_t header[8];
+    bool ok = fread(header, 1, 4, file) == 4;
+    uint32_t ftypSize = (header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+    header[0] = (reservedSize >> 24) & 0xff;
+    header[1] = (reservedSize >> 16) & 0xff;
+    header[2] = (reservedSize >> 8) & 0xff;
+    header[3] = reservedSize & 0xff;
+    memcpy(header + 4, "free", 4);
+    ok = ok && fseek(file, ftypSize, SEEK_SET) == 0 && fwrite(header, 1, 8, file) == 8;
+    fclose(file);
+    return ok;
+}
+
+void transcode(std::string src, std::string dst, bool reserveMoov) {
     sp<FormatItem> inItem = FormatItem::openInputFormat(src);
     sp<FormatItem> outItem = FormatItem::openOutputFormat(dst);
 
@@ -110,12 +138,35 @@ void transcode(std::string src, std::string dst) {
     AVPacket *outPacket = av_packet_alloc();
     AVFrame *outFrame = av_frame_alloc();
 
+    // 在文件头预留moov的空间，编码器的输出帧数和输入大致相同，按输入估计
+    int64_t moovSize = 0;
+    AVDictionary *muxOpts = nullptr;
+    if(reserveMoov) {
+        moovSize = estimateMoovSize(inItem->fmtCtx, outItem->fmtCtx, streamIdxMap, false);
+        if(moovSize > 0 && moovSize <= INT_MAX) {
+            av_dict_set_int(&muxOpts, "moov_size", moovSize, 0);
+        } else {
+            av_log(NULL, AV_LOG_WARNING, "Cannot estimate moov size, fall back to fragmented output\n");
+            av_dict_set(&muxOpts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+            moovSize = 0;
+        }
+    }
+
     // 写入头部信息
-    if(avformat_write_header(outItem->fmtCtx, NULL) < 0) {
+    int ret = avformat_write_header(outItem->fmtCtx, &muxOpts);
+    av_dict_free(&muxOpts);
+    if(ret < 0) {
         av_log(NULL, AV_LOG_ERROR, "Write header failed.\n");
         return;
     }
 
+    // 按写入的packet数累计moov大小的上限，用来判断预留的空间是否足够
+    std::vector<int> bytesPerSample(outItem->fmtCtx->nb_streams);
+    for(int i = 0; i < outItem->fmtCtx->nb_streams; ++i) {
+        bytesPerSample[i] = moovBytesPerSample(outItem->fmtCtx->streams[i]->codecpar);
+    }
+    int64_t moovBound = moovFixedSize(outItem->fmtCtx);
+
     // 注意，写完header之后，stream的timebase可能会发生改变。
     for(int i = 0; i < outItem->fmtCtx->nb_streams; ++i) {
         auto &strm = outItem->fmtCtx->streams[i];
@@ -192,6 +243,7 @@ void transcode(std::string src, std::string dst) {
                 }
 
                 outPacket->stream_index = outStreamId;
+                moovBound += bytesPerSample[outStreamId];
 
                 // 交叉写入音频和视频帧
                 if(av_interleaved_write_frame(outItem->fmtCtx, outPacket) < 0) {
@@ -260,6 +312,7 @@ void transcode(std::string src, std::string dst) {
                 }
 
                 outPacket->stream_index = outStreamId;
+                moovBound += bytesPerSample[outStreamId];
 
                 // 交叉写入音频和视频帧
                 if(av_interleaved_write_frame(outItem->fmtCtx, outPacket) < 0) {
@@ -301,6 +354,7 @@ void transcode(std::string src, std::string dst) {
             }
 
             outPacket->stream_index = outStreamId;
+            moovBound += bytesPerSample[outStreamId];
 
             // 交叉写入音频和视频帧
             if(av_interleaved_write_frame(outItem->fmtCtx, outPacket) < 0) {
@@ -310,12 +364,26 @@ void transcode(std::string src, std::string dst) {
         }
     }
 
+    // 预留的空间不够时，moov写回预留位置会覆盖mdat，改为写在文件尾
+    bool moovOverflow = moovSize > 0 && moovBound > moovSize;
+    if(moovOverflow) {
+        av_log(NULL, AV_LOG_WARNING, "Reserved moov size %lld is too small, write moov at the end\n", (long long)moovSize);
+        av_opt_set_int(outItem->fmtCtx->priv_data, "moov_size", 0, 0);
+    }
+
     // 写入尾部数据
     if(av_write_trailer(outItem->fmtCtx) < 0) {
         av_log(NULL, AV_LOG_ERROR, "Write trailer failed\n");
         return;
     }
 
+    if(moovOverflow) {
+        avio_closep(&outItem->fmtCtx->pb);
+        if(!markReservedMoovFree(dst, moovSize)) {
+            av_log(NULL, AV_LOG_ERROR, "Mark reserved moov space failed\n");
+        }
+    }
+
     av_packet_free(&inPacket);
     av_packet_free(&outPacket);
     av_frame_free(&inFrame);
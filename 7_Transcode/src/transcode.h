@@ -1,4 +1,6 @@
 #pragma once
 #include <string>
 
-void transcode(std::string src, std::string dst);
\ No newline at end of file
+// reserveMoov : 在文件头预留moov的空间，trailer时原地写入，不需要faststart的第二遍重写
+//   预留的大小根据输入的帧数估计，估计不出来时改为分片输出
+void transcode(std::string src, std::string dst, bool reserveMoov = false);
\ No newline at end of file
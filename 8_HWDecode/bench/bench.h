@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/hwcontext.h>
+}
+
+// 当前机器上能创建出设备的硬件类型，按defaultHWDecodePriority()的顺序
+std::vector<AVHWDeviceType> availableHWDevices();
+
+// 每个文件从打开到解出第一帧的耗时，对比每次新建解码器和使用解码器池
+void runPoolBench(const std::vector<std::string> &corpus);
+
+// 只解关键帧的缩略图和完整解码的每文件耗时，以及多文件并行的吞吐
+void runThumbnailBench(const std::vector<std::string> &corpus);
+
+// 稀疏采样时每返回一帧解码了多少帧，以及和完整解码的耗时对比
+void runSampleBench(const std::vector<std::string> &corpus);
+
+// 解码时保存所有帧 : 解码线程上每行一次fwrite和异步写线程的对比
+void runDumpBench(const std::vector<std::string> &corpus);
+
+// 各种软解线程方式和硬件后端的解码吞吐，结果以JSON输出到stdout
+void runDecodeBench(const std::vector<std::string> &corpus);
+
+// 随机、顺序向前、逐帧向后三种访问方式下，每次取帧的延迟
+void runSeekBench(const std::vector<std::string> &corpus);
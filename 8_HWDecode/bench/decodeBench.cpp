@@ -0,0 +1,157 @@
+#include "bench.h"
+#include "decoderBackend.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+struct DecodeConfig {
+    std::string name;
+    DecoderOptions options;
+};
+
+std::vector<AVHWDeviceType> availableHWDevices() {
+    std::vector<AVHWDeviceType> devices;
+    for(AVHWDeviceType deviceType : defaultHWDecodePriority()) {
+        AVBufferRef *deviceCtx = nullptr;
+        if(av_hwdevice_ctx_create(&deviceCtx, deviceType, NULL, NULL, 0) >= 0) {
+            av_buffer_unref(&deviceCtx);
+            devices.push_back(deviceType);
+        }
+    }
+    return devices;
+}
+
+static double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// 清零进程的峰值内存(VmHWM)，每组配置单独统计；不支持时峰值是整个进程的
+static void resetPeakRss() {
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    if(file) {
+        fputs("5", file);
+        fclose(file);
+    }
+}
+
+static double peakRssMb() {
+    FILE *file = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = -1;
+    while(file && fgets(line, sizeof(line), file)) {
+        if(strncmp(line, "VmHWM:", 6) == 0) {
+            kb = atol(line + 6);
+            break;
+        }
+    }
+    if(file) {
+        fclose(file);
+    }
+    if(kb < 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        kb = usage.ru_maxrss;
+    }
+    return kb / 1024.0;
+}
+
+// JSON字符串中的引号、反斜杠和控制字符需要转义，路径和FFmpeg的错误信息里都可能有
+static std::string jsonEscape(const std::string &str) {
+    std::string escaped;
+    for(unsigned char c : str) {
+        if(c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += (char)c;
+        } else if(c < 0x20) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            escaped += buffer;
+        } else {
+            escaped += (char)c;
+        }
+    }
+    return escaped;
+}
+
+static std::vector<DecodeConfig> decodeConfigs() {
+    std::vector<DecodeConfig> configs;
+    DecodeConfig config;
+    config.options.hwPriority.clear();
+
+    config.name = "sw-single";
+    config.options.threadCount = 1;
+    configs.push_back(config);
+
+    config.name = "sw-frame";
+    config.options.threadCount = 0;
+    config.options.threadType = FF_THREAD_FRAME;
+    configs.push_back(config);
+
+    config.name = "sw-slice";
+    config.options.threadType = FF_THREAD_SLICE;
+    configs.push_back(config);
+
+    // 硬解分别测拷贝回内存和只留在显存，两者的差就是拷贝的开销
+    for(AVHWDeviceType deviceType : availableHWDevices()) {
+        DecodeConfig hwConfig;
+        hwConfig.options.hwPriority = {deviceType};
+        hwConfig.name = av_hwdevice_get_type_name(deviceType);
+        configs.push_back(hwConfig);
+        hwConfig.name += "-surface";
+        hwConfig.options.cpuFrames = false;
+        configs.push_back(hwConfig);
+    }
+    return configs;
+}
+
+void runDecodeBench(const std::vector<std::string> &corpus) {
+    std::vector<DecodeConfig> configs = decodeConfigs();
+
+    printf("[\n");
+    bool first = true;
+    for(auto &url : corpus) {
+        for(auto &config : configs) {
+            fprintf(stderr, "%s %s\n", url.c_str(), config.name.c_str());
+            resetPeakRss();
+
+            auto begin = std::chrono::steady_clock::now();
+            double cpuBegin = cpuSeconds();
+            VideoDecoder decoder;
+            if(!decoder.open(url, config.options)) {
+                fprintf(stderr, "open %s failed\n", url.c_str());
+                continue;
+            }
+            AVFrame *frame = av_frame_alloc();
+            int ret = 0;
+            while((ret = decoder.receiveFrame(frame)) >= 0) {
+                av_frame_unref(frame);
+            }
+            av_frame_free(&frame);
+            double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            double cpuSec = cpuSeconds() - cpuBegin;
+            if(ret != AVERROR_EOF) {
+                fprintf(stderr, "decode %s failed\n", url.c_str());
+                continue;
+            }
+
+            const DecoderBackendInfo &info = decoder.info();
+            const DecoderStats &stats = decoder.stats();
+            double frames = stats.frames > 0 ? stats.frames : 1;
+            printf("%s  {\"input\": \"%s\", \"codec\": \"%s\", \"config\": \"%s\", \"backend\": \"%s\", "
+                   "\"threads\": %d, \"thread_type\": \"%s\", \"frames\": %lld, \"wall_sec\": %.3f, \"fps\": %.2f, "
+                   "\"cpu_ms_per_frame\": %.3f, \"peak_rss_mb\": %.1f, \"transfer_ms_per_frame\": %.3f, \"fallback\": \"%s\"}",
+                   first ? "" : ",\n", jsonEscape(url).c_str(), jsonEscape(info.codecName).c_str(), config.name.c_str(),
+                   info.hardware ? av_hwdevice_get_type_name(info.deviceType) : "software", info.threadCount,
+                   info.threadType & FF_THREAD_FRAME ? "frame" : (info.threadType & FF_THREAD_SLICE ? "slice" : "none"),
+                   (long long)stats.frames, wallSec, stats.frames / wallSec, cpuSec * 1000 / frames, peakRssMb(),
+                   stats.transferSec * 1000 / frames, info.hardware ? "" : jsonEscape(info.fallbackReason).c_str());
+            fflush(stdout);
+            first = false;
+        }
+    }
+    printf("\n]\n");
+}
@@ -0,0 +1,85 @@
+#include "bench.h"
+#include "decoderBackend.h"
+#include "frameSink.h"
+#include <chrono>
+#include <filesystem>
+#include <stdio.h>
+
+extern "C" {
+#include <libavutil/common.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+using Clock = std::chrono::steady_clock;
+
+// 原来saveNV12()的写法 : 解码线程上每行一次fwrite
+static int64_t writeRows(FILE *file, const AVFrame *frame) {
+    AVPixelFormat format = (AVPixelFormat)frame->format;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    int64_t bytes = 0;
+    for(int plane = 0; plane < av_pix_fmt_count_planes(format); ++plane) {
+        int rowBytes = av_image_get_linesize(format, frame->width, plane);
+        int rows = (plane == 1 || plane == 2) ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+        for(int row = 0; row < rows; ++row) {
+            bytes += fwrite(frame->data[plane] + (ptrdiff_t)row * frame->linesize[plane], 1, rowBytes, file);
+        }
+    }
+    return bytes;
+}
+
+void runDumpBench(const std::vector<std::string> &corpus) {
+    std::string dir = (std::filesystem::temp_directory_path() / "dump_bench").string();
+    std::filesystem::create_directories(dir);
+
+    printf("%-32s %-8s %8s %10s %10s %10s %12s\n", "file", "writer", "frames", "MB", "total s", "MB/s", "decode wait s");
+    for(auto &url : corpus) {
+        for(bool async : {false, true}) {
+            DecoderOptions options;
+            options.hwPriority.clear();
+            VideoDecoder decoder;
+            if(!decoder.open(url, options)) {
+                fprintf(stderr, "open %s failed\n", url.c_str());
+                break;
+            }
+
+            std::string path = dir + (async ? "/async.yuv" : "/rows.yuv");
+            FILE *file = async ? nullptr : fopen(path.c_str(), "wb");
+            FrameSink sink;
+            if(async ? !sink.open(path) : file == nullptr) {
+                fprintf(stderr, "open %s failed\n", path.c_str());
+                break;
+            }
+
+            // 解码线程花在保存上的时间 : 同步写是fwrite的时间，异步写是等待队列的时间
+            auto begin = Clock::now();
+            double waitSec = 0;
+            int64_t frames = 0, bytes = 0;
+            AVFrame *frame = av_frame_alloc();
+            while(decoder.receiveFrame(frame) >= 0) {
+                if(async) {
+                    sink.write(frame);
+                } else {
+                    auto writeBegin = Clock::now();
+                    bytes += writeRows(file, frame);
+                    waitSec += std::chrono::duration<double>(Clock::now() - writeBegin).count();
+                }
+                ++frames;
+                av_frame_unref(frame);
+            }
+            av_frame_free(&frame);
+            if(async) {
+                sink.close();
+                bytes = sink.stats().bytes;
+                waitSec = sink.stats().stallSec;
+            } else {
+                fclose(file);
+            }
+            double totalSec = std::chrono::duration<double>(Clock::now() - begin).count();
+            double mb = bytes / (1024.0 * 1024.0);
+            printf("%-32s %-8s %8lld %10.1f %10.3f %10.1f %12.3f\n", url.c_str(), async ? "async" : "rows",
+                   (long long)frames, mb, totalSec, mb / totalSec, waitSec);
+            std::filesystem::remove(path);
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#include "bench.h"
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include <libavutil/log.h>
+}
+
+// 用法 : ./8_HWDecode_bench <decode|pool|thumbnail|sample|dump|seek> file1 file2 ...
+//   decode    : 软解单线程、帧多线程、slice多线程和每种硬解的吞吐，JSON输出到stdout
+//   pool      : 大量短文件的启动耗时，每次新建解码器和使用解码器池的对比
+//   thumbnail : 只解关键帧的缩略图和完整解码的耗时对比
+//   sample    : 按不同的分析帧率稀疏采样，每返回一帧解码的帧数
+//   dump      : 保存所有解码帧时，每行一次fwrite和异步写线程的对比
+//   seek      : 精确到帧的随机访问，随机、向前、向后三种方式的延迟
+// 不传文件时使用 ../res/big_buck_bunny.mp4
+int main(int argc, char *argv[]) {
+    if(argc < 2 || (strcmp(argv[1], "decode") != 0 && strcmp(argv[1], "pool") != 0 && strcmp(argv[1], "thumbnail") != 0
+                    && strcmp(argv[1], "sample") != 0 && strcmp(argv[1], "dump") != 0
+                    && strcmp(argv[1], "seek") != 0)) {
+        fprintf(stderr, "usage : %s <decode|pool|thumbnail|sample|dump|seek> file1 file2 ...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> corpus;
+    for(int i = 2; i < argc; ++i) {
+        corpus.push_back(argv[i]);
+    }
+    if(corpus.empty()) {
+        corpus.push_back("../res/big_buck_bunny.mp4");
+    }
+
+    // 统计期间关闭FFmpeg的日志输出，只保留错误
+    av_log_set_level(AV_LOG_ERROR);
+
+    if(strcmp(argv[1], "decode") == 0) {
+        runDecodeBench(corpus);
+    } else if(strcmp(argv[1], "pool") == 0) {
+        runPoolBench(corpus);
+    } else if(strcmp(argv[1], "thumbnail") == 0) {
+        runThumbnailBench(corpus);
+    } else if(strcmp(argv[1], "sample") == 0) {
+        runSampleBench(corpus);
+    } else if(strcmp(argv[1], "dump") == 0) {
+        runDumpBench(corpus);
+    } else {
+        runSeekBench(corpus);
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "bench.h"
+#include "decoderBackend.h"
+#include "decoderPool.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+// 解出第一帧，返回是否成功
+static bool decodeFirstFrame(AVFormatContext *fmtCtx, int streamIndex, AVCodecContext *codecCtx,
+                             AVPacket *packet, AVFrame *frame) {
+    while(true) {
+        int ret = avcodec_receive_frame(codecCtx, frame);
+        if(ret >= 0) {
+            av_frame_unref(frame);
+            return true;
+        } else if(ret != AVERROR(EAGAIN)) {
+            return false;
+        }
+        ret = av_read_frame(fmtCtx, packet);
+        if(ret < 0) {
+            avcodec_send_packet(codecCtx, NULL);
+            continue;
+        }
+        if(packet->stream_index == streamIndex) {
+            ret = avcodec_send_packet(codecCtx, packet);
+        }
+        av_packet_unref(packet);
+        if(ret < 0 && ret != AVERROR(EAGAIN)) {
+            return false;
+        }
+    }
+}
+
+// 和hwdecode()一样每个文件都创建设备和解码器
+static AVCodecContext *openFreshDecoder(const AVStream *strm, AVHWDeviceType deviceType) {
+    const AVCodec *codec = avcodec_find_decoder(strm->codecpar->codec_id);
+    AVCodecContext *codecCtx = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if(codecCtx == nullptr || avcodec_parameters_to_context(codecCtx, strm->codecpar) < 0) {
+        avcodec_free_context(&codecCtx);
+        return nullptr;
+    }
+    codecCtx->pkt_timebase = strm->time_base;
+    if(deviceType != AV_HWDEVICE_TYPE_NONE) {
+        if(av_hwdevice_ctx_create(&codecCtx->hw_device_ctx, deviceType, NULL, NULL, 0) < 0) {
+            avcodec_free_context(&codecCtx);
+            return nullptr;
+        }
+        codecCtx->thread_count = 1;
+    } else {
+        codecCtx->thread_count = 0;
+        codecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    }
+    if(avcodec_open2(codecCtx, codec, NULL) < 0) {
+        avcodec_free_context(&codecCtx);
+    }
+    return codecCtx;
+}
+
+struct StartupTimes {
+    std::vector<double> setupMs;        // 得到可用的解码器
+    std::vector<double> startupMs;      // 打开文件到解出第一帧
+};
+
+static void printRow(const char *backend, const char *mode, StartupTimes &times, const char *extra) {
+    auto mean = [](const std::vector<double> &samples) {
+        double sum = 0;
+        for(double value : samples) {
+            sum += value;
+        }
+        return samples.empty() ? 0 : sum / samples.size();
+    };
+    auto maxOf = [](const std::vector<double> &samples) {
+        return samples.empty() ? 0 : *std::max_element(samples.begin(), samples.end());
+    };
+    printf("%-14s %-8s %6zu %12.3f %12.3f %12.3f %s\n", backend, mode, times.startupMs.size(),
+           mean(times.setupMs), mean(times.startupMs), maxOf(times.startupMs), extra);
+}
+
+void runPoolBench(const std::vector<std::string> &corpus) {
+    // 文件列表重复这么多遍，模拟大量短文件
+    const int ROUNDS = 5;
+
+    std::vector<AVHWDeviceType> backends = {AV_HWDEVICE_TYPE_NONE};
+    std::vector<AVHWDeviceType> hwDevices = availableHWDevices();
+    if(!hwDevices.empty()) {
+        backends.push_back(hwDevices.front());
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+
+    printf("%-14s %-8s %6s %12s %12s %12s\n", "backend", "mode", "files", "setup ms", "startup ms", "max ms");
+    for(AVHWDeviceType deviceType : backends) {
+        const char *backend = deviceType == AV_HWDEVICE_TYPE_NONE ? "software" : av_hwdevice_get_type_name(deviceType);
+        StartupTimes fresh, pooled;
+        DecoderPoolConfig config;
+        config.deviceType = deviceType;
+        DecoderPool pool(config);
+
+        for(int round = 0; round < ROUNDS; ++round) {
+            for(auto &url : corpus) {
+                // 两种方式交替，文件缓存对两者的影响相同
+                for(bool usePool : {false, true}) {
+                    auto begin = Clock::now();
+                    AVFormatContext *fmtCtx = nullptr;
+                    if(avformat_open_input(&fmtCtx, url.c_str(), NULL, NULL) < 0 || avformat_find_stream_info(fmtCtx, NULL) < 0) {
+                        fprintf(stderr, "open %s failed\n", url.c_str());
+                        avformat_close_input(&fmtCtx);
+                        continue;
+                    }
+                    int streamIndex = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+                    if(streamIndex < 0) {
+                        avformat_close_input(&fmtCtx);
+                        continue;
+                    }
+                    AVStream *strm = fmtCtx->streams[streamIndex];
+
+                    auto setupBegin = Clock::now();
+                    AVCodecContext *codecCtx = usePool ? pool.acquire(strm->codecpar, strm->time_base)
+                                                       : openFreshDecoder(strm, deviceType);
+                    double setupMs = elapsedMs(setupBegin);
+                    bool ok = codecCtx && decodeFirstFrame(fmtCtx, streamIndex, codecCtx, packet, frame);
+                    double startupMs = elapsedMs(begin);
+
+                    if(usePool) {
+                        pool.release(codecCtx);
+                    } else {
+                        avcodec_free_context(&codecCtx);
+                    }
+                    avformat_close_input(&fmtCtx);
+                    if(!ok) {
+                        fprintf(stderr, "decode %s failed\n", url.c_str());
+                        continue;
+                    }
+                    StartupTimes &times = usePool ? pooled : fresh;
+                    times.setupMs.push_back(setupMs);
+                    times.startupMs.push_back(startupMs);
+                }
+            }
+        }
+
+        DecoderPoolStats stats = pool.stats();
+        char extra[128];
+        snprintf(extra, sizeof(extra), "reused %lld, opened %lld", (long long)stats.reused, (long long)stats.opened);
+        printRow(backend, "fresh", fresh, "");
+        printRow(backend, "pooled", pooled, extra);
+    }
+
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+}
@@ -0,0 +1,72 @@
+#include "bench.h"
+#include "decoderBackend.h"
+#include "frameSampler.h"
+#include <chrono>
+#include <stdio.h>
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+// 完整软解一遍，作为对比的基准
+static bool fullDecode(const std::string &url, double *ms, int64_t *frames) {
+    auto begin = Clock::now();
+    DecoderOptions options;
+    options.hwPriority.clear();
+    VideoDecoder decoder;
+    if(!decoder.open(url, options)) {
+        return false;
+    }
+    AVFrame *frame = av_frame_alloc();
+    while(decoder.receiveFrame(frame) >= 0) {
+        av_frame_unref(frame);
+    }
+    av_frame_free(&frame);
+    *frames = decoder.stats().frames;
+    *ms = elapsedMs(begin);
+    return true;
+}
+
+void runSampleBench(const std::vector<std::string> &corpus) {
+    const double RATES[] = {0.5, 2, 5};
+
+    printf("%-32s %8s %8s %10s %10s %12s %8s %10s\n", "file", "fps", "skip", "returned", "decoded", "dec/ret", "seeks", "ms");
+    for(auto &url : corpus) {
+        double fullMs = 0;
+        int64_t fullFrames = 0;
+        if(!fullDecode(url, &fullMs, &fullFrames)) {
+            fprintf(stderr, "open %s failed\n", url.c_str());
+            continue;
+        }
+        printf("%-32s %8s %8s %10lld %10lld %12.2f %8d %10.1f\n", url.c_str(), "all", "-",
+               (long long)fullFrames, (long long)fullFrames, 1.0, 0, fullMs);
+
+        for(double rate : RATES) {
+            for(bool skipNonRef : {false, true}) {
+                SamplerOptions options;
+                options.skipNonRef = skipNonRef;
+                FrameSampler sampler;
+                if(!sampler.open(url, options)) {
+                    continue;
+                }
+                auto begin = Clock::now();
+                AVFrame *frame = av_frame_alloc();
+                for(double seconds : sampler.sampleTimes(rate)) {
+                    if(sampler.frameAt(seconds, frame) < 0) {
+                        break;
+                    }
+                    av_frame_unref(frame);
+                }
+                av_frame_free(&frame);
+                double ms = elapsedMs(begin);
+
+                const SamplerStats &stats = sampler.stats();
+                printf("%-32s %8.1f %8s %10lld %10lld %12.2f %8lld %10.1f\n", url.c_str(), rate, skipNonRef ? "nonref" : "none",
+                       (long long)stats.returned, (long long)stats.decoded,
+                       stats.returned > 0 ? (double)stats.decoded / stats.returned : 0, (long long)stats.seeks, ms);
+            }
+        }
+    }
+}
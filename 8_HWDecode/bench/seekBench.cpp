@@ -0,0 +1,71 @@
+#include "bench.h"
+#include "frameReader.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+
+static double percentile(const std::vector<double> &sorted, double p) {
+    if(sorted.empty()) {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, (size_t)(p / 100 * sorted.size()));
+    return sorted[index];
+}
+
+void runSeekBench(const std::vector<std::string> &corpus) {
+    // 每种访问方式的请求数
+    const int REQUESTS = 200;
+
+    printf("%-32s %-9s %9s %9s %9s %9s %7s %7s %9s\n", "file", "pattern", "mean ms", "p50 ms", "p99 ms", "max ms",
+           "hits", "seeks", "decoded");
+    for(auto &url : corpus) {
+        for(const char *pattern : {"random", "forward", "backward"}) {
+            FrameReader reader;
+            if(!reader.open(url)) {
+                fprintf(stderr, "open %s failed\n", url.c_str());
+                break;
+            }
+            int64_t step = std::max<int64_t>(1, reader.frameDuration());
+            int64_t length = (int64_t)(reader.duration() / av_q2d(reader.timeBase()));
+
+            // 请求的pts : 随机分布、从1/3处逐帧向前、从2/3处逐帧向后
+            std::vector<int64_t> targets;
+            std::mt19937_64 random(1);
+            for(int i = 0; i < REQUESTS; ++i) {
+                int64_t offset = 0;
+                if(pattern[0] == 'r') {
+                    offset = length > 0 ? (int64_t)(random() % length) : 0;
+                } else if(pattern[0] == 'f') {
+                    offset = length / 3 + i * step;
+                } else {
+                    offset = std::max<int64_t>(0, length * 2 / 3 - i * step);
+                }
+                targets.push_back(reader.startTime() + offset);
+            }
+
+            std::vector<double> latencies;
+            AVFrame *frame = av_frame_alloc();
+            for(int64_t pts : targets) {
+                auto begin = std::chrono::steady_clock::now();
+                int ret = reader.frameAtPts(pts, frame);
+                latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+                if(ret < 0) {
+                    fprintf(stderr, "frame at %lld failed\n", (long long)pts);
+                }
+                av_frame_unref(frame);
+            }
+            av_frame_free(&frame);
+
+            double sum = 0;
+            for(double value : latencies) {
+                sum += value;
+            }
+            std::sort(latencies.begin(), latencies.end());
+            const FrameReaderStats &stats = reader.stats();
+            printf("%-32s %-9s %9.3f %9.3f %9.3f %9.3f %7lld %7lld %9lld\n", url.c_str(), pattern,
+                   sum / latencies.size(), percentile(latencies, 50), percentile(latencies, 99), latencies.back(),
+                   (long long)stats.cacheHits, (long long)stats.seeks, (long long)stats.decoded);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#include "bench.h"
+#include "decoderBackend.h"
+#include "thumbnail.h"
+#include <chrono>
+#include <filesystem>
+#include <stdio.h>
+
+// 完整软解一遍，作为对比的基准
+static double fullDecodeMs(const std::string &url, int64_t *frames) {
+    auto begin = std::chrono::steady_clock::now();
+    DecoderOptions options;
+    options.hwPriority.clear();
+    VideoDecoder decoder;
+    if(!decoder.open(url, options)) {
+        return -1;
+    }
+    AVFrame *frame = av_frame_alloc();
+    while(decoder.receiveFrame(frame) >= 0) {
+        av_frame_unref(frame);
+    }
+    av_frame_free(&frame);
+    *frames = decoder.stats().frames;
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void runThumbnailBench(const std::vector<std::string> &corpus) {
+    ThumbnailOptions options;
+    options.outDir = (std::filesystem::temp_directory_path() / "thumbnail_bench").string();
+    std::filesystem::create_directories(options.outDir);
+
+    printf("%-32s %8s %10s %12s %10s %12s %8s\n", "file", "thumbs", "decoded", "thumb ms", "frames", "full ms", "speedup");
+    DecoderPoolConfig config;
+    config.threadCount = 1;
+    DecoderPool pool(config);
+    for(auto &url : corpus) {
+        ThumbnailResult result;
+        if(!extractThumbnails(url, options, pool, &result)) {
+            fprintf(stderr, "thumbnail %s failed\n", url.c_str());
+            continue;
+        }
+        int64_t frames = 0;
+        double fullMs = fullDecodeMs(url, &frames);
+        printf("%-32s %8d %10d %12.1f %10lld %12.1f %7.1fx\n", url.c_str(), result.thumbnails, result.decodedFrames,
+               result.elapsedMs, (long long)frames, fullMs, fullMs / result.elapsedMs);
+    }
+
+    // 文件列表重复多遍，测并行时每个文件的平均耗时
+    const int ROUNDS = 8;
+    std::vector<std::string> batch;
+    for(int i = 0; i < ROUNDS; ++i) {
+        batch.insert(batch.end(), corpus.begin(), corpus.end());
+    }
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<ThumbnailResult> results = extractThumbnails(batch, options);
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    int failed = 0;
+    for(auto &result : results) {
+        failed += result.ok ? 0 : 1;
+    }
+    printf("parallel : %zu files in %.1f ms, %.2f ms per file, %d failed\n", batch.size(), elapsedMs,
+           elapsedMs / batch.size(), failed);
+}
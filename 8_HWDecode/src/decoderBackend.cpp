@@ -0,0 +1,292 @@
+#include "decoderBackend.h"
+#include <chrono>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<AVHWDeviceType> defaultHWDecodePriority() {
+    return {
+        AV_HWDEVICE_TYPE_VIDEOTOOLBOX,  // macOS
+        AV_HWDEVICE_TYPE_CUDA,          // NVIDIA
+        AV_HWDEVICE_TYPE_VAAPI,         // Linux上的Intel/AMD
+        AV_HWDEVICE_TYPE_QSV,
+        AV_HWDEVICE_TYPE_D3D11VA,       // Windows
+        AV_HWDEVICE_TYPE_DXVA2,
+        AV_HWDEVICE_TYPE_VDPAU,
+    };
+}
+
+VideoDecoder::~VideoDecoder() {
+    close();
+}
+
+bool VideoDecoder::open(const std::string &url, const DecoderOptions &options) {
+    close();
+    options_ = options;
+
+    if(avformat_open_input(&fmtCtx_, url.c_str(), NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open input format failed\n");
+        return false;
+    }
+    if(avformat_find_stream_info(fmtCtx_, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info failed\n");
+        close();
+        return false;
+    }
+    streamIndex_ = av_find_best_stream(fmtCtx_, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if(streamIndex_ < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find video stream error\n");
+        close();
+        return false;
+    }
+    codec_ = avcodec_find_decoder(fmtCtx_->streams[streamIndex_]->codecpar->codec_id);
+    if(codec_ == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Find Codec error\n");
+        close();
+        return false;
+    }
+
+    packet_ = av_packet_alloc();
+    hwFrame_ = av_frame_alloc();
+    if(packet_ == nullptr || hwFrame_ == nullptr || !openCodec(!options_.hwPriority.empty())) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void VideoDecoder::close() {
+    avcodec_free_context(&codecCtx_);
+    avformat_close_input(&fmtCtx_);
+    av_packet_free(&packet_);
+    av_frame_free(&hwFrame_);
+    codec_ = nullptr;
+    streamIndex_ = -1;
+    hwRejected_ = false;
+    inputEof_ = false;
+    info_ = DecoderBackendInfo();
+    stats_ = DecoderStats();
+}
+
+// 按优先级找解码器支持、并且能创建出设备的硬件配置
+bool VideoDecoder::setupHardware() {
+    for(AVHWDeviceType deviceType : options_.hwPriority) {
+        const AVCodecHWConfig *hwConfig = nullptr;
+        for(int i = 0; (hwConfig = avcodec_get_hw_config(codec_, i)) != nullptr; ++i) {
+            if(hwConfig->device_type == deviceType && (hwConfig->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)) {
+                break;
+            }
+        }
+        if(hwConfig == nullptr) {
+            continue;
+        }
+
+        if(av_hwdevice_ctx_create(&codecCtx_->hw_device_ctx, deviceType, NULL, NULL, 0) < 0) {
+            av_log(NULL, AV_LOG_WARNING, "Create hw device %s failed\n", av_hwdevice_get_type_name(deviceType));
+            info_.fallbackReason = std::string("cannot create ") + av_hwdevice_get_type_name(deviceType) + " device";
+            continue;
+        }
+
+        info_.hardware = true;
+        info_.deviceType = deviceType;
+        info_.hwFormat = hwConfig->pix_fmt;
+        info_.fallbackReason.clear();
+        // get_format回调中确认硬件能否解这个流，设置了get_format后硬件帧的上下文由libavcodec按hw_device_ctx创建
+        codecCtx_->opaque = this;
+        codecCtx_->get_format = negotiateFormat;
+        return true;
+    }
+    if(info_.fallbackReason.empty()) {
+        info_.fallbackReason = "no usable hw config";
+    }
+    return false;
+}
+
+bool VideoDecoder::openCodec(bool tryHardware) {
+    avcodec_free_context(&codecCtx_);
+    codecCtx_ = avcodec_alloc_context3(codec_);
+    if(codecCtx_ == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot alloc Codec context\n");
+        return false;
+    }
+    AVStream *strm = fmtCtx_->streams[streamIndex_];
+    if(avcodec_parameters_to_context(codecCtx_, strm->codecpar) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Fill Codec context failed\n");
+        return false;
+    }
+    codecCtx_->pkt_timebase = strm->time_base;
+
+    std::string fallbackReason = info_.fallbackReason;
+    info_ = DecoderBackendInfo();
+    info_.codecName = codec_->name;
+    info_.fallbackReason = fallbackReason;
+    hwRejected_ = false;
+
+    if(tryHardware && setupHardware()) {
+        // 硬解时帧多线程只会多占surface，增加延迟
+        codecCtx_->thread_count = 1;
+    } else {
+        codecCtx_->thread_count = options_.threadCount;
+        codecCtx_->thread_type = options_.threadType;
+    }
+
+    if(avcodec_open2(codecCtx_, codec_, NULL) < 0) {
+        if(info_.hardware) {
+            av_log(NULL, AV_LOG_WARNING, "Open hw decoder failed, fall back to software\n");
+            info_.fallbackReason = "open hw decoder failed";
+            return openCodec(false);
+        }
+        av_log(NULL, AV_LOG_ERROR, "Cannot open codec.\n");
+        return false;
+    }
+    info_.threadCount = codecCtx_->thread_count;
+    info_.threadType = codecCtx_->active_thread_type;
+    return true;
+}
+
+// 解码器解析出序列头后调用，formats中前面是硬件格式，后面是软件格式
+AVPixelFormat VideoDecoder::negotiateFormat(AVCodecContext *s, const AVPixelFormat *formats) {
+    VideoDecoder *self = static_cast<VideoDecoder *>(s->opaque);
+
+    bool offered = false;
+    for(const AVPixelFormat *p = formats; *p != AV_PIX_FMT_NONE; ++p) {
+        offered = offered || *p == self->info_.hwFormat;
+    }
+
+    std::string reason;
+    if(!offered) {
+        // 一般是硬件不支持的profile或者位深
+        reason = std::string("hw format not offered for ") + (av_get_pix_fmt_name(s->sw_pix_fmt) ? av_get_pix_fmt_name(s->sw_pix_fmt) : "unknown");
+    } else {
+        AVHWFramesConstraints *constraints = av_hwdevice_get_hwframe_constraints(s->hw_device_ctx, NULL);
+        if(constraints && (s->coded_width < constraints->min_width || s->coded_width > constraints->max_width
+                           || s->coded_height < constraints->min_height || s->coded_height > constraints->max_height)) {
+            reason = "size " + std::to_string(s->coded_width) + "x" + std::to_string(s->coded_height) + " not supported by hw";
+        }
+        av_hwframe_constraints_free(&constraints);
+    }
+    if(reason.empty()) {
+        return self->info_.hwFormat;
+    }
+
+    // 先用列表中的软件格式继续，receiveFrame()中会换成帧多线程的软解重新打开
+    av_log(NULL, AV_LOG_WARNING, "hw decode rejected : %s\n", reason.c_str());
+    self->hwRejected_ = true;
+    self->info_.fallbackReason = reason;
+    for(const AVPixelFormat *p = formats; *p != AV_PIX_FMT_NONE; ++p) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(*p);
+        if(desc && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+            return *p;
+        }
+    }
+    return AV_PIX_FMT_NONE;
+}
+
+int VideoDecoder::transferToCpu(AVFrame *frame) {
+    auto begin = Clock::now();
+    // frame的format为NONE，使用硬件支持拷贝出来的第一种格式，如videotoolbox是nv12
+    int ret = av_hwframe_transfer_data(frame, hwFrame_, 0);
+    if(ret >= 0) {
+        ret = av_frame_copy_props(frame, hwFrame_);
+    }
+    av_frame_unref(hwFrame_);
+    stats_.transferSec += std::chrono::duration<double>(Clock::now() - begin).count();
+    if(ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "transfer to cpu failed\n");
+        av_frame_unref(frame);
+    }
+    return ret;
+}
+
+int VideoDecoder::receiveFrame(AVFrame *frame) {
+    if(codecCtx_ == nullptr) {
+        return AVERROR(EINVAL);
+    }
+
+    auto begin = Clock::now();
+    int ret = 0;
+    while(true) {
+        bool download = info_.hardware && options_.cpuFrames;
+        ret = avcodec_receive_frame(codecCtx_, download ? hwFrame_ : frame);
+        if(ret >= 0) {
+            // get_format放弃硬件格式后出来的已经是软件帧
+            if(download && hwFrame_->hw_frames_ctx == nullptr) {
+                av_frame_move_ref(frame, hwFrame_);
+            } else if(download) {
+                ret = transferToCpu(frame);
+            }
+            if(ret >= 0) {
+                ++stats_.frames;
+            }
+            break;
+        } else if(ret != AVERROR(EAGAIN)) {
+            break;
+        }
+
+        // 解码器需要更多输入
+        if(inputEof_) {
+            ret = AVERROR_EOF;
+            break;
+        }
+        ret = av_read_frame(fmtCtx_, packet_);
+        if(ret < 0) {
+            inputEof_ = true;
+            avcodec_send_packet(codecCtx_, NULL);
+            continue;
+        }
+        if(packet_->stream_index != streamIndex_) {
+            av_packet_unref(packet_);
+            continue;
+        }
+
+        ret = avcodec_send_packet(codecCtx_, packet_);
+        if(hwRejected_ && info_.hardware) {
+            // 硬件不支持这个流，换成帧多线程的软解，重新送入这个packet
+            // get_format一般在第一个关键帧时调用；如果是中途(分辨率变化)，到下一个关键帧前的帧会解码出错
+            if(stats_.frames > 0) {
+                av_log(NULL, AV_LOG_WARNING, "hw decode rejected after %lld frames, reopen as software\n", (long long)stats_.frames);
+            }
+            if(!openCodec(false)) {
+                av_packet_unref(packet_);
+                break;
+            }
+            ret = avcodec_send_packet(codecCtx_, packet_);
+        }
+        av_packet_unref(packet_);
+        if(ret < 0 && ret != AVERROR(EAGAIN)) {
+            av_log(NULL, AV_LOG_ERROR, "Error when decode send packet.\n");
+            break;
+        }
+    }
+    stats_.decodeSec += std::chrono::duration<double>(Clock::now() - begin).count();
+    return ret;
+}
+
+int VideoDecoder::seek(int64_t timestamp) {
+    if(codecCtx_ == nullptr) {
+        return AVERROR(EINVAL);
+    }
+    int ret = av_seek_frame(fmtCtx_, streamIndex_, timestamp, AVSEEK_FLAG_BACKWARD);
+    if(ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "seek to %lld failed\n", (long long)timestamp);
+        return ret;
+    }
+    avcodec_flush_buffers(codecCtx_);
+    inputEof_ = false;
+    return 0;
+}
+
+void VideoDecoder::logReport() const {
+    const char *backend = info_.hardware ? av_hwdevice_get_type_name(info_.deviceType) : "software";
+    double fps = stats_.decodeSec > 0 ? stats_.frames / stats_.decodeSec : 0;
+    av_log(NULL, AV_LOG_INFO, "decoder %s (%s, %d threads%s) : %lld frames in %.3fs, %.1f fps, transfer %.3fs\n",
+           info_.codecName.c_str(), backend, info_.threadCount,
+           info_.threadType & FF_THREAD_FRAME ? ", frame threads" : (info_.threadType & FF_THREAD_SLICE ? ", slice threads" : ""),
+           (long long)stats_.frames, stats_.decodeSec, fps, stats_.transferSec);
+    if(!info_.hardware && !info_.fallbackReason.empty()) {
+        av_log(NULL, AV_LOG_INFO, "  hw decode not used : %s\n", info_.fallbackReason.c_str());
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
+}
+
+// 默认的硬解优先级，当前平台上编译进来且能创建设备的第一个会被使用
+std::vector<AVHWDeviceType> defaultHWDecodePriority();
+
+struct DecoderOptions {
+    std::vector<AVHWDeviceType> hwPriority = defaultHWDecodePriority();    // 为空表示只用软解
+    bool cpuFrames = true;              // 硬件帧先拷贝回内存再返回，调用方不用区分后端
+    int threadCount = 0;                // 软解的线程数，0表示按核数
+    int threadType = FF_THREAD_FRAME | FF_THREAD_SLICE; // 软解允许的多线程方式
+};
+
+struct DecoderBackendInfo {
+    std::string codecName;
+    bool hardware = false;
+    AVHWDeviceType deviceType = AV_HWDEVICE_TYPE_NONE;
+    AVPixelFormat hwFormat = AV_PIX_FMT_NONE;
+    int threadCount = 1;
+    int threadType = 0;                 // 实际使用的FF_THREAD_FRAME/FF_THREAD_SLICE
+    std::string fallbackReason;         // 没有用上硬解的原因
+};
+
+struct DecoderStats {
+    int64_t frames = 0;
+    double decodeSec = 0;               // receiveFrame()内的总耗时，包括读packet和拷贝
+    double transferSec = 0;             // 其中硬件帧拷贝回内存的耗时
+};
+
+// 统一的解码接口 : 按优先级尝试硬解，设备创建失败，或者get_format时发现硬件不支持这个流
+// (profile、位深、分辨率)，回退到帧多线程的软解；调用方拿到的帧和后端无关
+class VideoDecoder {
+public:
+    VideoDecoder() = default;
+    ~VideoDecoder();
+    VideoDecoder(const VideoDecoder &) = delete;
+    VideoDecoder &operator=(const VideoDecoder &) = delete;
+
+    // 打开url中最好的视频流
+    bool open(const std::string &url, const DecoderOptions &options = DecoderOptions());
+    void close();
+
+    // 取下一帧，frame需要是空的；返回0成功，AVERROR_EOF表示解码结束
+    int receiveFrame(AVFrame *frame);
+    // seek到timestamp(流的时间基)前面最近的关键帧，清空解码器，之后receiveFrame()从那里开始
+    int seek(int64_t timestamp);
+
+    const DecoderBackendInfo &info() const { return info_; }
+    const DecoderStats &stats() const { return stats_; }
+    // 打印使用的后端和速度
+    void logReport() const;
+
+    AVFormatContext *formatContext() const { return fmtCtx_; }
+    AVCodecContext *codecContext() const { return codecCtx_; }
+    int streamIndex() const { return streamIndex_; }
+
+private:
+    bool openCodec(bool tryHardware);
+    bool setupHardware();
+    int transferToCpu(AVFrame *frame);
+    static AVPixelFormat negotiateFormat(AVCodecContext *s, const AVPixelFormat *formats);
+
+    DecoderOptions options_;
+    DecoderBackendInfo info_;
+    DecoderStats stats_;
+    AVFormatContext *fmtCtx_ = nullptr;
+    AVCodecContext *codecCtx_ = nullptr;
+    const AVCodec *codec_ = nullptr;
+    int streamIndex_ = -1;
+    AVPacket *packet_ = nullptr;
+    AVFrame *hwFrame_ = nullptr;
+    bool hwRejected_ = false;           // get_format时放弃了硬件格式
+    bool inputEof_ = false;
+};
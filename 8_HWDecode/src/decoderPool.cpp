@@ -0,0 +1,149 @@
+#include "decoderPool.h"
+#include <chrono>
+#include <cstring>
+
+DecoderPool::DecoderPool(const DecoderPoolConfig &config) : config_(config) {
+}
+
+DecoderPool::~DecoderPool() {
+    for(auto &item : idle_) {
+        for(auto &entry : item.second) {
+            avcodec_free_context(&entry.codecCtx);
+        }
+    }
+    // 还没还回来的解码器也在这里释放，调用方不应再使用
+    for(auto &item : busy_) {
+        AVCodecContext *codecCtx = item.first;
+        avcodec_free_context(&codecCtx);
+    }
+    av_buffer_unref(&hwDeviceCtx_);
+}
+
+DecoderPool::Key DecoderPool::makeKey(const AVCodecParameters *par) {
+    return Key(par->codec_id, par->format, par->profile);
+}
+
+bool DecoderPool::matches(const Entry &entry, const AVCodecParameters *par) {
+    return entry.width == par->width && entry.height == par->height
+           && (int)entry.extradata.size() == par->extradata_size
+           && (par->extradata_size == 0 || memcmp(entry.extradata.data(), par->extradata, par->extradata_size) == 0);
+}
+
+AVCodecContext *DecoderPool::openDecoder(const AVCodecParameters *par, AVRational pktTimeBase) {
+    const AVCodec *codec = avcodec_find_decoder(par->codec_id);
+    if(codec == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Find Codec error\n");
+        return nullptr;
+    }
+    AVCodecContext *codecCtx = avcodec_alloc_context3(codec);
+    if(codecCtx == nullptr || avcodec_parameters_to_context(codecCtx, par) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Fill Codec context failed\n");
+        avcodec_free_context(&codecCtx);
+        return nullptr;
+    }
+    codecCtx->pkt_timebase = pktTimeBase;
+
+    // 硬件设备只创建一次，之后每个解码器引用同一个
+    if(config_.deviceType != AV_HWDEVICE_TYPE_NONE && hwDeviceCtx_ == nullptr && !hwDeviceFailed_) {
+        if(av_hwdevice_ctx_create(&hwDeviceCtx_, config_.deviceType, NULL, NULL, 0) < 0) {
+            av_log(NULL, AV_LOG_WARNING, "Create hw device %s failed, use software decode\n",
+                   av_hwdevice_get_type_name(config_.deviceType));
+            hwDeviceFailed_ = true;
+        }
+    }
+    if(hwDeviceCtx_) {
+        // 没有设置get_format时，默认的实现会按hw_device_ctx选择硬件格式，不支持时用软件格式
+        codecCtx->hw_device_ctx = av_buffer_ref(hwDeviceCtx_);
+        codecCtx->thread_count = 1;
+    } else {
+        codecCtx->thread_count = config_.threadCount;
+        codecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    }
+
+    if(avcodec_open2(codecCtx, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open codec.\n");
+        avcodec_free_context(&codecCtx);
+        return nullptr;
+    }
+    return codecCtx;
+}
+
+AVCodecContext *DecoderPool::acquire(const AVCodecParameters *par, AVRational pktTimeBase) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++stats_.acquires;
+
+    auto found = idle_.find(makeKey(par));
+    if(found != idle_.end()) {
+        auto &entries = found->second;
+        for(auto it = entries.begin(); it != entries.end(); ++it) {
+            if(matches(*it, par)) {
+                Entry entry = std::move(*it);
+                entries.erase(it);
+                AVCodecContext *codecCtx = entry.codecCtx;
+                codecCtx->pkt_timebase = pktTimeBase;
+                busy_[codecCtx] = std::move(entry);
+                ++stats_.reused;
+                return codecCtx;
+            }
+        }
+    }
+
+    // 打开解码器比较慢，不占着锁；硬件设备的创建仍在锁内，保证只创建一次
+    bool needDevice = config_.deviceType != AV_HWDEVICE_TYPE_NONE && hwDeviceCtx_ == nullptr && !hwDeviceFailed_;
+    if(!needDevice) {
+        lock.unlock();
+    }
+    auto begin = std::chrono::steady_clock::now();
+    AVCodecContext *codecCtx = openDecoder(par, pktTimeBase);
+    double openSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    if(!needDevice) {
+        lock.lock();
+    }
+    if(codecCtx == nullptr) {
+        return nullptr;
+    }
+
+    Entry entry;
+    entry.key = makeKey(par);
+    entry.codecCtx = codecCtx;
+    entry.width = par->width;
+    entry.height = par->height;
+    entry.extradata.assign(par->extradata, par->extradata + par->extradata_size);
+    busy_[codecCtx] = std::move(entry);
+    ++stats_.opened;
+    stats_.openSec += openSec;
+    return codecCtx;
+}
+
+void DecoderPool::release(AVCodecContext *codecCtx) {
+    if(codecCtx == nullptr) {
+        return;
+    }
+    // 清空参考帧和内部缓存的帧，解码到结尾(送过NULL)之后也可以继续送packet
+    avcodec_flush_buffers(codecCtx);
+    // 调用方可能只解关键帧，恢复成默认，下一个使用者不受影响
+    codecCtx->skip_frame = AVDISCARD_DEFAULT;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = busy_.find(codecCtx);
+    if(found == busy_.end()) {
+        avcodec_free_context(&codecCtx);
+        return;
+    }
+    Entry entry = std::move(found->second);
+    busy_.erase(found);
+
+    // 按打开时的参数分组，而不是解码过程中可能被改掉的codecCtx的字段
+    auto &entries = idle_[entry.key];
+    entries.push_front(std::move(entry));
+    while((int)entries.size() > config_.maxIdlePerKey) {
+        avcodec_free_context(&entries.back().codecCtx);
+        entries.pop_back();
+        ++stats_.evicted;
+    }
+}
+
+DecoderPoolStats DecoderPool::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
+}
+
+struct DecoderPoolConfig {
+    AVHWDeviceType deviceType = AV_HWDEVICE_TYPE_NONE;  // NONE表示软解；硬解时所有解码器共享一个设备
+    int threadCount = 0;                // 软解的线程数，0表示按核数
+    int maxIdlePerKey = 4;              // 每种解码器最多保留的空闲个数，超出时释放最久没用的
+};
+
+struct DecoderPoolStats {
+    int64_t acquires = 0;
+    int64_t reused = 0;                 // 参数一致，flush之后直接复用
+    int64_t opened = 0;                 // 没有可用的空闲解码器，新打开
+    int64_t evicted = 0;
+    double openSec = 0;                 // 新打开解码器的总耗时
+};
+
+// 预热的解码器池，解码大量短文件时省掉每个文件的
+// avcodec_alloc_context3/avcodec_parameters_to_context/avcodec_open2和硬件设备的创建
+//   按codec id、像素格式、profile分组；组内宽高和extradata都一致的解码器flush后直接复用，
+//   不一致时打开新的。线程安全，可以在多个线程中同时使用
+class DecoderPool {
+public:
+    explicit DecoderPool(const DecoderPoolConfig &config = DecoderPoolConfig());
+    ~DecoderPool();
+    DecoderPool(const DecoderPool &) = delete;
+    DecoderPool &operator=(const DecoderPool &) = delete;
+
+    // 取一个可以解码par的解码器，失败返回nullptr
+    AVCodecContext *acquire(const AVCodecParameters *par, AVRational pktTimeBase);
+    // 用完还回池中，会清空解码器内部的状态
+    void release(AVCodecContext *codecCtx);
+
+    DecoderPoolStats stats();
+
+private:
+    using Key = std::tuple<AVCodecID, int, int>;    // codec id, 像素格式, profile
+
+    struct Entry {
+        Key key;
+        AVCodecContext *codecCtx = nullptr;
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> extradata;
+    };
+
+    static Key makeKey(const AVCodecParameters *par);
+    static bool matches(const Entry &entry, const AVCodecParameters *par);
+    AVCodecContext *openDecoder(const AVCodecParameters *par, AVRational pktTimeBase);
+
+    DecoderPoolConfig config_;
+    AVBufferRef *hwDeviceCtx_ = nullptr;
+    bool hwDeviceFailed_ = false;
+    std::map<Key, std::list<Entry>> idle_;                  // 最近还回来的在前面
+    std::map<AVCodecContext *, Entry> busy_;
+    DecoderPoolStats stats_;
+    std::mutex mutex_;
+};
@@ -0,0 +1,235 @@
+#include "frameReader.h"
+#include <cmath>
+
+// 没有索引时，距离超过这么多秒就seek，不再向前解码
+static const double MAX_FORWARD_SEC = 2.0;
+// 从关键帧解出的第一帧已经超过目标时(如open GOP)，每次再往前多seek这么多秒
+static const int MAX_SEEK_RETRY = 3;
+
+static int64_t frameBytes(const AVFrame *frame) {
+    int64_t bytes = 0;
+    for(int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; ++i) {
+        bytes += frame->buf[i]->size;
+    }
+    for(int i = 0; i < frame->nb_extended_buf; ++i) {
+        bytes += frame->extended_buf[i]->size;
+    }
+    return bytes;
+}
+
+FrameReader::~FrameReader() {
+    close();
+}
+
+bool FrameReader::open(const std::string &url, const FrameReaderOptions &options) {
+    close();
+    options_ = options;
+    // 缓存里放的都是内存中的帧，显存的surface数量有限
+    options_.decoder.cpuFrames = true;
+    if(!decoder_.open(url, options_.decoder)) {
+        return false;
+    }
+
+    strm_ = decoder_.formatContext()->streams[decoder_.streamIndex()];
+    startTime_ = strm_->start_time != AV_NOPTS_VALUE ? strm_->start_time : 0;
+    AVRational frameRate = strm_->avg_frame_rate.num > 0 ? strm_->avg_frame_rate : strm_->r_frame_rate;
+    if(frameRate.num > 0 && frameRate.den > 0) {
+        frameDuration_ = av_rescale_q(1, av_inv_q(frameRate), strm_->time_base);
+    }
+    resume_ = startTime_;
+
+    decoded_ = av_frame_alloc();
+    last_ = av_frame_alloc();
+    if(decoded_ == nullptr || last_ == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void FrameReader::close() {
+    clearCache();
+    decoder_.close();
+    av_frame_free(&decoded_);
+    av_frame_free(&last_);
+    strm_ = nullptr;
+    startTime_ = 0;
+    frameDuration_ = 0;
+    position_ = AV_NOPTS_VALUE;
+    resume_ = 0;
+    eof_ = false;
+    stats_ = FrameReaderStats();
+}
+
+AVRational FrameReader::timeBase() const {
+    return strm_ ? strm_->time_base : AVRational{0, 1};
+}
+
+double FrameReader::duration() const {
+    if(strm_ == nullptr) {
+        return 0;
+    }
+    if(strm_->duration != AV_NOPTS_VALUE && strm_->duration > 0) {
+        return strm_->duration * av_q2d(strm_->time_base);
+    }
+    AVFormatContext *fmtCtx = decoder_.formatContext();
+    return fmtCtx->duration != AV_NOPTS_VALUE ? fmtCtx->duration / (double)AV_TIME_BASE : 0;
+}
+
+int64_t FrameReader::frameEnd(const AVFrame *frame) const {
+    return frame->pts + (frame->duration > 0 ? frame->duration : frameDuration_);
+}
+
+void FrameReader::clearCache() {
+    for(auto &item : cache_) {
+        av_frame_free(&item.second.first.frame);
+    }
+    cache_.clear();
+    lru_.clear();
+    stats_.cachedBytes = 0;
+}
+
+bool FrameReader::lookup(int64_t pts, AVFrame *frame) {
+    auto it = cache_.upper_bound(pts);
+    if(it == cache_.begin()) {
+        return false;
+    }
+    --it;
+    CacheEntry &entry = it->second.first;
+    if(it->first != pts && pts >= entry.end) {
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.second);
+    return av_frame_ref(frame, entry.frame) >= 0;
+}
+
+void FrameReader::insert(AVFrame *frame) {
+    if(cache_.count(frame->pts) > 0) {
+        return;
+    }
+    CacheEntry entry;
+    entry.frame = av_frame_clone(frame);
+    if(entry.frame == nullptr) {
+        return;
+    }
+    entry.end = frameEnd(frame);
+    entry.bytes = frameBytes(frame);
+    lru_.push_front(frame->pts);
+    cache_[frame->pts] = std::make_pair(entry, lru_.begin());
+    stats_.cachedBytes += entry.bytes;
+
+    // 至少保留刚放进去的这一帧
+    while(stats_.cachedBytes > options_.cacheBytes && lru_.size() > 1) {
+        auto found = cache_.find(lru_.back());
+        stats_.cachedBytes -= found->second.first.bytes;
+        av_frame_free(&found->second.first.frame);
+        cache_.erase(found);
+        lru_.pop_back();
+        ++stats_.evicted;
+    }
+}
+
+bool FrameReader::shouldSeek(int64_t pts) const {
+    // 解码器当前的位置，刚seek完还没有出帧时是seek的目标
+    int64_t from = position_ != AV_NOPTS_VALUE ? position_ : resume_;
+    if(pts < from) {
+        return true;
+    }
+    if(eof_) {
+        return false;
+    }
+
+    int idx = av_index_search_timestamp(strm_, pts, AVSEEK_FLAG_BACKWARD);
+    const AVIndexEntry *entry = idx >= 0 ? avformat_index_get_entry(strm_, idx) : nullptr;
+    if(entry) {
+        // 中间隔着关键帧才seek；顺序读时关键帧就是下一帧，继续解码
+        return entry->timestamp > from + frameDuration_;
+    }
+    return pts - from > (int64_t)(MAX_FORWARD_SEC / av_q2d(strm_->time_base));
+}
+
+void FrameReader::seekTo(int64_t target) {
+    ++stats_.seeks;
+    decoder_.seek(target);
+    av_frame_unref(last_);
+    position_ = AV_NOPTS_VALUE;
+    resume_ = target;
+    eof_ = false;
+}
+
+// 向前解码直到知道pts处是哪一帧，解出的帧都放进缓存
+// 返回AVERROR(EAGAIN)表示解出的第一帧已经在pts之后，需要seek到更前面
+int FrameReader::decodeTo(int64_t pts, AVFrame *frame) {
+    while(true) {
+        int ret = eof_ ? AVERROR_EOF : decoder_.receiveFrame(decoded_);
+        if(ret == AVERROR_EOF) {
+            eof_ = true;
+            // 最后一帧一直显示到它的时长结束
+            if(last_->buf[0] && position_ <= pts && pts < frameEnd(last_)) {
+                return av_frame_ref(frame, last_);
+            }
+            return AVERROR_EOF;
+        } else if(ret < 0) {
+            return ret;
+        }
+        ++stats_.decoded;
+
+        int64_t framePts = decoded_->best_effort_timestamp;
+        if(framePts == AV_NOPTS_VALUE) {
+            av_frame_unref(decoded_);
+            continue;
+        }
+        decoded_->pts = framePts;
+        insert(decoded_);
+
+        // 越过了目标，上一帧就是pts处显示的帧
+        bool passed = framePts > pts;
+        if(passed && last_->buf[0] && position_ <= pts) {
+            ret = av_frame_ref(frame, last_);
+        }
+        av_frame_unref(last_);
+        av_frame_move_ref(last_, decoded_);
+        position_ = framePts;
+        if(passed) {
+            return frame->buf[0] ? ret : AVERROR(EAGAIN);
+        }
+        if(framePts == pts || pts < frameEnd(last_)) {
+            return av_frame_ref(frame, last_);
+        }
+    }
+}
+
+int FrameReader::frameAtPts(int64_t pts, AVFrame *frame) {
+    if(strm_ == nullptr) {
+        return AVERROR(EINVAL);
+    }
+    ++stats_.requests;
+    if(lookup(pts, frame)) {
+        ++stats_.cacheHits;
+        return 0;
+    }
+
+    if(shouldSeek(pts)) {
+        seekTo(pts);
+    }
+    int ret = decodeTo(pts, frame);
+    for(int retry = 1; ret == AVERROR(EAGAIN) && retry <= MAX_SEEK_RETRY; ++retry) {
+        seekTo(pts - av_rescale_q(retry, AVRational{1, 1}, strm_->time_base));
+        ret = decodeTo(pts, frame);
+    }
+    // 还是超过，说明pts在第一帧之前
+    return ret == AVERROR(EAGAIN) ? AVERROR_EOF : ret;
+}
+
+int FrameReader::frameAt(double seconds, AVFrame *frame) {
+    if(strm_ == nullptr) {
+        return AVERROR(EINVAL);
+    }
+    return frameAtPts(startTime_ + (int64_t)llround(seconds / av_q2d(strm_->time_base)), frame);
+}
+
+void FrameReader::logReport() const {
+    av_log(NULL, AV_LOG_INFO, "frame reader : %lld requests, %lld cache hits, %lld seeks, %lld decoded, %.1f MB cached\n",
+           (long long)stats_.requests, (long long)stats_.cacheHits, (long long)stats_.seeks, (long long)stats_.decoded,
+           stats_.cachedBytes / (1024.0 * 1024.0));
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "decoderBackend.h"
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+
+struct FrameReaderOptions {
+    DecoderOptions decoder;             // 硬解时帧总是拷贝回内存后缓存
+    int64_t cacheBytes = 256 << 20;     // 缓存解码帧占用内存的上限
+};
+
+struct FrameReaderStats {
+    int64_t requests = 0;
+    int64_t cacheHits = 0;
+    int64_t seeks = 0;
+    int64_t decoded = 0;
+    int64_t evicted = 0;
+    int64_t cachedBytes = 0;
+};
+
+// 精确到帧的随机访问 : 取显示时间为t的帧(pts不大于t的最后一帧)，用于拖动进度条、剪辑预览
+//   最近解码出的帧都放在按字节数限制的LRU缓存中，附近的重复请求直接返回；
+//   请求的位置在当前解码位置之后，并且中间没有关键帧时(顺序向前)继续解码，不会seek；
+//   否则按索引seek到t前面的关键帧，向前解码到精确的pts
+class FrameReader {
+public:
+    FrameReader() = default;
+    ~FrameReader();
+    FrameReader(const FrameReader &) = delete;
+    FrameReader &operator=(const FrameReader &) = delete;
+
+    bool open(const std::string &url, const FrameReaderOptions &options = FrameReaderOptions());
+    void close();
+
+    // pts为流的时间基，frame需要是空的，返回的帧和缓存共享数据，不能改写
+    // 返回0成功，AVERROR_EOF表示在第一帧之前或者超出了结尾
+    int frameAtPts(int64_t pts, AVFrame *frame);
+    // seconds相对开头
+    int frameAt(double seconds, AVFrame *frame);
+
+    AVRational timeBase() const;
+    int64_t startTime() const { return startTime_; }
+    double duration() const;
+    int64_t frameDuration() const { return frameDuration_; }
+    const FrameReaderStats &stats() const { return stats_; }
+    void logReport() const;
+
+private:
+    struct CacheEntry {
+        AVFrame *frame = nullptr;
+        int64_t end = 0;                // 显示结束的时间，时长未知时等于pts
+        int64_t bytes = 0;
+    };
+    using Lru = std::list<int64_t>;     // 缓存帧的pts，最近使用的在前面
+
+    int64_t frameEnd(const AVFrame *frame) const;
+    bool lookup(int64_t pts, AVFrame *frame);
+    void insert(AVFrame *frame);
+    void clearCache();
+    bool shouldSeek(int64_t pts) const;
+    void seekTo(int64_t target);
+    int decodeTo(int64_t pts, AVFrame *frame);
+
+    FrameReaderOptions options_;
+    FrameReaderStats stats_;
+    VideoDecoder decoder_;
+    AVStream *strm_ = nullptr;
+    AVFrame *decoded_ = nullptr;
+    AVFrame *last_ = nullptr;           // 解码器最近输出的帧
+    int64_t startTime_ = 0;
+    int64_t frameDuration_ = 0;         // 平均帧时长，帧里没有duration时使用
+    int64_t position_ = AV_NOPTS_VALUE; // last_的pts，seek后未知
+    int64_t resume_ = 0;                // 打开或者seek的目标，解码从它前面的关键帧开始
+    bool eof_ = false;                  // 解码器已经输出了最后一帧
+    std::map<int64_t, std::pair<CacheEntry, Lru::iterator>> cache_;
+    Lru lru_;
+};
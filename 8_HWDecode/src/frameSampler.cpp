@@ -0,0 +1,218 @@
+#include "frameSampler.h"
+#include <cmath>
+
+// 还没读到两个关键帧时假设的GOP时长
+static const double DEFAULT_GOP_SEC = 2.0;
+
+FrameSampler::~FrameSampler() {
+    close();
+}
+
+bool FrameSampler::open(const std::string &url, const SamplerOptions &options) {
+    close();
+    options_ = options;
+
+    if(avformat_open_input(&fmtCtx_, url.c_str(), NULL, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open input format failed\n");
+        return false;
+    }
+    if(avformat_find_stream_info(fmtCtx_, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find stream info failed\n");
+        close();
+        return false;
+    }
+    streamIndex_ = av_find_best_stream(fmtCtx_, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if(streamIndex_ < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Find video stream error\n");
+        close();
+        return false;
+    }
+    strm_ = fmtCtx_->streams[streamIndex_];
+    // 其他流的packet直接丢掉，不用读出来
+    for(unsigned int i = 0; i < fmtCtx_->nb_streams; ++i) {
+        if((int)i != streamIndex_) {
+            fmtCtx_->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    const AVCodec *codec = avcodec_find_decoder(strm_->codecpar->codec_id);
+    codecCtx_ = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if(codecCtx_ == nullptr || avcodec_parameters_to_context(codecCtx_, strm_->codecpar) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Fill Codec context failed\n");
+        close();
+        return false;
+    }
+    codecCtx_->pkt_timebase = strm_->time_base;
+    codecCtx_->thread_count = options_.threadCount;
+    codecCtx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    if(avcodec_open2(codecCtx_, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open codec.\n");
+        close();
+        return false;
+    }
+
+    startTime_ = strm_->start_time != AV_NOPTS_VALUE ? strm_->start_time : 0;
+    if(strm_->avg_frame_rate.num > 0 && strm_->avg_frame_rate.den > 0) {
+        halfFrame_ = av_rescale_q(1, av_inv_q(strm_->avg_frame_rate), strm_->time_base) / 2;
+    }
+    hasIndex_ = avformat_index_get_entries_count(strm_) > 0;
+
+    packet_ = av_packet_alloc();
+    decoded_ = av_frame_alloc();
+    if(packet_ == nullptr || decoded_ == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void FrameSampler::close() {
+    avcodec_free_context(&codecCtx_);
+    avformat_close_input(&fmtCtx_);
+    av_packet_free(&packet_);
+    av_frame_free(&decoded_);
+    strm_ = nullptr;
+    streamIndex_ = -1;
+    startTime_ = 0;
+    halfFrame_ = 0;
+    position_ = AV_NOPTS_VALUE;
+    lastKeyframe_ = AV_NOPTS_VALUE;
+    gopSum_ = 0;
+    gopCount_ = 0;
+    hasIndex_ = false;
+    inputEof_ = false;
+    stats_ = SamplerStats();
+}
+
+double FrameSampler::duration() const {
+    if(strm_ == nullptr) {
+        return 0;
+    }
+    if(strm_->duration != AV_NOPTS_VALUE && strm_->duration > 0) {
+        return strm_->duration * av_q2d(strm_->time_base);
+    }
+    return fmtCtx_->duration != AV_NOPTS_VALUE ? fmtCtx_->duration / (double)AV_TIME_BASE : 0;
+}
+
+std::vector<double> FrameSampler::sampleTimes(double fps) const {
+    std::vector<double> times;
+    double total = duration();
+    if(fps <= 0) {
+        return times;
+    }
+    for(int64_t i = 0; i / fps < total; ++i) {
+        times.push_back(i / fps);
+    }
+    return times;
+}
+
+void FrameSampler::updateGopEstimate(const AVPacket *packet) {
+    if(!(packet->flags & AV_PKT_FLAG_KEY) || packet->dts == AV_NOPTS_VALUE) {
+        return;
+    }
+    if(lastKeyframe_ != AV_NOPTS_VALUE && packet->dts > lastKeyframe_) {
+        gopSum_ += packet->dts - lastKeyframe_;
+        ++gopCount_;
+    }
+    lastKeyframe_ = packet->dts;
+}
+
+bool FrameSampler::shouldSeek(int64_t target) const {
+    // 向后只能seek
+    if(position_ != AV_NOPTS_VALUE && target < position_) {
+        return true;
+    }
+    int64_t from = position_ != AV_NOPTS_VALUE ? position_ : startTime_;
+    if(position_ == AV_NOPTS_VALUE && stats_.packets > 0) {
+        // seek之后还没有解出帧，解码器会从关键帧开始，继续即可
+        return false;
+    }
+
+    if(hasIndex_) {
+        // 目标前面最近的关键帧在当前位置之后，中间的帧都不需要解
+        int idx = av_index_search_timestamp(strm_, target, AVSEEK_FLAG_BACKWARD);
+        const AVIndexEntry *entry = idx >= 0 ? avformat_index_get_entry(strm_, idx) : nullptr;
+        return entry && entry->timestamp > from;
+    }
+
+    int64_t gop = gopCount_ > 0 ? gopSum_ / gopCount_
+                                : (int64_t)(DEFAULT_GOP_SEC / av_q2d(strm_->time_base));
+    return target - from > gop;
+}
+
+void FrameSampler::seekTo(int64_t target) {
+    if(av_seek_frame(fmtCtx_, streamIndex_, target, AVSEEK_FLAG_BACKWARD) < 0) {
+        // 有的格式不支持按流seek，从头解码
+        av_seek_frame(fmtCtx_, streamIndex_, startTime_, AVSEEK_FLAG_BACKWARD);
+    }
+    avcodec_flush_buffers(codecCtx_);
+    position_ = AV_NOPTS_VALUE;
+    lastKeyframe_ = AV_NOPTS_VALUE;
+    inputEof_ = false;
+    ++stats_.seeks;
+}
+
+int FrameSampler::frameAt(double seconds, AVFrame *frame) {
+    if(codecCtx_ == nullptr) {
+        return AVERROR(EINVAL);
+    }
+    int64_t target = startTime_ + (int64_t)llround(seconds / av_q2d(strm_->time_base));
+    if(shouldSeek(target)) {
+        seekTo(target);
+    }
+
+    while(true) {
+        int ret = avcodec_receive_frame(codecCtx_, decoded_);
+        if(ret >= 0) {
+            ++stats_.decoded;
+            int64_t pts = decoded_->best_effort_timestamp;
+            if(pts != AV_NOPTS_VALUE) {
+                position_ = pts;
+            }
+            if(pts == AV_NOPTS_VALUE || pts + halfFrame_ >= target) {
+                av_frame_move_ref(frame, decoded_);
+                ++stats_.returned;
+                return 0;
+            }
+            av_frame_unref(decoded_);
+            continue;
+        } else if(ret != AVERROR(EAGAIN)) {
+            return ret;
+        }
+
+        // 解码器需要更多输入
+        if(inputEof_) {
+            return AVERROR_EOF;
+        }
+        ret = av_read_frame(fmtCtx_, packet_);
+        if(ret < 0) {
+            inputEof_ = true;
+            avcodec_send_packet(codecCtx_, NULL);
+            continue;
+        }
+        if(packet_->stream_index != streamIndex_) {
+            av_packet_unref(packet_);
+            continue;
+        }
+        updateGopEstimate(packet_);
+
+        // 这个packet的显示时间在目标之前，它的帧不会被返回，不被参考的话解码器可以直接丢掉
+        int64_t pts = packet_->pts != AV_NOPTS_VALUE ? packet_->pts : packet_->dts;
+        bool beforeTarget = pts != AV_NOPTS_VALUE && pts + halfFrame_ < target;
+        codecCtx_->skip_frame = options_.skipNonRef && beforeTarget ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
+        ret = avcodec_send_packet(codecCtx_, packet_);
+        av_packet_unref(packet_);
+        ++stats_.packets;
+        if(ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_INVALIDDATA) {
+            av_log(NULL, AV_LOG_ERROR, "Error when decode send packet.\n");
+            return ret;
+        }
+    }
+}
+
+void FrameSampler::logReport() const {
+    double ratio = stats_.returned > 0 ? (double)stats_.decoded / stats_.returned : 0;
+    av_log(NULL, AV_LOG_INFO, "sampler : %lld returned, %lld decoded (%.2f per returned frame), %lld packets, %lld seeks\n",
+           (long long)stats_.returned, (long long)stats_.decoded, ratio, (long long)stats_.packets, (long long)stats_.seeks);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+struct SamplerOptions {
+    bool skipNonRef = true;             // 目标之前的非参考帧交给解码器丢掉
+    int threadCount = 0;                // 软解的线程数，0表示按核数
+};
+
+struct SamplerStats {
+    int64_t returned = 0;               // 返回给调用方的帧数
+    int64_t decoded = 0;                // 解码器实际输出的帧数
+    int64_t packets = 0;                // 送入解码器的packet数
+    int64_t seeks = 0;
+};
+
+// 稀疏采样解码 : 按目标时间取帧，如2fps的分析帧率，或者指定的时间点
+//   每个目标时间判断是继续向前解码还是seek到它前面的关键帧 : 目标前面的关键帧在当前位置之后(有索引时)，
+//   或者距离超过估计的GOP时长(没有索引时)就seek；向前解码时目标之前的非参考帧用skip_frame丢掉
+class FrameSampler {
+public:
+    FrameSampler() = default;
+    ~FrameSampler();
+    FrameSampler(const FrameSampler &) = delete;
+    FrameSampler &operator=(const FrameSampler &) = delete;
+
+    bool open(const std::string &url, const SamplerOptions &options = SamplerOptions());
+    void close();
+
+    // 取时间点seconds(相对开头)处的帧，即第一个显示时间不早于它的帧，frame需要是空的
+    // 返回0成功，AVERROR_EOF表示超出了结尾
+    int frameAt(double seconds, AVFrame *frame);
+
+    // 从开头到结尾按fps均匀分布的时间点
+    std::vector<double> sampleTimes(double fps) const;
+
+    double duration() const;
+    const SamplerStats &stats() const { return stats_; }
+    // 打印每返回一帧解码了多少帧
+    void logReport() const;
+
+private:
+    bool shouldSeek(int64_t target) const;
+    void seekTo(int64_t target);
+    void updateGopEstimate(const AVPacket *packet);
+
+    SamplerOptions options_;
+    SamplerStats stats_;
+    AVFormatContext *fmtCtx_ = nullptr;
+    AVCodecContext *codecCtx_ = nullptr;
+    AVStream *strm_ = nullptr;
+    int streamIndex_ = -1;
+    AVPacket *packet_ = nullptr;
+    AVFrame *decoded_ = nullptr;
+    int64_t startTime_ = 0;             // 以下时间的时间基都是流的time_base
+    int64_t halfFrame_ = 0;             // 半帧的时长，判断帧是否到达目标时的容差
+    int64_t position_ = AV_NOPTS_VALUE; // 最近解码出的帧的时间，seek后未知
+    int64_t lastKeyframe_ = AV_NOPTS_VALUE;
+    int64_t gopSum_ = 0;                // 读到的相邻关键帧间隔的累计，用来估计GOP时长
+    int64_t gopCount_ = 0;
+    bool hasIndex_ = false;
+    bool inputEof_ = false;
+};
@@ -1,4 +1,5 @@
 #pragma once
 #include <string>
 
-void hwdecode(std::string url);
\ No newline at end of file
+// dumpPath不为空时保存所有帧 : .y4m为Y4M，带%d时每帧一个文件，其他为裸数据拼接
+void hwdecode(std::string url, std::string dumpPath = "");
\ No newline at end of file
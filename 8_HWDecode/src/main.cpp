@@ -1,6 +1,40 @@
 #include "hwdecode.h"
+#include "frameReader.h"
+#include "frameSampler.h"
+#include "thumbnail.h"
 
 int main() {
     hwdecode("../res/big_buck_bunny.mp4");
+
+    // 只解关键帧的缩略图，多个文件时并行
+    extractThumbnails(std::vector<std::string>{"../res/big_buck_bunny.mp4"});
+
+    // 按2fps的分析帧率取帧
+    FrameSampler sampler;
+    if(sampler.open("../res/big_buck_bunny.mp4")) {
+        AVFrame *frame = av_frame_alloc();
+        for(double seconds : sampler.sampleTimes(2)) {
+            if(sampler.frameAt(seconds, frame) < 0) {
+                break;
+            }
+            av_frame_unref(frame);
+        }
+        av_frame_free(&frame);
+        sampler.logReport();
+    }
+
+    // 精确到帧的随机访问，附近的重复请求从缓存返回
+    FrameReader reader;
+    if(reader.open("../res/big_buck_bunny.mp4")) {
+        AVFrame *frame = av_frame_alloc();
+        for(double seconds : {5.0, 5.04, 5.0, 2.0}) {
+            if(reader.frameAt(seconds, frame) >= 0) {
+                av_log(NULL, AV_LOG_INFO, "frame at %.2fs : pts %lld\n", seconds, (long long)frame->pts);
+            }
+            av_frame_unref(frame);
+        }
+        av_frame_free(&frame);
+        reader.logReport();
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,247 @@
+#include "thumbnail.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+// 要seek到的位置，时间基为流的time_base
+//   有索引时(如mp4)直接从索引里的关键帧中均匀挑选，不会有两个位置落到同一个关键帧上
+//   没有索引时(如ts)按时长均匀分布，seek时向前找最近的关键帧
+static std::vector<int64_t> seekTargets(AVFormatContext *fmtCtx, AVStream *strm, int count, bool *indexed) {
+    std::vector<int64_t> keyframes;
+    int entries = avformat_index_get_entries_count(strm);
+    for(int i = 0; i < entries; ++i) {
+        const AVIndexEntry *entry = avformat_index_get_entry(strm, i);
+        if(entry && (entry->flags & AVINDEX_KEYFRAME)) {
+            keyframes.push_back(entry->timestamp);
+        }
+    }
+
+    std::vector<int64_t> targets;
+    *indexed = !keyframes.empty();
+    if(*indexed) {
+        int num = std::min<int>(count, keyframes.size());
+        for(int i = 0; i < num; ++i) {
+            targets.push_back(keyframes[(2 * i + 1) * keyframes.size() / (2 * num)]);
+        }
+        return targets;
+    }
+
+    int64_t start = strm->start_time != AV_NOPTS_VALUE ? strm->start_time : 0;
+    int64_t duration = strm->duration;
+    if(duration == AV_NOPTS_VALUE || duration <= 0) {
+        duration = fmtCtx->duration != AV_NOPTS_VALUE ? av_rescale_q(fmtCtx->duration, AV_TIME_BASE_Q, strm->time_base) : 0;
+    }
+    // 时长未知时只取开头
+    int num = duration > 0 ? count : 1;
+    for(int i = 0; i < num; ++i) {
+        targets.push_back(start + duration * (2 * i + 1) / (2 * num));
+    }
+    return targets;
+}
+
+// seek到target前面的关键帧，只送入这一个packet，冲刷出解码结果
+static int decodeKeyframeAt(AVFormatContext *fmtCtx, int streamIndex, AVCodecContext *codecCtx, int64_t target,
+                            AVPacket *packet, AVFrame *frame) {
+    int ret = av_seek_frame(fmtCtx, streamIndex, target, AVSEEK_FLAG_BACKWARD);
+    if(ret < 0) {
+        return ret;
+    }
+
+    // seek之后跳过关键帧之前的packet，不送入解码器
+    while((ret = av_read_frame(fmtCtx, packet)) >= 0) {
+        if(packet->stream_index == streamIndex && (packet->flags & AV_PKT_FLAG_KEY)) {
+            break;
+        }
+        av_packet_unref(packet);
+    }
+    if(ret < 0) {
+        return ret;
+    }
+
+    // 有B帧时解码器会缓存几帧再输出，送入NULL让它立刻输出这一帧
+    ret = avcodec_send_packet(codecCtx, packet);
+    av_packet_unref(packet);
+    if(ret >= 0) {
+        avcodec_send_packet(codecCtx, NULL);
+        ret = avcodec_receive_frame(codecCtx, frame);
+    }
+    // 清掉结束状态，下一个位置可以继续送packet
+    avcodec_flush_buffers(codecCtx);
+    return ret;
+}
+
+static AVCodecContext *openJpegEncoder(int width, int height) {
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    AVCodecContext *codecCtx = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if(codecCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find mjpeg encoder\n");
+        return nullptr;
+    }
+    codecCtx->width = width;
+    codecCtx->height = height;
+    codecCtx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+    codecCtx->time_base = AVRational{1, 25};
+    // 固定质量，qscale越小质量越高
+    codecCtx->flags |= AV_CODEC_FLAG_QSCALE;
+    codecCtx->global_quality = FF_QP2LAMBDA * 3;
+    if(avcodec_open2(codecCtx, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open mjpeg encoder\n");
+        avcodec_free_context(&codecCtx);
+    }
+    return codecCtx;
+}
+
+// 编码一张jpg，一次写入文件
+static bool writeJpeg(AVCodecContext *encCtx, AVFrame *thumb, AVPacket *packet, const std::string &outfile) {
+    if(avcodec_send_frame(encCtx, thumb) < 0 || avcodec_receive_packet(encCtx, packet) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "encode thumbnail failed\n");
+        return false;
+    }
+    FILE *file = fopen(outfile.c_str(), "wb");
+    bool ok = file && fwrite(packet->data, 1, packet->size, file) == (size_t)packet->size;
+    if(file) {
+        fclose(file);
+    }
+    av_packet_unref(packet);
+    if(!ok) {
+        av_log(NULL, AV_LOG_ERROR, "write %s failed\n", outfile.c_str());
+    }
+    return ok;
+}
+
+bool extractThumbnails(const std::string &url, const ThumbnailOptions &options, DecoderPool &pool,
+                       ThumbnailResult *result) {
+    auto begin = std::chrono::steady_clock::now();
+    ThumbnailResult summary;
+    summary.url = url;
+
+    AVFormatContext *fmtCtx = nullptr;
+    if(avformat_open_input(&fmtCtx, url.c_str(), NULL, NULL) < 0 || avformat_find_stream_info(fmtCtx, NULL) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Open input %s failed\n", url.c_str());
+        avformat_close_input(&fmtCtx);
+        if(result) {
+            *result = summary;
+        }
+        return false;
+    }
+    int streamIndex = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    AVStream *strm = streamIndex >= 0 ? fmtCtx->streams[streamIndex] : nullptr;
+    AVCodecContext *codecCtx = strm ? pool.acquire(strm->codecpar, strm->time_base) : nullptr;
+    if(codecCtx == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "Open video decoder of %s failed\n", url.c_str());
+        avformat_close_input(&fmtCtx);
+        if(result) {
+            *result = summary;
+        }
+        return false;
+    }
+    // 解码器只处理关键帧，送错了非关键帧也会被丢掉
+    codecCtx->skip_frame = AVDISCARD_NONKEY;
+
+    // 缩略图尺寸，yuv420要求宽高是偶数
+    int thumbWidth = options.width & ~1;
+    int thumbHeight = options.height > 0 ? options.height & ~1
+                                         : (int)av_rescale(thumbWidth, strm->codecpar->height, std::max(1, strm->codecpar->width)) & ~1;
+    thumbHeight = std::max(2, thumbHeight);
+    AVCodecContext *encCtx = openJpegEncoder(thumbWidth, thumbHeight);
+
+    AVFrame *frame = av_frame_alloc();
+    AVFrame *thumb = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    SwsContext *swsCtx = nullptr;
+    thumb->width = thumbWidth;
+    thumb->height = thumbHeight;
+    thumb->format = AV_PIX_FMT_YUVJ420P;
+    bool ok = encCtx && av_frame_get_buffer(thumb, 0) >= 0;
+
+    std::string stem = std::filesystem::path(url).stem().string();
+    std::vector<int64_t> targets = ok ? seekTargets(fmtCtx, strm, options.count, &summary.indexed) : std::vector<int64_t>();
+    int64_t lastPts = AV_NOPTS_VALUE;
+    for(int64_t target : targets) {
+        if(decodeKeyframeAt(fmtCtx, streamIndex, codecCtx, target, packet, frame) < 0) {
+            continue;
+        }
+        ++summary.decodedFrames;
+
+        // 没有索引时，短文件上相邻的位置可能落到同一个关键帧
+        if(frame->pts != AV_NOPTS_VALUE && frame->pts == lastPts) {
+            av_frame_unref(frame);
+            continue;
+        }
+        lastPts = frame->pts;
+
+        swsCtx = sws_getCachedContext(swsCtx, frame->width, frame->height, (AVPixelFormat)frame->format,
+                                      thumbWidth, thumbHeight, AV_PIX_FMT_YUVJ420P, SWS_BILINEAR, NULL, NULL, NULL);
+        if(swsCtx == nullptr || av_frame_make_writable(thumb) < 0 || sws_scale_frame(swsCtx, thumb, frame) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "scale thumbnail failed\n");
+            av_frame_unref(frame);
+            continue;
+        }
+        av_frame_unref(frame);
+
+        std::string outfile = (std::filesystem::path(options.outDir) / (stem + "_" + std::to_string(summary.thumbnails) + ".jpg")).string();
+        if(writeJpeg(encCtx, thumb, packet, outfile)) {
+            ++summary.thumbnails;
+        }
+    }
+
+    summary.ok = summary.thumbnails > 0;
+    summary.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    av_log(NULL, AV_LOG_INFO, "thumbnail %s : %d thumbnails, %d frames decoded, %.1f ms%s\n", url.c_str(),
+           summary.thumbnails, summary.decodedFrames, summary.elapsedMs, summary.indexed ? "" : " (no index)");
+    if(result) {
+        *result = summary;
+    }
+
+    sws_freeContext(swsCtx);
+    av_frame_free(&frame);
+    av_frame_free(&thumb);
+    av_packet_free(&packet);
+    avcodec_free_context(&encCtx);
+    pool.release(codecCtx);
+    avformat_close_input(&fmtCtx);
+    return summary.ok;
+}
+
+std::vector<ThumbnailResult> extractThumbnails(const std::vector<std::string> &urls, const ThumbnailOptions &options) {
+    int jobs = options.jobs > 0 ? options.jobs : (int)std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::min<int>(jobs, urls.size());
+
+    // 并行的粒度是文件，每个解码器单线程；每个工作线程对应一个空闲的解码器
+    DecoderPoolConfig config;
+    config.threadCount = 1;
+    config.maxIdlePerKey = std::max(1, jobs);
+    DecoderPool pool(config);
+
+    std::vector<ThumbnailResult> results(urls.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for(size_t i = next++; i < urls.size(); i = next++) {
+            extractThumbnails(urls[i], options, pool, &results[i]);
+        }
+    };
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(int i = 0; i < jobs; ++i) {
+        workers.emplace_back(worker);
+    }
+    for(auto &thread : workers) {
+        thread.join();
+    }
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    DecoderPoolStats stats = pool.stats();
+    av_log(NULL, AV_LOG_INFO, "thumbnail %zu files with %d jobs in %.1f ms, %.1f ms per file, decoders reused %lld opened %lld\n",
+           urls.size(), jobs, elapsedMs, urls.empty() ? 0 : elapsedMs / urls.size(),
+           (long long)stats.reused, (long long)stats.opened);
+    return results;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "decoderPool.h"
+#include <string>
+#include <vector>
+
+struct ThumbnailOptions {
+    int count = 5;                      // 每个文件均匀取的缩略图个数
+    int width = 320;                    // 缩略图的宽，高按比例
+    int height = 0;                     // 不为0时使用指定的高
+    std::string outDir = ".";           // 输出 <outDir>/<文件名>_<序号>.jpg
+    int jobs = 0;                       // 同时处理的文件数，0表示按核数
+};
+
+struct ThumbnailResult {
+    std::string url;
+    bool ok = false;
+    bool indexed = false;               // 按容器的索引取的关键帧，否则按时长均匀seek
+    int thumbnails = 0;
+    int decodedFrames = 0;
+    double elapsedMs = 0;
+};
+
+// 只解码关键帧的快速缩略图 : skip_frame设为AVDISCARD_NONKEY，seek到N个均匀分布的关键帧，
+// 每个位置只送入一个关键帧解码，缩放后保存成jpg；解码器从pool中取
+bool extractThumbnails(const std::string &url, const ThumbnailOptions &options, DecoderPool &pool,
+                       ThumbnailResult *result = nullptr);
+
+// 多个文件并行提取，共用一个软解的解码器池
+std::vector<ThumbnailResult> extractThumbnails(const std::vector<std::string> &urls,
+                                               const ThumbnailOptions &options = ThumbnailOptions());
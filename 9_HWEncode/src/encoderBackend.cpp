@@ -0,0 +1,286 @@
+#include "encoderBackend.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+extern "C" {
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+std::vector<std::string> defaultEncoderPriority() {
+    return {
+        "h264_videotoolbox",    // macOS
+        "h264_nvenc",           // NVIDIA
+        "h264_qsv",             // Intel Quick Sync
+        "h264_vaapi",           // Linux上的Intel/AMD
+        "libx264",
+        "libopenh264",
+    };
+}
+
+// 回退用的软件编码器
+static const char *SOFTWARE_ENCODERS[] = {"libx264", "libopenh264"};
+
+static bool isHardwareEncoder(const AVCodec *codec) {
+    return codec->capabilities & (AV_CODEC_CAP_HARDWARE | AV_CODEC_CAP_HYBRID);
+}
+
+// 有的硬件编码器没有声明AVCodecHWConfig(实测h264_videotoolbox就找不到)，按名字推断设备类型
+static AVHWDeviceType deviceTypeByName(const char *name) {
+    struct NameToDevice {
+        const char *suffix;
+        AVHWDeviceType type;
+    };
+    static const NameToDevice TABLE[] = {
+        {"_videotoolbox", AV_HWDEVICE_TYPE_VIDEOTOOLBOX},
+        {"_nvenc", AV_HWDEVICE_TYPE_CUDA},
+        {"_qsv", AV_HWDEVICE_TYPE_QSV},
+        {"_vaapi", AV_HWDEVICE_TYPE_VAAPI},
+    };
+    for(auto &item : TABLE) {
+        const char *found = strstr(name, item.suffix);
+        if(found && found[strlen(item.suffix)] == '\0') {
+            return item.type;
+        }
+    }
+    return AV_HWDEVICE_TYPE_NONE;
+}
+
+// 编码器要求的硬件设备类型和硬件帧格式
+static AVHWDeviceType probeHWConfig(const AVCodec *codec, AVPixelFormat &hwFormat) {
+    hwFormat = AV_PIX_FMT_NONE;
+    const AVCodecHWConfig *hwConfig = nullptr;
+    for(int i = 0; (hwConfig = avcodec_get_hw_config(codec, i)) != nullptr; ++i) {
+        if(hwConfig->methods & (AV_CODEC_HW_CONFIG_METHOD_HW_FRAMES_CTX | AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)) {
+            hwFormat = hwConfig->pix_fmt;
+            return hwConfig->device_type;
+        }
+    }
+    return isHardwareEncoder(codec) ? deviceTypeByName(codec->name) : AV_HWDEVICE_TYPE_NONE;
+}
+
+void listEncoderBackends(AVCodecID codecId) {
+    void *opaque = nullptr;
+    const AVCodec *codec = nullptr;
+    while((codec = av_codec_iterate(&opaque)) != nullptr) {
+        if(!av_codec_is_encoder(codec) || codec->id != codecId) {
+            continue;
+        }
+        av_log(NULL, AV_LOG_INFO, "encoder %s%s\n", codec->name, isHardwareEncoder(codec) ? " (hardware)" : "");
+        const AVCodecHWConfig *hwConfig = nullptr;
+        for(int i = 0; (hwConfig = avcodec_get_hw_config(codec, i)) != nullptr; ++i) {
+            av_log(NULL, AV_LOG_INFO, "  HW %d : device %s, pix_fmt %s, methods 0x%x\n", i,
+                   av_hwdevice_get_type_name(hwConfig->device_type), av_get_pix_fmt_name(hwConfig->pix_fmt), hwConfig->methods);
+        }
+    }
+}
+
+// 优先NV12，编码器不支持时用它支持的第一个格式
+static AVPixelFormat chooseSWFormat(const AVPixelFormat *formats) {
+    if(formats == nullptr) {
+        return AV_PIX_FMT_NV12;
+    }
+    for(int i = 0; formats[i] != AV_PIX_FMT_NONE; ++i) {
+        if(formats[i] == AV_PIX_FMT_NV12) {
+            return AV_PIX_FMT_NV12;
+        }
+    }
+    return formats[0];
+}
+
+// 创建硬件设备和编码器用的AVHWFramesContext
+static bool initHWFrames(AVCodecContext *codecCtx, AVHWDeviceType deviceType, AVPixelFormat hwFormat, const EncoderConfig &config) {
+    if(av_hwdevice_ctx_create(&codecCtx->hw_device_ctx, deviceType, NULL, NULL, 0) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "Create hw device %s failed.\n", av_hwdevice_get_type_name(deviceType));
+        return false;
+    }
+
+    // 获取AVHWFramesContext的限制要求
+    AVHWFramesConstraints *constraints = av_hwdevice_get_hwframe_constraints(codecCtx->hw_device_ctx, NULL);
+    if(constraints == nullptr) {
+        av_log(NULL, AV_LOG_WARNING, "Cannot get hwframes constraints.\n");
+        return false;
+    }
+    bool ok = constraints->min_width <= config.width && constraints->max_width >= config.width
+              && constraints->min_height <= config.height && constraints->max_height >= config.height;
+    if(!ok) {
+        av_log(NULL, AV_LOG_WARNING, "frames size %dx%d is not suitable\n", config.width, config.height);
+    }
+
+    // 硬件帧格式以AVCodecHWConfig为准，没有时用设备支持的第一个；内存中的格式优先NV12
+    AVPixelFormat swFormat = AV_PIX_FMT_NONE;
+    if(ok && constraints->valid_hw_formats && hwFormat == AV_PIX_FMT_NONE) {
+        hwFormat = constraints->valid_hw_formats[0];
+    }
+    if(ok && constraints->valid_sw_formats) {
+        swFormat = chooseSWFormat(constraints->valid_sw_formats);
+    }
+    av_hwframe_constraints_free(&constraints);
+    if(!ok || hwFormat == AV_PIX_FMT_NONE || swFormat == AV_PIX_FMT_NONE) {
+        return false;
+    }
+
+    codecCtx->hw_frames_ctx = av_hwframe_ctx_alloc(codecCtx->hw_device_ctx);
+    if(codecCtx->hw_frames_ctx == nullptr) {
+        av_log(NULL, AV_LOG_WARNING, "Allocate hw frames ctx error.\n");
+        return false;
+    }
+    auto hwFramesCtx = reinterpret_cast<AVHWFramesContext *>(codecCtx->hw_frames_ctx->data);
+    hwFramesCtx->width = config.width;
+    hwFramesCtx->height = config.height;
+    hwFramesCtx->format = hwFormat;
+    hwFramesCtx->sw_format = swFormat;
+    hwFramesCtx->initial_pool_size = 30;
+    if(av_hwframe_ctx_init(codecCtx->hw_frames_ctx) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "Init hw frames ctx error.\n");
+        return false;
+    }
+    codecCtx->pix_fmt = hwFormat;
+    codecCtx->sw_pix_fmt = swFormat;
+    return true;
+}
+
+// 打开一个编码器，失败时返回nullptr
+static AVCodecContext *tryOpenEncoder(const AVCodec *codec, const EncoderConfig &config, EncoderBackendInfo &info) {
+    AVCodecContext *codecCtx = avcodec_alloc_context3(codec);
+    if(codecCtx == nullptr) {
+        return nullptr;
+    }
+
+    codecCtx->bit_rate = config.bitRate;
+    codecCtx->width = config.width;
+    codecCtx->height = config.height;
+    codecCtx->time_base = av_inv_q(config.frameRate);
+    codecCtx->framerate = config.frameRate;
+    codecCtx->gop_size = config.gopSize;
+
+    AVPixelFormat hwFormat = AV_PIX_FMT_NONE;
+    AVHWDeviceType deviceType = probeHWConfig(codec, hwFormat);
+    if(deviceType != AV_HWDEVICE_TYPE_NONE) {
+        if(!initHWFrames(codecCtx, deviceType, hwFormat, config)) {
+            avcodec_free_context(&codecCtx);
+            return nullptr;
+        }
+    } else {
+        codecCtx->pix_fmt = chooseSWFormat(codec->pix_fmts);
+        // 软件编码器用满所有核
+        codecCtx->thread_count = 0;
+        codecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    }
+    const std::pair<const char *, const std::string *> privOptions[] = {
+        {"preset", &config.preset},
+        {"profile", &config.profile},
+        {"level", &config.level},
+    };
+    for(const auto &opt : privOptions) {
+        if(!opt.second->empty() && av_opt_set(codecCtx->priv_data, opt.first, opt.second->c_str(), 0) < 0) {
+            av_log(NULL, AV_LOG_INFO, "encoder %s ignores %s=%s\n", codec->name, opt.first, opt.second->c_str());
+        }
+    }
+
+    if(avcodec_open2(codecCtx, codec, NULL) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "open encoder %s failed\n", codec->name);
+        avcodec_free_context(&codecCtx);
+        return nullptr;
+    }
+
+    info.encoderName = codec->name;
+    info.deviceType = deviceType;
+    info.hardware = deviceType != AV_HWDEVICE_TYPE_NONE;
+    info.pixFmt = codecCtx->pix_fmt;
+    info.swFormat = info.hardware ? codecCtx->sw_pix_fmt : codecCtx->pix_fmt;
+    return codecCtx;
+}
+
+AVCodecContext *openEncoderBackend(const std::vector<std::string> &priority, const EncoderConfig &config,
+                                   EncoderBackendInfo *info) {
+    std::vector<std::string> candidates = priority;
+    for(const char *name : SOFTWARE_ENCODERS) {
+        if(std::find(candidates.begin(), candidates.end(), name) == candidates.end()) {
+            candidates.push_back(name);
+        }
+    }
+
+    for(auto &name : candidates) {
+        const AVCodec *codec = avcodec_find_encoder_by_name(name.c_str());
+        if(codec == nullptr || codec->id != config.codecId) {
+            av_log(NULL, AV_LOG_VERBOSE, "encoder %s is not available\n", name.c_str());
+            continue;
+        }
+
+        EncoderBackendInfo result;
+        AVCodecContext *codecCtx = tryOpenEncoder(codec, config, result);
+        if(codecCtx) {
+            av_log(NULL, AV_LOG_INFO, "use encoder %s (%s, %s)\n", result.encoderName.c_str(),
+                   result.hardware ? av_hwdevice_get_type_name(result.deviceType) : "software",
+                   av_get_pix_fmt_name(result.swFormat));
+            if(info) {
+                *info = result;
+            }
+            return codecCtx;
+        }
+    }
+
+    av_log(NULL, AV_LOG_ERROR, "No usable encoder\n");
+    return nullptr;
+}
+
+FrameUploader::FrameUploader(AVCodecContext *codecCtx) : codecCtx_(codecCtx) {
+    targetFormat_ = codecCtx->hw_frames_ctx ? codecCtx->sw_pix_fmt : codecCtx->pix_fmt;
+}
+
+FrameUploader::~FrameUploader() {
+    sws_freeContext(swsCtx_);
+    av_frame_free(&staging_);
+}
+
+// 转成编码器需要的内存格式，缓冲从池中取
+int FrameUploader::convert(const AVFrame *src, AVFrame *dst) {
+    if(convertPool_ == nullptr) {
+        convertPool_ = std::make_unique<FramePool>(codecCtx_->width, codecCtx_->height, targetFormat_);
+    }
+    swsCtx_ = sws_getCachedContext(swsCtx_, src->width, src->height, (AVPixelFormat)src->format,
+                                   codecCtx_->width, codecCtx_->height, targetFormat_, SWS_BILINEAR, NULL, NULL, NULL);
+    if(swsCtx_ == nullptr) {
+        return AVERROR(EINVAL);
+    }
+    int ret = convertPool_->getBuffer(dst);
+    if(ret < 0) {
+        return ret;
+    }
+    sws_scale(swsCtx_, src->data, src->linesize, 0, src->height, dst->data, dst->linesize);
+    return 0;
+}
+
+int FrameUploader::upload(const AVFrame *src, AVFrame *dst) {
+    bool sameFormat = src->format == targetFormat_ && src->width == codecCtx_->width && src->height == codecCtx_->height;
+    int ret = 0;
+    if(codecCtx_->hw_frames_ctx == nullptr) {
+        // 软件编码器 : 格式一致时不拷贝
+        ret = sameFormat ? av_frame_ref(dst, src) : convert(src, dst);
+    } else {
+        const AVFrame *swFrame = src;
+        if(!sameFormat) {
+            if(staging_ == nullptr) {
+                staging_ = av_frame_alloc();
+            }
+            av_frame_unref(staging_);
+            ret = convert(src, staging_);
+            swFrame = staging_;
+        }
+        // 从hw_frames_ctx的池中取一张surface，把数据传给设备
+        if(ret >= 0) {
+            ret = av_hwframe_get_buffer(codecCtx_->hw_frames_ctx, dst, 0);
+        }
+        if(ret >= 0) {
+            ret = av_hwframe_transfer_data(dst, swFrame, 0);
+        }
+    }
+    if(ret < 0) {
+        av_frame_unref(dst);
+        return ret;
+    }
+    return av_frame_copy_props(dst, src);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "framePool.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
+}
+
+// 和具体编码器无关的编码参数，硬件和软件编码器使用同样的设置
+struct EncoderConfig {
+    AVCodecID codecId = AV_CODEC_ID_H264;
+    int width = 640;
+    int height = 360;
+    AVRational frameRate = {30, 1};
+    int64_t bitRate = 100000;
+    int gopSize = 12;
+    // 编码器私有参数，编码器没有这个参数时忽略，为空时不设置
+    std::string preset = "slow";
+    std::string profile = "main";
+    std::string level = "5.0";
+};
+
+// 最终选中的编码器
+struct EncoderBackendInfo {
+    std::string encoderName;
+    AVHWDeviceType deviceType = AV_HWDEVICE_TYPE_NONE;     // NONE表示软件编码
+    AVPixelFormat pixFmt = AV_PIX_FMT_NONE;                 // 送给编码器的帧格式，硬件编码时是硬件帧格式
+    AVPixelFormat swFormat = AV_PIX_FMT_NONE;               // 上传前内存中的帧格式
+    bool hardware = false;
+};
+
+// 默认的优先级 : 各平台的硬件编码器，最后是多线程的软件编码器
+std::vector<std::string> defaultEncoderPriority();
+
+// 打印编译进来的所有codecId的编码器和它们的AVCodecHWConfig
+void listEncoderBackends(AVCodecID codecId = AV_CODEC_ID_H264);
+
+// 按priority的顺序尝试打开编码器，硬件设备创建或者编码器打开失败时尝试下一个；
+// priority中没有软件编码器时，最后回退到libx264/libopenh264
+//   返回打开好的编码器，全部失败时返回nullptr
+AVCodecContext *openEncoderBackend(const std::vector<std::string> &priority, const EncoderConfig &config,
+                                   EncoderBackendInfo *info = nullptr);
+
+// 把内存中的帧转成编码器需要的帧，硬件和软件编码器走同一条路径 :
+//   硬件编码器从hw_frames_ctx的池中取一张surface上传，软件编码器格式一致时直接引用，不一致时转换
+class FrameUploader {
+public:
+    explicit FrameUploader(AVCodecContext *codecCtx);
+    ~FrameUploader();
+    FrameUploader(const FrameUploader &) = delete;
+    FrameUploader &operator=(const FrameUploader &) = delete;
+
+    // dst需要是空的(新分配或av_frame_unref过)，会拷贝src的pts等属性
+    int upload(const AVFrame *src, AVFrame *dst);
+
+private:
+    int convert(const AVFrame *src, AVFrame *dst);
+
+    AVCodecContext *codecCtx_ = nullptr;
+    AVPixelFormat targetFormat_ = AV_PIX_FMT_NONE;  // 内存中需要的格式，硬件编码时是sw_format
+    struct SwsContext *swsCtx_ = nullptr;
+    std::unique_ptr<FramePool> convertPool_;
+    AVFrame *staging_ = nullptr;                    // 硬件编码时格式转换的中间帧
+};
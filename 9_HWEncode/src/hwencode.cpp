@@ -1,4 +1,8 @@
 #include "hwencode.h"
+#include "encoderBackend.h"
+#include "rawVideoReader.h"
+#include <chrono>
+#include <unordered_set>
 
 extern "C" {
     #include <libavformat/avformat.h>
@@ -12,71 +16,7 @@ const int FRAME_HEIGHT = 360;
 
 const int TEST_FRAME_SIZE = 30 * 10;
 
-// 用读到的nv12数据，初始化软件帧
-void initSWFrame(AVFrame *swFrame, uint8_t *imgDataBuf, int bufSize) {
-
-    swFrame->width = FRAME_WIDTH;
-    swFrame->height= FRAME_HEIGHT;
-    swFrame->format= AV_PIX_FMT_NV12;
-
-    auto ret = av_frame_get_buffer(swFrame, 0);
-    if(ret < 0) {
-        av_log(NULL, AV_LOG_ERROR, "allocate frame buffer failed\n");
-        return;
-    }
-
-    ret = av_frame_make_writable(swFrame);
-    if(ret < 0) {
-        av_log(NULL, AV_LOG_ERROR, "av frame make writable failed\n");
-        return;
-    }
-
-    int offset = 0;
-    // 写入Y分量
-    for (int i = 0; i < swFrame->height; ++i) {
-        memcpy(swFrame->data[0] + i * swFrame->linesize[0], imgDataBuf + offset, swFrame->width);
-        offset += swFrame->width;
-    }
-    // 写入UV分量
-    for (int i = 0; i < swFrame->height / 2; ++i) {
-        memcpy(swFrame->data[1] + i * swFrame->linesize[1], imgDataBuf + offset, swFrame->width);
-        offset += swFrame->width;
-    }
-
-    // 应该正好符合大小
-    assert(offset == bufSize);
-}
-
-// 读取输入的一张nv12图做测试数据
-void readNv12ToBuf(uint8_t *&buf, int &length, std::string srcNv12) {
-    FILE *file = fopen(srcNv12.c_str(), "rb"); // 以二进制模式打开文件
-    if (file == NULL) {
-        av_log(NULL, AV_LOG_ERROR, "Failed to open file");
-    }
-
-    fseek(file, 0, SEEK_END);
-    length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    buf = (uint8_t *)malloc(length);
-    if (buf == NULL) {
-        av_log(NULL, AV_LOG_ERROR, "Failed to allocate memory");
-        fclose(file);
-        return;
-    }
-
-    size_t bytes_read = fread(buf, 1, length, file);
-    if (bytes_read != length) {
-        av_log(NULL, AV_LOG_ERROR, "Failed to read file\n");
-        free(buf);
-        fclose(file);
-        return;
-    }
-
-    fclose(file);
-}
-
-void hwencode(std::string dst, std::string srcNv12) {
+void hwencode(std::string dst, std::string srcNv12, const std::vector<std::string> &encoderPriority) {
     AVFormatContext* fmtCtx = nullptr;
     int ret = avformat_alloc_output_context2(&fmtCtx, NULL, NULL, dst.c_str());
     if(ret < 0) {
@@ -91,115 +31,31 @@ void hwencode(std::string dst, std::string srcNv12) {
     }
 
     AVStream* strm = avformat_new_stream(fmtCtx, nullptr);
-    if(ret < 0) {
+    if(strm == nullptr) {
         av_log(NULL, AV_LOG_ERROR, "add stream failed\n");
         return;
     }
     strm->time_base = AVRational{1, 30};
-    strm->avg_frame_rate = AVRational{30, 0};
-
-    // 需要显式指定h264_videotoolbox, hevc_videotoolbox(h265)
-    // 如果用avcodec_find_encoder(AV_CODEC_ID_H264)的方式默认返回软件实现，如x264
-    auto codec = avcodec_find_encoder_by_name("h264_videotoolbox");
-    if(codec == nullptr) {
-        av_log(NULL, AV_LOG_ERROR, "Cannot find codec h264\n");
-        return;
-    }
+    strm->avg_frame_rate = AVRational{30, 1};
 
-    AVCodecContext* codecCtx = avcodec_alloc_context3(codec);
-    if(codecCtx == nullptr) {
-        av_log(NULL, AV_LOG_ERROR, "Cannot allocate context\n");
+    // 映射输入的nv12文件，可以是多帧，编码时循环使用；y4m按文件头的分辨率
+    RawVideoReader reader;
+    if(!reader.open(srcNv12, FRAME_WIDTH, FRAME_HEIGHT, AV_PIX_FMT_NV12)) {
+        av_log(NULL, AV_LOG_ERROR, "open raw video %s failed\n", srcNv12.c_str());
         return;
     }
 
-    codecCtx->bit_rate = 100000;
-    codecCtx->width = FRAME_WIDTH;
-    codecCtx->height = FRAME_HEIGHT;
-    codecCtx->time_base = AVRational{1, 30};
-    codecCtx->framerate = AVRational{30, 0};
-    codecCtx->gop_size = 12;
-    // codecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
-    av_opt_set(codecCtx->priv_data, "preset", "slow", 0);
-    av_opt_set(codecCtx->priv_data, "profile", "main", 0);
-    av_opt_set(codecCtx->priv_data, "level", "5.0", 0);
-
-    // 获取Codec支持的硬件加速配置情况，这里主要是打印看看
-    // int hwindex = 0;
-    // std::vector<const AVCodecHWConfig*> hwconfigs;
-    // const AVCodecHWConfig* hwconfig = nullptr;
-
-    // while((hwconfig = avcodec_get_hw_config(codec, hwindex)) != nullptr) {
-    //     av_log(NULL, AV_LOG_INFO, "HW %d : %d, %d, %d \n", hwindex, hwconfig->pix_fmt, hwconfig->methods, hwconfig->device_type);
-    //     hwconfigs.push_back(hwconfig);
-    //     ++hwindex;
-    // }
-
-    // **这里实测AVCodecHWConfig找不到VideoToolBox的编码器配置,所以上面注释掉**
-    // 但还是可以手动设定和使用
+    // 按优先级尝试硬件编码器，都不可用时回退到软件编码器
+    EncoderConfig config;
+    config.width = reader.info().width;
+    config.height = reader.info().height;
+    config.frameRate = AVRational{30, 1};
+    config.bitRate = 100000;
+    config.gopSize = 12;
 
-    // 创建hwdevicectx
-    if(av_hwdevice_ctx_create(&codecCtx->hw_device_ctx, AV_HWDEVICE_TYPE_VIDEOTOOLBOX, NULL, NULL, 0) < 0) {
-        av_log(NULL, AV_LOG_ERROR, "Create hw device error.\n");
-
-        return;
-    }
-
-    // 获取AVHWFramesContext的限制要求
-    auto hwFramesConstraints = av_hwdevice_get_hwframe_constraints(codecCtx->hw_device_ctx, NULL);
-    if(hwFramesConstraints == nullptr) {
-        av_log(NULL, AV_LOG_ERROR, "Cannot get hwframes constraints.\n");
-        return;
-    }
-
-    // 创建成功，设置对应的AVHWFramesContext
-    if(codecCtx->hw_device_ctx) {
-        codecCtx->hw_frames_ctx = av_hwframe_ctx_alloc(codecCtx->hw_device_ctx);
-        if(codecCtx->hw_frames_ctx == nullptr) {
-            av_log(NULL, AV_LOG_ERROR, "Allocate hw frames ctx error.\n");
-
-            return;
-        }
-
-        // 设置inital_pool_size
-        auto hwFramesCtx = reinterpret_cast<AVHWFramesContext *>(codecCtx->hw_frames_ctx->data);
-        if(hwFramesConstraints->min_width > FRAME_WIDTH || hwFramesConstraints->max_width < FRAME_WIDTH) {
-            av_log(NULL, AV_LOG_ERROR, "frames width is not suitable \n");
-        }
-        if(hwFramesConstraints->min_height > FRAME_HEIGHT || hwFramesConstraints->max_height < FRAME_HEIGHT) {
-            av_log(NULL, AV_LOG_ERROR, "frames height is not suitable \n");
-        }
-        hwFramesCtx->width = FRAME_WIDTH;
-        hwFramesCtx->height = FRAME_HEIGHT;
-        hwFramesCtx->initial_pool_size = 30;
-            
-        // 设置pixelformat
-        for(int i = 0; hwFramesConstraints->valid_hw_formats[i] != AV_PIX_FMT_NONE; ++i) {
-            // 打印一下
-            av_log(NULL, AV_LOG_INFO,"Valid HWFormats %d : %d\n", i, hwFramesConstraints->valid_hw_formats[i]);
-            if(hwFramesConstraints->valid_hw_formats[i] == AV_PIX_FMT_VIDEOTOOLBOX) {
-                hwFramesCtx->format = hwFramesConstraints->valid_hw_formats[i];
-                codecCtx->pix_fmt = hwFramesCtx->format;
-            }
-        }
-            
-        for(int i = 0; hwFramesConstraints->valid_sw_formats[i] != AV_PIX_FMT_NONE; ++i) {
-            // 打印一下
-            av_log(NULL, AV_LOG_INFO,"Valid SWFormats %d : %d\n", i, hwFramesConstraints->valid_sw_formats[i]);
-            if(hwFramesConstraints->valid_sw_formats[i] == AV_PIX_FMT_NV12) {
-                hwFramesCtx->sw_format = hwFramesConstraints->valid_sw_formats[i];
-                codecCtx->sw_pix_fmt = hwFramesCtx->sw_format;
-            }
-        }
-
-        if(av_hwframe_ctx_init(codecCtx->hw_frames_ctx) < 0) {
-            av_log(NULL, AV_LOG_ERROR, "Init hw frames ctx error.\n");
-            return;
-        }
-    }
-
-    ret = avcodec_open2(codecCtx, codec, NULL);
-    if(ret < 0) {
-        av_log(NULL, AV_LOG_ERROR, "codec open failed\n");
+    EncoderBackendInfo backend;
+    AVCodecContext* codecCtx = openEncoderBackend(encoderPriority, config, &backend);
+    if(codecCtx == nullptr) {
         return;
     }
 
@@ -209,11 +65,6 @@ void hwencode(std::string dst, std::string srcNv12) {
         return;
     }
 
-    // 读取输入的nv12图片
-    uint8_t *nv12Buf = nullptr;
-    int bufSize = 0;
-    readNv12ToBuf(nv12Buf, bufSize, srcNv12);
-
     // write header
     ret = avformat_write_header(fmtCtx, NULL);
     if(ret < 0) {
@@ -221,33 +72,41 @@ void hwencode(std::string dst, std::string srcNv12) {
         return;
     }
 
-    // 软件帧
+    // 软件帧，直接指向映射的文件内容
     AVFrame *swFrame = av_frame_alloc();
-    initSWFrame(swFrame, nv12Buf, bufSize);
 
     AVPacket *packet = av_packet_alloc();
 
+    // 送给编码器的帧只分配一次，硬件编码时每一帧从hw_frames_ctx的池中取一张surface，
+    // 编码器用完后回到池中。记录用到过的不同surface，稳定后不应再增长；软件编码时没有意义，不统计
+    FrameUploader uploader(codecCtx);
+    AVFrame *encFrame = av_frame_alloc();
+    std::unordered_set<uint8_t *> usedBuffers;
+
+    auto begin = std::chrono::steady_clock::now();
     for(int i = 0;i < TEST_FRAME_SIZE; ++i) {
-        // 每次都申请一张hwFrame
-        AVFrame *hwFrame = av_frame_alloc();
-        if(av_hwframe_get_buffer(codecCtx->hw_frames_ctx, hwFrame, 0) < 0) {
-            av_log(NULL, AV_LOG_ERROR, "get a hwFrame error\n");
+        av_frame_unref(swFrame);
+        if(reader.getFrame(i % reader.frameCount(), swFrame) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "get raw frame failed\n");
             return;
         }
-        // 将帧数据传给设备
-        if(av_hwframe_transfer_data(hwFrame, swFrame, 0) < 0) {
-            av_log(NULL, AV_LOG_ERROR, "transfer data to hw failed\n");
+
+        // 硬件和软件编码器走同样的上传路径
+        if(uploader.upload(swFrame, encFrame) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "upload frame to encoder failed\n");
             return;
         }
+        if(encFrame->hw_frames_ctx) {
+            usedBuffers.insert(encFrame->buf[0]->data);
+        }
 
-        hwFrame->pts = i;
-        int ret = avcodec_send_frame(codecCtx, hwFrame);
+        encFrame->pts = i;
+        int ret = avcodec_send_frame(codecCtx, encFrame);
         if(ret < 0) {
-            av_log(NULL, AV_LOG_ERROR, "send hwFrame failed\n");
+            av_log(NULL, AV_LOG_ERROR, "send frame failed\n");
             return;
         }
-        av_frame_unref(hwFrame);
-        av_frame_free(&hwFrame);
+        av_frame_unref(encFrame);
 
         while(ret >= 0) {
             ret = avcodec_receive_packet(codecCtx, packet);
@@ -306,9 +165,18 @@ void hwencode(std::string dst, std::string srcNv12) {
         return;
     }
 
-    avcodec_close(codecCtx);
+    double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    av_log(NULL, AV_LOG_INFO, "encoder %s (%s) : %d frames in %.3fs, %.1f fps\n",
+           backend.encoderName.c_str(), backend.hardware ? av_hwdevice_get_type_name(backend.deviceType) : "software",
+           TEST_FRAME_SIZE, wallSec, wallSec > 0 ? TEST_FRAME_SIZE / wallSec : 0);
+    if(backend.hardware) {
+        av_log(NULL, AV_LOG_INFO, "%zu distinct hw surfaces used\n", usedBuffers.size());
+    }
+
+    avcodec_free_context(&codecCtx);
     avio_closep(&fmtCtx->pb);
     av_frame_free(&swFrame);
+    av_frame_free(&encFrame);
     av_packet_free(&packet);
     avformat_free_context(fmtCtx);
-}
\ No newline at end of file
+}
@@ -1,7 +1,10 @@
 #pragma once
+#include "encoderBackend.h"
 #include <string>
+#include <vector>
 
-// 会将输入的一张nv12图编码成一段10s的视频
+// 会将输入的nv12图编码成一段10s的视频，输入有多帧时循环使用
 // @param dst 输出文件
-// @param srcNv12 输入的一张nv12测试图
-void hwencode(std::string dst, std::string srcNv12);
\ No newline at end of file
+// @param srcNv12 输入的640x360 nv12文件(一帧或多帧)，也可以是.y4m
+// @param encoderPriority 依次尝试的编码器，都不可用时回退到软件编码器
+void hwencode(std::string dst, std::string srcNv12, const std::vector<std::string> &encoderPriority = defaultEncoderPriority());
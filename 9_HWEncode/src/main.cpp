@@ -1,7 +1,10 @@
 #include "hwencode.h"
 
 int main() {
+    // 打印可用的H264编码器和它们的硬件配置
+    listEncoderBackends();
+
     hwencode("./hwEncode_out.mp4", "../res/test_pic_640x360.nv12");
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,51 @@
+#include "framePool.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+}
+
+FramePool::FramePool(int width, int height, AVPixelFormat format, int align)
+    : width_(width), height_(height), format_(format), align_(align) {
+    // 所有平面放在一块缓冲里，末尾留出编码器可能越界读取的padding
+    int size = av_image_get_buffer_size(format, width, height, align);
+    if(size < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid frame pool size %dx%d\n", width, height);
+        return;
+    }
+    pool_ = av_buffer_pool_init2(size + AV_INPUT_BUFFER_PADDING_SIZE, this, allocBuffer, NULL);
+}
+
+FramePool::~FramePool() {
+    // 还在被引用的缓冲会在释放时由AVBufferPool自己回收
+    av_buffer_pool_uninit(&pool_);
+}
+
+// 只在池中没有空闲缓冲时调用，也就是真正的内存申请
+AVBufferRef *FramePool::allocBuffer(void *opaque, size_t size) {
+    FramePool *pool = (FramePool *)opaque;
+    ++pool->stats_.allocations;
+    return av_buffer_alloc(size);
+}
+
+int FramePool::getBuffer(AVFrame *frame) {
+    if(pool_ == nullptr) {
+        return AVERROR(EINVAL);
+    }
+    ++stats_.requests;
+
+    frame->buf[0] = av_buffer_pool_get(pool_);
+    if(frame->buf[0] == nullptr) {
+        return AVERROR(ENOMEM);
+    }
+    frame->width = width_;
+    frame->height = height_;
+    frame->format = format_;
+    int ret = av_image_fill_arrays(frame->data, frame->linesize, frame->buf[0]->data, format_, width_, height_, align_);
+    if(ret < 0) {
+        av_buffer_unref(&frame->buf[0]);
+        return ret;
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
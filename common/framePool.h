@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+}
+
+struct FramePoolStats {
+    int64_t requests = 0;       // 取帧缓冲的次数
+    int64_t allocations = 0;    // 池中没有空闲的缓冲，真正向系统申请内存的次数
+};
+
+// 基于AVBufferPool的帧缓冲分配器，代替av_frame_get_buffer()/av_frame_make_writable()
+//   编码器(以及其他持有者)释放最后一个引用后，缓冲自动回到池中，下一帧直接复用；
+//   稳定之后allocations不再增长，和编码器内部最多持有的帧数相当
+class FramePool {
+public:
+    FramePool(int width, int height, AVPixelFormat format, int align = 64);
+    ~FramePool();
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    // 给空的frame(新分配或av_frame_unref过)挂上池中的缓冲，填好宽高、格式和各平面的指针
+    int getBuffer(AVFrame *frame);
+
+    const FramePoolStats &stats() const { return stats_; }
+
+private:
+    static AVBufferRef *allocBuffer(void *opaque, size_t size);
+
+    int width_ = 0;
+    int height_ = 0;
+    AVPixelFormat format_ = AV_PIX_FMT_NONE;
+    int align_ = 0;
+    AVBufferPool *pool_ = nullptr;
+    FramePoolStats stats_;
+};
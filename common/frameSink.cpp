@@ -0,0 +1,271 @@
+#include "frameSink.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavutil/common.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/log.h>
+#include <libavutil/pixdesc.h>
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Y4M文件头中的色度采样，不支持的格式返回nullptr
+static const char *y4mColorspace(int format) {
+    switch(format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+        return "420jpeg";
+    case AV_PIX_FMT_YUV422P:
+        return "422";
+    case AV_PIX_FMT_YUV444P:
+        return "444";
+    case AV_PIX_FMT_GRAY8:
+        return "mono";
+    default:
+        return nullptr;
+    }
+}
+
+// PerFrame的路径作为snprintf的格式，只能有一个%d(可以带宽度，如%04d)，%%表示%本身
+static bool isFramePattern(const std::string &path) {
+    int conversions = 0;
+    for(size_t i = 0; i < path.size(); ++i) {
+        if(path[i] != '%') {
+            continue;
+        }
+        if(i + 1 < path.size() && path[i + 1] == '%') {
+            ++i;
+            continue;
+        }
+        size_t j = i + 1;
+        while(j < path.size() && path[j] >= '0' && path[j] <= '9') {
+            ++j;
+        }
+        if(j >= path.size() || path[j] != 'd') {
+            return false;
+        }
+        ++conversions;
+        i = j;
+    }
+    return conversions == 1;
+}
+
+FrameSink::~FrameSink() {
+    close();
+}
+
+bool FrameSink::open(const std::string &path, const FrameSinkOptions &options) {
+    close();
+    options_ = options;
+    path_ = path;
+    if(options_.format == FrameSinkFormat::Auto) {
+        if(path.find('%') != std::string::npos) {
+            options_.format = FrameSinkFormat::PerFrame;
+        } else if(path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0) {
+            options_.format = FrameSinkFormat::Y4M;
+        } else {
+            options_.format = FrameSinkFormat::Raw;
+        }
+    }
+    options_.queueSize = std::max(1, options_.queueSize);
+    if(options_.format == FrameSinkFormat::PerFrame && !isFramePattern(path)) {
+        av_log(NULL, AV_LOG_ERROR, "frame path %s needs exactly one %%d\n", path.c_str());
+        return false;
+    }
+
+    if(options_.format != FrameSinkFormat::PerFrame) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd_ < 0) {
+            av_log(NULL, AV_LOG_ERROR, "cannot open file %s\n", path.c_str());
+            return false;
+        }
+    }
+
+    stats_ = FrameSinkStats();
+    headerWritten_ = false;
+    closing_ = false;
+    error_ = 0;
+    opened_ = Clock::now();
+    writer_ = std::thread(&FrameSink::writerLoop, this);
+    return true;
+}
+
+int FrameSink::write(const AVFrame *frame) {
+    if(!writer_.joinable()) {
+        return AVERROR(EINVAL);
+    }
+    if(frame->hw_frames_ctx != nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "frame sink only accepts frames in memory\n");
+        return AVERROR(EINVAL);
+    }
+    if(options_.format == FrameSinkFormat::Y4M && y4mColorspace(frame->format) == nullptr) {
+        av_log(NULL, AV_LOG_ERROR, "y4m does not support %s\n", av_get_pix_fmt_name((AVPixelFormat)frame->format));
+        return AVERROR(EINVAL);
+    }
+
+    // 只增加引用计数，数据由写线程写完后释放
+    AVFrame *ref = av_frame_clone(frame);
+    if(ref == nullptr) {
+        return AVERROR(ENOMEM);
+    }
+
+    auto begin = Clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    notFull_.wait(lock, [this]() { return (int)queue_.size() < options_.queueSize || error_ < 0; });
+    stats_.stallSec += std::chrono::duration<double>(Clock::now() - begin).count();
+    if(error_ < 0) {
+        av_frame_free(&ref);
+        return error_;
+    }
+    queue_.push_back(ref);
+    notEmpty_.notify_one();
+    return 0;
+}
+
+int FrameSink::close() {
+    if(!writer_.joinable()) {
+        return error_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    notEmpty_.notify_one();
+    writer_.join();
+
+    if(fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    stats_.elapsedSec = std::chrono::duration<double>(Clock::now() - opened_).count();
+    return error_;
+}
+
+void FrameSink::writerLoop() {
+    while(true) {
+        AVFrame *frame = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notEmpty_.wait(lock, [this]() { return !queue_.empty() || closing_; });
+            if(queue_.empty()) {
+                break;
+            }
+            frame = queue_.front();
+            queue_.pop_front();
+        }
+        notFull_.notify_one();
+
+        // 出错之后只释放剩下的帧
+        int ret = error_ < 0 ? 0 : writeFrame(frame);
+        av_frame_free(&frame);
+        if(ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "write frame to %s failed\n", path_.c_str());
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = ret;
+            notFull_.notify_all();
+        }
+    }
+}
+
+// 写出所有iovec，处理IOV_MAX的限制和部分写入
+int FrameSink::writeBuffers(int fd, std::vector<struct iovec> &iov) {
+    auto begin = Clock::now();
+    size_t index = 0;
+    int ret = 0;
+    while(index < iov.size()) {
+        int count = (int)std::min<size_t>(iov.size() - index, IOV_MAX);
+        ssize_t written = count == 1 ? ::write(fd, iov[index].iov_base, iov[index].iov_len)
+                                     : ::writev(fd, &iov[index], count);
+        ++stats_.syscalls;
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            ret = AVERROR(errno);
+            break;
+        }
+        stats_.bytes += written;
+        while(written > 0 && index < iov.size()) {
+            if((size_t)written >= iov[index].iov_len) {
+                written -= iov[index].iov_len;
+                ++index;
+            } else {
+                iov[index].iov_base = (uint8_t *)iov[index].iov_base + written;
+                iov[index].iov_len -= written;
+                written = 0;
+            }
+        }
+    }
+    stats_.writeSec += std::chrono::duration<double>(Clock::now() - begin).count();
+    return ret;
+}
+
+int FrameSink::writeFrame(const AVFrame *frame) {
+    AVPixelFormat format = (AVPixelFormat)frame->format;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    if(desc == nullptr || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+        return AVERROR(EINVAL);
+    }
+
+    std::vector<struct iovec> iov;
+    std::string header;
+    if(options_.format == FrameSinkFormat::Y4M) {
+        if(!headerWritten_) {
+            // 未知的宽高比写A0:0
+            AVRational sar = frame->sample_aspect_ratio.num > 0 ? frame->sample_aspect_ratio : AVRational{0, 0};
+            char buffer[128];
+            snprintf(buffer, sizeof(buffer), "YUV4MPEG2 W%d H%d F%d:%d Ip A%d:%d C%s\n", frame->width, frame->height,
+                     options_.frameRate.num, options_.frameRate.den, sar.num, sar.den, y4mColorspace(format));
+            header = buffer;
+            headerWritten_ = true;
+        }
+        header += "FRAME\n";
+        iov.push_back({(void *)header.data(), header.size()});
+    }
+
+    for(int plane = 0; plane < av_pix_fmt_count_planes(format); ++plane) {
+        int rowBytes = av_image_get_linesize(format, frame->width, plane);
+        int rows = (plane == 1 || plane == 2) ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+        if(rowBytes < 0) {
+            return rowBytes;
+        }
+        if(frame->linesize[plane] == rowBytes) {
+            // 平面是连续的，整块写入
+            iov.push_back({frame->data[plane], (size_t)rowBytes * rows});
+        } else {
+            for(int row = 0; row < rows; ++row) {
+                iov.push_back({frame->data[plane] + (ptrdiff_t)row * frame->linesize[plane], (size_t)rowBytes});
+            }
+        }
+    }
+
+    int ret = 0;
+    if(options_.format == FrameSinkFormat::PerFrame) {
+        char path[1024];
+        snprintf(path, sizeof(path), path_.c_str(), (int)stats_.frames);
+        int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) {
+            return AVERROR(errno);
+        }
+        ret = writeBuffers(fd, iov);
+        ::close(fd);
+    } else {
+        ret = writeBuffers(fd_, iov);
+    }
+    if(ret >= 0) {
+        ++stats_.frames;
+    }
+    return ret;
+}
+
+void FrameSink::logReport() const {
+    double mb = stats_.bytes / (1024.0 * 1024.0);
+    av_log(NULL, AV_LOG_INFO, "frame sink %s : %lld frames, %.1f MB in %.3fs (%.1f MB/s), %lld syscalls, write %.3fs, caller stalled %.3fs\n",
+           path_.c_str(), (long long)stats_.frames, mb, stats_.elapsedSec, stats_.elapsedSec > 0 ? mb / stats_.elapsedSec : 0,
+           (long long)stats_.syscalls, stats_.writeSec, stats_.stallSec);
+}
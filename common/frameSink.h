@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/uio.h>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+enum class FrameSinkFormat {
+    Auto,                               // 按路径判断 : .y4m为Y4M，带%d为每帧一个文件，其他为Raw
+    Raw,                                // 所有帧的裸数据拼接在一个文件中
+    Y4M,                                // 只支持yuv420p/yuv422p/yuv444p/gray
+    PerFrame,                           // 路径是printf格式，只能有一个%d，如 frame_%04d.nv12
+};
+
+struct FrameSinkOptions {
+    FrameSinkFormat format = FrameSinkFormat::Auto;
+    int queueSize = 8;                  // 队列满时write()阻塞，统计到stallSec
+    AVRational frameRate = {25, 1};     // 写入Y4M的文件头
+};
+
+struct FrameSinkStats {
+    int64_t frames = 0;
+    int64_t bytes = 0;
+    int64_t syscalls = 0;               // write/writev的调用次数
+    double writeSec = 0;                // 写线程在系统调用中的时间
+    double stallSec = 0;                // 调用方在write()中等待队列的时间
+    double elapsedSec = 0;              // open()到close()
+};
+
+// 异步的帧写入器 : write()只引用帧放入有界队列，由单独的线程写文件，解码线程不会被磁盘IO卡住
+//   每个平面的linesize等于一行的字节数时整块写入，否则按行组成iovec一次writev；
+//   整帧只有一块时用write，不再每行一次fwrite
+class FrameSink {
+public:
+    FrameSink() = default;
+    ~FrameSink();
+    FrameSink(const FrameSink &) = delete;
+    FrameSink &operator=(const FrameSink &) = delete;
+
+    bool open(const std::string &path, const FrameSinkOptions &options = FrameSinkOptions());
+    // 写入一帧内存中的帧，不拷贝数据；之后调用方可以直接av_frame_unref
+    int write(const AVFrame *frame);
+    // 等队列写完，关闭文件，返回0或者写线程遇到的错误
+    int close();
+
+    // close()之后读取
+    const FrameSinkStats &stats() const { return stats_; }
+    // 打印吞吐和调用方的等待时间
+    void logReport() const;
+
+private:
+    void writerLoop();
+    int writeFrame(const AVFrame *frame);
+    int writeBuffers(int fd, std::vector<struct iovec> &iov);
+
+    FrameSinkOptions options_;
+    FrameSinkStats stats_;
+    std::string path_;
+    int fd_ = -1;                       // Raw/Y4M的输出文件
+    bool headerWritten_ = false;
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<AVFrame *> queue_;
+    bool closing_ = false;
+    int error_ = 0;
+    std::chrono::steady_clock::time_point opened_;
+};
@@ -0,0 +1,69 @@
+#include "moovReserve.h"
+#include <cmath>
+
+// 样本数是按时长估计出来的，或者编码器输出的帧数可能和输入不一致时，额外预留的比例
+static const double ESTIMATE_MARGIN = 1.25;
+
+int moovBytesPerSample(const AVCodecParameters *par) {
+    // stsz 4 + stts 8 + co64 8 + stsc 12，每个样本一个chunk、时长都不同的最坏情况
+    int bytes = 4 + 8 + 8 + 12;
+    if(par->codec_type == AVMEDIA_TYPE_VIDEO) {
+        // 视频还有ctts 8 + stss 4 + sdtp 1
+        bytes += 8 + 4 + 1;
+    }
+    return bytes;
+}
+
+int64_t moovFixedSize(const AVFormatContext *outFmtCtx) {
+    int64_t size = 4096;
+    for(int i = 0; i < outFmtCtx->nb_streams; ++i) {
+        size += 1024 + outFmtCtx->streams[i]->codecpar->extradata_size;
+    }
+    return size;
+}
+
+int64_t estimateSampleCount(const AVFormatContext *inFmtCtx, const AVStream *stream, bool &exact) {
+    // mp4等容器在头部就记录了准确的样本数
+    exact = stream->nb_frames > 0;
+    if(exact) {
+        return stream->nb_frames;
+    }
+
+    double durationSec = 0;
+    if(stream->duration != AV_NOPTS_VALUE && stream->duration > 0) {
+        durationSec = stream->duration * av_q2d(stream->time_base);
+    } else if(inFmtCtx->duration != AV_NOPTS_VALUE && inFmtCtx->duration > 0) {
+        durationSec = inFmtCtx->duration / (double)AV_TIME_BASE;
+    }
+    if(durationSec <= 0) {
+        return -1;
+    }
+
+    const AVCodecParameters *par = stream->codecpar;
+    double rate = 0;
+    if(par->codec_type == AVMEDIA_TYPE_VIDEO) {
+        AVRational frameRate = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : stream->r_frame_rate;
+        rate = frameRate.num > 0 && frameRate.den > 0 ? av_q2d(frameRate) : 0;
+    } else if(par->codec_type == AVMEDIA_TYPE_AUDIO && par->sample_rate > 0) {
+        rate = par->sample_rate / (double)(par->frame_size > 0 ? par->frame_size : 1024);
+    }
+    if(rate <= 0) {
+        return -1;
+    }
+    return (int64_t)std::ceil(durationSec * rate);
+}
+
+int64_t estimateMoovSize(const AVFormatContext *inFmtCtx, const AVFormatContext *outFmtCtx,
+                         const std::map<int, int> &streamIdxMap, bool copyPackets) {
+    double sampleBytes = 0;
+    for(auto &p : streamIdxMap) {
+        bool exact = false;
+        int64_t samples = estimateSampleCount(inFmtCtx, inFmtCtx->streams[p.first], exact);
+        if(samples < 0) {
+            return -1;
+        }
+        double bytes = (double)samples * moovBytesPerSample(outFmtCtx->streams[p.second]->codecpar);
+        sampleBytes += exact && copyPackets ? bytes : bytes * ESTIMATE_MARGIN;
+    }
+    return moovFixedSize(outFmtCtx) + (int64_t)sampleBytes;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <map>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// 在文件头预留moov空间时，对moov大小的估计
+//   按每个样本在stbl(stts/ctts/stss/stsz/stsc/co64)中最多占用的字节计算，是一个上限
+
+// 一个样本在moov中最多占用的字节数
+int moovBytesPerSample(const AVCodecParameters *par);
+
+// moov中和样本数无关的部分，mvhd/udta和每个trak的头、stsd等
+int64_t moovFixedSize(const AVFormatContext *outFmtCtx);
+
+// 估计一路流的样本数，exact表示来自容器中准确的帧数，估计不出时返回-1
+int64_t estimateSampleCount(const AVFormatContext *inFmtCtx, const AVStream *stream, bool &exact);
+
+// 根据输入估计输出需要预留的moov大小，streamIdxMap为输入流id -> 输出流id
+//   copyPackets表示packet直接拷贝，样本数和输入一致；任何一路流估计不出样本数时返回-1
+int64_t estimateMoovSize(const AVFormatContext *inFmtCtx, const AVFormatContext *outFmtCtx,
+                         const std::map<int, int> &streamIdxMap, bool copyPackets);
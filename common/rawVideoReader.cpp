@@ -0,0 +1,203 @@
+#include "rawVideoReader.h"
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+RawVideoReader::~RawVideoReader() {
+    close();
+}
+
+// 映射的大小放在opaque里
+static void unmapFile(void *opaque, uint8_t *data) {
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+// Y4M文件头中的C参数，高位深的采样按小端存储
+static AVPixelFormat y4mPixelFormat(const std::string &colorspace) {
+    static const struct {
+        const char *name;
+        AVPixelFormat format;
+    } formats[] = {
+        {"420", AV_PIX_FMT_YUV420P},
+        {"420jpeg", AV_PIX_FMT_YUV420P},
+        {"420paldv", AV_PIX_FMT_YUV420P},
+        {"420mpeg2", AV_PIX_FMT_YUV420P},
+        {"422", AV_PIX_FMT_YUV422P},
+        {"444", AV_PIX_FMT_YUV444P},
+        {"mono", AV_PIX_FMT_GRAY8},
+        {"420p10", AV_PIX_FMT_YUV420P10LE},
+        {"420p12", AV_PIX_FMT_YUV420P12LE},
+        {"420p16", AV_PIX_FMT_YUV420P16LE},
+        {"422p10", AV_PIX_FMT_YUV422P10LE},
+        {"422p12", AV_PIX_FMT_YUV422P12LE},
+        {"422p16", AV_PIX_FMT_YUV422P16LE},
+        {"444p10", AV_PIX_FMT_YUV444P10LE},
+        {"444p12", AV_PIX_FMT_YUV444P12LE},
+        {"444p16", AV_PIX_FMT_YUV444P16LE},
+    };
+    for(const auto &item : formats) {
+        if(colorspace == item.name) {
+            return item.format;
+        }
+    }
+    return AV_PIX_FMT_NONE;
+}
+
+static bool endsWith(const std::string &str, const std::string &suffix) {
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool RawVideoReader::open(const std::string &url, int width, int height, AVPixelFormat format) {
+    close();
+
+    int fd = ::open(url.c_str(), O_RDONLY);
+    if(fd < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to open %s\n", url.c_str());
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size == 0) {
+        av_log(NULL, AV_LOG_ERROR, "%s is empty\n", url.c_str());
+        ::close(fd);
+        return false;
+    }
+    size_t length = st.st_size;
+    void *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // 映射建立后就不再需要文件描述符了
+    ::close(fd);
+    if(data == MAP_FAILED) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to mmap %s\n", url.c_str());
+        return false;
+    }
+    // 顺序读取，让内核提前预读
+    madvise(data, length, MADV_SEQUENTIAL);
+
+    mapping_ = av_buffer_create((uint8_t *)data, length, unmapFile, (void *)(uintptr_t)length, AV_BUFFER_FLAG_READONLY);
+    if(mapping_ == nullptr) {
+        munmap(data, length);
+        return false;
+    }
+
+    if(endsWith(url, ".y4m")) {
+        if(!parseY4MHeader()) {
+            av_log(NULL, AV_LOG_ERROR, "Invalid y4m file %s\n", url.c_str());
+            close();
+            return false;
+        }
+    } else {
+        info_.width = width;
+        info_.height = height;
+        info_.format = format != AV_PIX_FMT_NONE ? format : (endsWith(url, ".nv12") ? AV_PIX_FMT_NV12 : AV_PIX_FMT_YUV420P);
+        frameSize_ = av_image_get_buffer_size(info_.format, width, height, 1);
+        if(frameSize_ <= 0) {
+            av_log(NULL, AV_LOG_ERROR, "Invalid raw video size %dx%d\n", width, height);
+            close();
+            return false;
+        }
+        for(int64_t offset = 0; offset + frameSize_ <= (int64_t)length; offset += frameSize_) {
+            frameOffsets_.push_back(offset);
+        }
+        if(length % frameSize_ != 0) {
+            av_log(NULL, AV_LOG_WARNING, "%s has %zu trailing bytes\n", url.c_str(), length % frameSize_);
+        }
+    }
+
+    info_.frameCount = frameOffsets_.size();
+    return info_.frameCount > 0;
+}
+
+void RawVideoReader::close() {
+    av_buffer_unref(&mapping_);
+    info_ = RawVideoInfo();
+    frameSize_ = 0;
+    frameOffsets_.clear();
+}
+
+// YUV4MPEG2 W640 H360 F30:1 Ip A1:1 C420jpeg\n 之后每一帧是 FRAME[参数]\n + 数据
+bool RawVideoReader::parseY4MHeader() {
+    const char *data = (const char *)mapping_->data;
+    size_t length = mapping_->size;
+    const char *headerEnd = (const char *)memchr(data, '\n', length);
+    if(headerEnd == nullptr || strncmp(data, "YUV4MPEG2 ", 10) != 0) {
+        return false;
+    }
+
+    std::string colorspace = "420jpeg";
+    std::string header(data + 10, headerEnd);
+    size_t pos = 0;
+    while(pos < header.size()) {
+        size_t end = header.find(' ', pos);
+        if(end == std::string::npos) {
+            end = header.size();
+        }
+        std::string token = header.substr(pos, end - pos);
+        if(!token.empty()) {
+            const char *value = token.c_str() + 1;
+            switch(token[0]) {
+                case 'W': info_.width = atoi(value); break;
+                case 'H': info_.height = atoi(value); break;
+                case 'F': sscanf(value, "%d:%d", &info_.frameRate.num, &info_.frameRate.den); break;
+                case 'C': colorspace = value; break;
+                default: break;
+            }
+        }
+        pos = end + 1;
+    }
+
+    info_.format = y4mPixelFormat(colorspace);
+    if(info_.format == AV_PIX_FMT_NONE) {
+        av_log(NULL, AV_LOG_ERROR, "Unsupported y4m colorspace %s\n", colorspace.c_str());
+        return false;
+    }
+    frameSize_ = av_image_get_buffer_size(info_.format, info_.width, info_.height, 1);
+    if(frameSize_ <= 0) {
+        return false;
+    }
+
+    // 帧头可能带参数，长度不固定，只扫描帧头所在的位置，不碰帧数据
+    size_t offset = headerEnd + 1 - data;
+    while(offset + 5 < length && memcmp(data + offset, "FRAME", 5) == 0) {
+        const char *frameHeaderEnd = (const char *)memchr(data + offset, '\n', length - offset);
+        if(frameHeaderEnd == nullptr) {
+            break;
+        }
+        size_t frameBegin = frameHeaderEnd + 1 - data;
+        if(frameBegin + frameSize_ > length) {
+            break;
+        }
+        frameOffsets_.push_back(frameBegin);
+        offset = frameBegin + frameSize_;
+    }
+    return true;
+}
+
+int RawVideoReader::getFrame(int index, AVFrame *frame) {
+    if(mapping_ == nullptr || index < 0 || index >= info_.frameCount) {
+        return AVERROR(EINVAL);
+    }
+
+    // 引用整个映射，帧释放时只减少引用计数
+    frame->buf[0] = av_buffer_ref(mapping_);
+    if(frame->buf[0] == nullptr) {
+        return AVERROR(ENOMEM);
+    }
+    int ret = av_image_fill_arrays(frame->data, frame->linesize, mapping_->data + frameOffsets_[index],
+                                   info_.format, info_.width, info_.height, 1);
+    if(ret < 0) {
+        av_buffer_unref(&frame->buf[0]);
+        return ret;
+    }
+    frame->extended_data = frame->data;
+    frame->width = info_.width;
+    frame->height = info_.height;
+    frame->format = info_.format;
+    frame->pts = index;
+    return 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+}
+
+struct RawVideoInfo {
+    int width = 0;
+    int height = 0;
+    AVPixelFormat format = AV_PIX_FMT_NONE;
+    AVRational frameRate = {25, 1};     // 原始文件不带帧率，只有y4m从文件头读
+    int frameCount = 0;
+};
+
+// 用mmap读取多帧的原始视频文件 : NV12/YUV420P等裸数据，或者Y4M
+//   每一帧包装成一个AVFrame，数据指针直接指向映射的内存，不做任何拷贝，
+//   读取的开销只有缺页；帧的缓冲引用着整个映射，reader先关闭也没关系。
+//   映射是只读的，需要改写帧数据时用av_frame_make_writable()拷贝一份
+class RawVideoReader {
+public:
+    RawVideoReader() = default;
+    ~RawVideoReader();
+    RawVideoReader(const RawVideoReader &) = delete;
+    RawVideoReader &operator=(const RawVideoReader &) = delete;
+
+    // .y4m从文件头解析宽高、格式和帧率，忽略后面的参数；
+    // 其他文件是裸数据，需要给出宽高和格式，格式不给时.nv12按NV12，其他按YUV420P
+    bool open(const std::string &url, int width = 0, int height = 0, AVPixelFormat format = AV_PIX_FMT_NONE);
+    void close();
+
+    const RawVideoInfo &info() const { return info_; }
+    int frameCount() const { return info_.frameCount; }
+
+    // 把第index帧包装到空的frame(新分配或av_frame_unref过)上，pts设为index
+    int getFrame(int index, AVFrame *frame);
+
+private:
+    bool parseY4MHeader();
+
+    AVBufferRef *mapping_ = nullptr;    // 整个文件的映射，释放最后一个引用时munmap
+    RawVideoInfo info_;
+    int frameSize_ = 0;
+    std::vector<int64_t> frameOffsets_; // 每一帧数据在文件中的位置
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/mathematics.h>
+}
+
+// 预先约分的时间基转换，结果和av_rescale_q()一致
+//   时间基相同或者整数倍时只需要一次乘法，不用走128位的除法
+struct TimestampRescale {
+    int64_t mul = 1;
+    int64_t div = 1;
+
+    void init(AVRational src, AVRational dst) {
+        mul = src.num * (int64_t)dst.den;
+        div = dst.num * (int64_t)src.den;
+        int64_t gcd = av_gcd(mul, div);
+        if(gcd > 1) {
+            mul /= gcd;
+            div /= gcd;
+        }
+    }
+
+    int64_t operator()(int64_t ts) const {
+        if(ts == AV_NOPTS_VALUE) {
+            return ts;
+        }
+        if(div == 1) {
+            return ts * mul;
+        }
+        return av_rescale_rnd(ts, mul, div, AV_ROUND_NEAR_INF);
+    }
+};
+
+// 一路输入流的改写描述，按输入流id直接索引，代替每个packet多次查找std::map
+struct StreamDescriptor {
+    int dstStreamId = -1;           // <0 表示这路流不输出
+    AVRational dstTimeBase = {1, 1};
+    TimestampRescale rescale;
+    int64_t ptsOffset = 0;          // 输入时间基下，rescale之前加上的偏移
+    int64_t dtsOffset = 0;
+};
+
+// 输出流的时间基在avformat_write_header()之后才确定，所以在写完header后建立
+//   streamIdxMap : 输入流id -> 输出流id
+inline std::vector<StreamDescriptor> buildStreamDescriptors(AVFormatContext *inFmtCtx, AVFormatContext *outFmtCtx,
+                                                             const std::vector<int> &streamIdxMap) {
+    std::vector<StreamDescriptor> table(inFmtCtx->nb_streams);
+    for(size_t i = 0; i < table.size() && i < streamIdxMap.size(); ++i) {
+        if(streamIdxMap[i] < 0) {
+            continue;
+        }
+        StreamDescriptor &desc = table[i];
+        desc.dstStreamId = streamIdxMap[i];
+        desc.dstTimeBase = outFmtCtx->streams[desc.dstStreamId]->time_base;
+        desc.rescale.init(inFmtCtx->streams[i]->time_base, desc.dstTimeBase);
+    }
+    return table;
+}
+
+// 改写packet的流id和时间戳，返回false表示这个packet应该丢弃
+//   读取过程中新出现的流(如ts中途加入的流)不在表中，同样丢弃
+inline bool rewritePacket(const std::vector<StreamDescriptor> &table, AVPacket *packet) {
+    if((unsigned)packet->stream_index >= table.size()) {
+        return false;
+    }
+    const StreamDescriptor &desc = table[packet->stream_index];
+    if(desc.dstStreamId < 0) {
+        return false;
+    }
+    if(packet->pts != AV_NOPTS_VALUE) {
+        packet->pts = desc.rescale(packet->pts + desc.ptsOffset);
+    }
+    if(packet->dts != AV_NOPTS_VALUE) {
+        packet->dts = desc.rescale(packet->dts + desc.dtsOffset);
+    }
+    packet->duration = desc.rescale(packet->duration);
+    packet->stream_index = desc.dstStreamId;
+    packet->time_base = desc.dstTimeBase;
+    return true;
+}